@@ -4,6 +4,10 @@
 #include <string_view>
 #include <limits>
 #include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <type_traits>
+#include <version>
 
 namespace rhm {
 
@@ -48,8 +52,8 @@ struct string_literal {
     }
     constexpr const char *data() const { return value; }
     constexpr const char *c_str() const { return value; }
-    constexpr size_t length() const { return N; }
-    constexpr size_t size() const { return N; }
+    constexpr size_t length() const { return N - 1; } // (not including null terminator)
+    constexpr size_t size() const { return N - 1; }
     constexpr operator std::string_view() const { return std::string_view(data(), length()); }
 
 //private: // must not have any private members to remain a structural class template
@@ -57,10 +61,142 @@ struct string_literal {
 };
 
 
+namespace _private {
+
+// Maximum number of characters written by std::to_chars() for a value of type T (or 0 if not a number).
+template<typename T>
+constexpr size_t max_chars()
+{
+    if constexpr(std::is_same_v<T, char>)
+        return 1;
+    else if constexpr(std::is_integral_v<T> && !std::is_same_v<T, bool>)
+        return std::numeric_limits<T>::digits10 + 1 + std::is_signed_v<T>;
+    else if constexpr(std::is_same_v<T, float>)
+        return 15; // e.g. -1.17549435e-38 (shortest representation)
+    else if constexpr(std::is_same_v<T, double>)
+        return 24; // e.g. -2.2250738585072014e-308
+    else
+        return 0;
+}
+
+template<typename T>
+constexpr bool is_fixed_size_concat_arg = max_chars<T>() > 0;
+
+template<typename T>
+constexpr size_t concat_arg_size(const T& val)
+{
+    if constexpr(is_fixed_size_concat_arg<T>)
+        return max_chars<T>();
+    else
+        return std::string_view(val).size();
+}
+
+template<typename T>
+char *write_concat_arg(char *p, const T& val)
+{
+    if constexpr(std::is_same_v<T, char>)
+    {
+        *p = val;
+        return p + 1;
+    }
+    else if constexpr(is_fixed_size_concat_arg<T>)
+    {
+        return std::to_chars(p, p + max_chars<T>(), val).ptr;
+    }
+    else
+    {
+        const std::string_view s(val);
+        memcpy(p, s.data(), s.size());
+        return p + s.size();
+    }
+}
+
+template<string_literal Sep, typename T, typename... Ts>
+char *write_concat_args(char *p, const T& first, const Ts&... rest)
+{
+    p = write_concat_arg(p, first);
+    ((memcpy(p, Sep.data(), Sep.length()), p = write_concat_arg(p + Sep.length(), rest)), ...);
+    return p;
+}
+
+} // end namespace _private
+
+
+// Maximum length of the string produced by concat<Prefix, Sep>() with values of types Ts. All of Ts must be
+// integer (except bool) or floating point (float or double) types, or char.
+template<string_literal Prefix, string_literal Sep, typename... Ts>
+requires (_private::is_fixed_size_concat_arg<Ts> && ...)
+constexpr size_t concat_max_size = Prefix.length() + Sep.length() * (sizeof...(Ts) > 0 ? sizeof...(Ts) - 1 : 0) + (_private::max_chars<Ts>() + ... + 0);
+
+// Maximum length of the string produced by concat<Prefix, Sep>(vals...), including the length of any string arguments.
+template<string_literal Prefix, string_literal Sep = "", typename... Ts>
+constexpr size_t concat_size(const Ts&... vals)
+{
+    return Prefix.length() + Sep.length() * (sizeof...(Ts) > 0 ? sizeof...(Ts) - 1 : 0) + (_private::concat_arg_size(vals) + ... + 0);
+}
+
+// Write Prefix followed by each of vals, separated by Sep, to out, which must have space for at least concat_size<Prefix, Sep>(vals...)
+// characters. Returns a pointer to the end of the characters written (no null terminator is written).
+// Each value may be an integer or floating point number (formatted with std::to_chars()), char, or anything convertible to std::string_view.
+// For example, concat_to<"sensor_", ".">(buf, 12, 3) writes "sensor_12.3".
+template<string_literal Prefix, string_literal Sep = "", typename... Ts>
+char *concat_to(char *out, const Ts&... vals)
+{
+    memcpy(out, Prefix.data(), Prefix.length());
+    out += Prefix.length();
+    if constexpr(sizeof...(Ts) > 0)
+        out = _private::write_concat_args<Sep>(out, vals...);
+    return out;
+}
+
+// Append Prefix and vals (as for concat_to() above) to a buffer which provides data(), size(), and resize(), such as
+// fmt::memory_buffer, std::vector<char> or std::string. (With fmt::memory_buffer, no memory is allocated unless its
+// inline storage is too small.)
+template<string_literal Prefix, string_literal Sep = "", typename BufferT, typename... Ts>
+requires requires(BufferT& b) { b.resize(b.size()); { b.data() } -> std::convertible_to<char*>; }
+void concat_to(BufferT& buf, const Ts&... vals)
+{
+    const size_t old_size = buf.size();
+    buf.resize(old_size + concat_size<Prefix, Sep>(vals...));
+    char *end = concat_to<Prefix, Sep>(buf.data() + old_size, vals...);
+    buf.resize((size_t)(end - buf.data()));
+}
+
+// Return a std::string of Prefix followed by vals (as for concat_to() above).  If all values are numbers (or char), the
+// maximum size is known at compile time, and the string is first formatted in a buffer on the stack, so the returned
+// std::string is allocated with its exact size (or not at all, if short enough for the small string optimization.)
+template<string_literal Prefix, string_literal Sep = "", typename... Ts>
+std::string concat(const Ts&... vals)
+{
+    if constexpr(sizeof...(Ts) == 0)
+    {
+        return std::string(Prefix.data(), Prefix.length());
+    }
+    else if constexpr((_private::is_fixed_size_concat_arg<Ts> && ...))
+    {
+        char buf[concat_max_size<Prefix, Sep, Ts...>];
+        const char *end = concat_to<Prefix, Sep>(buf, vals...);
+        return std::string(buf, (size_t)(end - buf));
+    }
+    else
+    {
+        std::string s;
+#ifdef __cpp_lib_string_resize_and_overwrite
+        s.resize_and_overwrite(concat_size<Prefix, Sep>(vals...), [&](char *p, size_t) { return (size_t)(concat_to<Prefix, Sep>(p, vals...) - p); });
+#else
+        s.resize(concat_size<Prefix, Sep>(vals...));
+        s.resize((size_t)(concat_to<Prefix, Sep>(s.data(), vals...) - s.data()));
+#endif
+        return s;
+    }
+}
+
+
 // Produce a std::string from a string literal (e.g. "my string", passed as a string_literal,
 // defined above, template parameter) followed by a non-string value, converted to a string using 
 // std::to_string.
-// Chooses (at compile time) the fastest method to do so based on either the given value n, or the
+// Integer values are formatted with concat() (below). For other values, chooses (at compile time)
+// the fastest method to do so based on either the given value n, or the
 // length of the resulting std::string (computed at compile time): If small enough for "small 
 // string optimization" (SSO), then simply construct the std::string and append the value. Otherwise,
 // reserve memory for the required size (with std::string::reserve())  first, then append the
@@ -72,22 +208,30 @@ struct string_literal {
 // is used as the approximate size of the std::string created and returned (Note, if too small, then std::string will have to do additional allocation,
 // but if too large, then the string will not be assumed to qualify for SSO.) 
 template<string_literal cstr, size_t n = 0, typename T> // T will be deduced from the val argument. 
-constexpr std::string append_to_string_literal(T val)
+std::string append_to_string_literal(T val)
 {
-    constexpr size_t len = cstr.length() + ( (n == 0) ? std::numeric_limits<T>::digits : n );
-    if(len <= rhm::_private::sso_len)
+    if constexpr(std::is_integral_v<T> && !std::is_same_v<T, bool>)
     {
-        std::string s(cstr.data(), cstr.length());
-        s.append(std::to_string(val));
-        return s;
+        // (Promote char types to int, as std::to_string() would.)
+        return concat<cstr>(+val);
     }
     else
     {
-        std::string s;
-        s.reserve(len);
-        s += cstr.data();
-        s += std::to_string(val);
-        return s;
+        constexpr size_t len = cstr.length() + ( (n == 0) ? std::numeric_limits<T>::digits : n );
+        if(len <= rhm::_private::sso_len)
+        {
+            std::string s(cstr.data(), cstr.length());
+            s.append(std::to_string(val));
+            return s;
+        }
+        else
+        {
+            std::string s;
+            s.reserve(len);
+            s += cstr.data();
+            s += std::to_string(val);
+            return s;
+        }
     }
 }
 
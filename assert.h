@@ -5,21 +5,53 @@
         rhm_precondition(condition)   Same as rhm_assert() but note that it was a precondition in the error message.
         rhm_postcondition(condition)  Same as rhm_assert() but note that it was a postcondition in the error message.
         
+        rhm_assert_full(condition)    Same as rhm_assert(), but only checked if RHM_ASSERT_LEVEL is RHM_ASSERT_LEVEL_FULL. Use for expensive checks.
+        rhm_assert_sampled(condition, n)  Same as rhm_assert(), but only evaluates (condition) on the first and then every n'th time this
+                                      assertion is reached (counted separately for each thread), for expensive checks inside hot loops.
+                                      Checked every time if RHM_ASSERT_LEVEL is RHM_ASSERT_LEVEL_FULL.
+
+   Define RHM_ASSERT_LEVEL before including this header to select which assertions are checked:
+        RHM_ASSERT_LEVEL_OFF (0)      No assertions are checked; the condition is not evaluated (but must still compile).
+        RHM_ASSERT_LEVEL_CHEAP (1)    rhm_assert(), rhm_assert_precond(), rhm_assert_postcond() and rhm_assert_sampled() (1 in n) are checked. Default if NDEBUG is defined.
+        RHM_ASSERT_LEVEL_FULL (2)     All assertions are checked, including rhm_assert_full(), and rhm_assert_sampled() every time. Default otherwise.
+
+   Each check compiles to one branch, predicted not to fail.  The failure handler (which formats the message and gets the stack
+   trace) is marked cold and never inlined, so it is kept out of the calling code and the code and arguments for
+   the call are only on the failure path.
+
    If std::stacktrace is available (C++23), then a stack trace is printed and stored in the exception.
    If std::source_location is available (C++20) then it will be used instead of the old __FILE__, __LINE__ and __PRETTY_FUNCTION__ macros.
    (Note, rhm_assert etc. are still macros so we can get a string representation of the checked expression.)
    Requires fmt library.
 
-  * TODO add easy integration point with a logging facility.
+   What happens when an assertion fails can be changed with rhm::set_assertion_handler().  The handler is given the
+   formatted message, details of the assertion, and the stack trace (if available), and returns whether to throw
+   rhm::failed_assertion (as the default handler, rhm::stderr_assertion_handler(), does) or to continue after the failed
+   assertion.  The handler may be called from any thread.  See async_assert_log.hh for a handler that passes messages to a
+   background thread to be written, instead of writing to stderr from the thread that failed.
 */
 
+#include <atomic>
 #include <exception>
 #include <iostream>
+#include <stdexcept>
 #include <cstdio>
 #include <string>
 #include <string_view>
 #include <optional>
 
+#define RHM_ASSERT_LEVEL_OFF 0
+#define RHM_ASSERT_LEVEL_CHEAP 1
+#define RHM_ASSERT_LEVEL_FULL 2
+
+#ifndef RHM_ASSERT_LEVEL
+  #ifdef NDEBUG
+    #define RHM_ASSERT_LEVEL RHM_ASSERT_LEVEL_CHEAP
+  #else
+    #define RHM_ASSERT_LEVEL RHM_ASSERT_LEVEL_FULL
+  #endif
+#endif
+
 #include "fmt/format.h" // todo replace with std::format once gcc and clang that support it are more widely available (gcc 13, clang 14, msvc 19.29).
 
 #if __has_include("stacktrace")
@@ -69,6 +101,66 @@ namespace rhm
   };
 
 
+  // What to do after an assertion failure handler returns.
+  enum class assertion_action {
+      throw_exception,
+      continue_execution
+  };
+
+  // Everything known about a failed assertion, given to the assertion failure handler. (Only valid during the call to the handler.)
+  struct assertion_failure
+  {
+      std::string_view message;  // formatted message with file, line, function and expression
+      const char *expression;
+      const char *file_name;
+      unsigned int line;
+      const char *function_name;
+      rhm::assertion_type assert_type;
+      #ifdef __cpp_lib_stacktrace
+        const std::stacktrace *stack_trace = nullptr;
+      #endif
+  };
+
+  using assertion_handler = assertion_action (*)(const assertion_failure&);
+
+  // Message and stack trace (if available) for a failed assertion, formatted to be printed on their own lines.
+  inline std::string format_assertion_failure(const assertion_failure& f)
+  {
+      const std::string sep(78, '-');
+      std::string s = fmt::format("\n{}\n{}\n{}\n", sep, f.message, sep);
+      #ifdef __cpp_lib_stacktrace
+        if(f.stack_trace)
+          s += fmt::format("Stack trace:\n{}\n{}\n\n", std::to_string(*f.stack_trace), sep);
+      #endif
+      return s;
+  }
+
+  // Default assertion failure handler: write the message and stack trace to std::cerr, then throw.
+  inline assertion_action stderr_assertion_handler(const assertion_failure& f)
+  {
+      // todo add color code characters if we might be running in a terminal (check environment variables or other hints.)
+      std::cerr << format_assertion_failure(f);
+      fflush(stderr);
+      return assertion_action::throw_exception;
+  }
+
+  namespace _private
+  {
+    inline std::atomic<assertion_handler> current_assertion_handler{&stderr_assertion_handler};
+  }
+
+  // Set the function called when an assertion fails (nullptr restores the default handler). Returns the previous handler.
+  inline assertion_handler set_assertion_handler(assertion_handler h) noexcept
+  {
+      return _private::current_assertion_handler.exchange(h ? h : &stderr_assertion_handler);
+  }
+
+  inline assertion_handler get_assertion_handler() noexcept
+  {
+      return _private::current_assertion_handler.load(std::memory_order_acquire);
+  }
+
+
   namespace _private
   {
             
@@ -86,22 +178,37 @@ namespace rhm
         #endif
     }
 
-    [[noreturn]] inline void assert_fail(const char *expression, const char *file, unsigned int line, const char *function, rhm::assertion_type assert_type) // todo stack trace
+    // Kept out of line and in the cold text section since it's only called if an assertion fails.
+    // Calls the assertion handler, then throws failed_assertion, unless the handler returns assertion_action::continue_execution.
+    [[gnu::cold, gnu::noinline]] inline void assert_fail(const char *expression, const char *file, unsigned int line, const char *function, rhm::assertion_type assert_type)
     {
       std::string msg = fmt::format("{}:{} : {}: {} ({}) failed. [{} +{}]", file, line, function, assertion_type_to_string(assert_type), expression, file, line);
-      // todo add color code characters if we might be running in a terminal (check environment variables or other hints.)
-      std::string sep(78, '-');
-      std::cerr << "\n" << sep << "\n" << msg << "\n" << sep << '\n'; 
-      fflush(stderr);
       #ifdef __cpp_lib_stacktrace
         std::stacktrace strace(std::stacktrace::current());
-        std::cerr << "Stack trace:\n" << strace << "\n" << sep << "\n\n";
-        fflush(stderr);
+        const assertion_failure failure{msg, expression, file, line, function, assert_type, &strace};
+      #else
+        const assertion_failure failure{msg, expression, file, line, function, assert_type};
+      #endif
+      if(get_assertion_handler()(failure) == assertion_action::continue_execution)
+        return;
+      #ifdef __cpp_lib_stacktrace
         throw failed_assertion(msg, expression, file, line, function, assert_type, strace);
       #else
         throw failed_assertion(msg, expression, file, line, function, assert_type);
       #endif
     }
+
+    // Return true on the first call and then on every n'th call with the same counter (one for each rhm_assert_sampled() in each thread).
+    inline bool sample_tick(unsigned int& countdown, unsigned int n) noexcept
+    {
+      if(countdown != 0) [[likely]]
+      {
+        --countdown;
+        return false;
+      }
+      countdown = (n > 0) ? n - 1 : 0;
+      return true;
+    }
   }
 
 
@@ -122,7 +229,36 @@ namespace rhm
     #define _rhm_func __PRETTY_FUNCTION__
 #endif
 
-#define rhm_assert(expr) ( static_cast<bool>(expr) ? void(0) : rhm::_private::assert_fail(#expr, _rhm_file, _rhm_line, _rhm_func, rhm::assertion) )
-#define rhm_assert_precond(expr) ( static_cast<bool>(expr) ? void(0) : rhm::_private::assert_fail(#expr, _rhm_file, _rhm_line, _rhm_func, rhm::precondition) )
-#define rhm_assert_postcond(expr) ( static_cast<bool>(expr) ? void(0) : rhm::_private::assert_fail(#expr, _rhm_file, _rhm_line, _rhm_func, rhm::postcondition) )
+#if defined(__GNUC__) || defined(__clang__)
+    #define _rhm_expect_true(expr) (__builtin_expect(static_cast<bool>(expr), 1))
+#else
+    #define _rhm_expect_true(expr) (static_cast<bool>(expr))
+#endif
+
+#define _rhm_check(expr, type) ( _rhm_expect_true(expr) ? void(0) : rhm::_private::assert_fail(#expr, _rhm_file, _rhm_line, _rhm_func, type) )
+#define _rhm_no_check(expr) (void(sizeof(static_cast<bool>(expr)))) // (expr is not evaluated)
+
+#if RHM_ASSERT_LEVEL >= RHM_ASSERT_LEVEL_CHEAP
+    #define rhm_assert(expr) _rhm_check(expr, rhm::assertion)
+    #define rhm_assert_precond(expr) _rhm_check(expr, rhm::precondition)
+    #define rhm_assert_postcond(expr) _rhm_check(expr, rhm::postcondition)
+#else
+    #define rhm_assert(expr) _rhm_no_check(expr)
+    #define rhm_assert_precond(expr) _rhm_no_check(expr)
+    #define rhm_assert_postcond(expr) _rhm_no_check(expr)
+#endif
+
+#if RHM_ASSERT_LEVEL >= RHM_ASSERT_LEVEL_FULL
+    #define rhm_assert_full(expr) _rhm_check(expr, rhm::assertion)
+    #define rhm_assert_sampled(expr, n) ( void(n), _rhm_check(expr, rhm::assertion) )
+#elif RHM_ASSERT_LEVEL >= RHM_ASSERT_LEVEL_CHEAP
+    #define rhm_assert_full(expr) _rhm_no_check(expr)
+    // The lambda gives each use of the macro its own counter.
+    #define rhm_assert_sampled(expr, n) \
+        ( rhm::_private::sample_tick([]() noexcept -> unsigned int& { static thread_local unsigned int countdown = 0; return countdown; }(), (n)) \
+            ? _rhm_check(expr, rhm::assertion) : void(0) )
+#else
+    #define rhm_assert_full(expr) _rhm_no_check(expr)
+    #define rhm_assert_sampled(expr, n) ( void(sizeof(n)), _rhm_no_check(expr) )
+#endif
 
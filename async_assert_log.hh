@@ -0,0 +1,189 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "assert.h"
+#include "mpmc_queue.hh"
+
+namespace rhm {
+
+/** What async_assert_log does with a message when its queue is full. */
+enum class full_queue_action {
+    write_directly, ///< Write the message from the failing thread (waiting for the output)
+    drop            ///< Discard the message, and count it
+};
+
+namespace _private {
+
+/** Non-template part of async_assert_log: the installed instance (shared by all QueueCapacity instantiations, so only one
+    can be installed at a time), and the number of calls to the handler in progress, which the destructor waits for.
+ */
+class async_assert_log_base
+{
+public:
+  async_assert_log_base(const async_assert_log_base&) = delete;
+  async_assert_log_base& operator=(const async_assert_log_base&) = delete;
+
+  /** Make this the assertion failure handler. */
+  void install() noexcept
+  {
+    async_assert_log_base *expected = nullptr;
+    const bool was_free = instance.compare_exchange_strong(expected, this);
+    assert(was_free || expected == this);
+    if(was_free)
+      previous_handler = set_assertion_handler(&handler);
+  }
+
+  /** Restore the handler which was set before install(). */
+  void uninstall() noexcept
+  {
+    async_assert_log_base *expected = this;
+    if(instance.compare_exchange_strong(expected, nullptr))
+      set_assertion_handler(previous_handler);
+  }
+
+  /** Queue a message to be written (from any thread). Returns false if it was not written. */
+  virtual bool log(std::string msg) = 0;
+
+protected:
+  explicit async_assert_log_base(assertion_action action_) noexcept : action(action_) {}
+  virtual ~async_assert_log_base() = default;
+
+  /** Uninstall, then wait for any threads which are still in handler() (and may have seen this instance before it was
+      uninstalled) to return. */
+  void uninstall_and_wait() noexcept
+  {
+    uninstall();
+    for(size_t n = in_handler.load(); n != 0; n = in_handler.load())
+      in_handler.wait(n);
+  }
+
+private:
+  static assertion_action handler(const assertion_failure& f)
+  {
+    // (Count this call before loading instance, so that if uninstall_and_wait() is called at the same time, either the
+    // instance is seen to be uninstalled here, or the destructor sees this call in progress and waits for it.)
+    in_handler.fetch_add(1);
+    struct leave { ~leave() { if(in_handler.fetch_sub(1) == 1) in_handler.notify_all(); } } leaving;
+    async_assert_log_base *log = instance.load();
+    if(!log)
+      return stderr_assertion_handler(f);
+    log->log(format_assertion_failure(f));
+    return log->action;
+  }
+
+  assertion_action action;
+  assertion_handler previous_handler = nullptr;
+
+  static inline std::atomic<async_assert_log_base*> instance{nullptr};
+  static inline std::atomic<size_t> in_handler{0};
+};
+
+} // end namespace _private
+
+/** @brief Assertion failure handler which writes messages from a background thread.
+
+    When installed with install() (which calls rhm::set_assertion_handler()), each assertion failure is formatted (with
+    stack trace if available) by the thread that failed, then passed through an rhm::mpmc_queue to a writer thread,
+    which writes it to the output FILE (stderr by default).  Threads with failed assertions therefore don't wait for
+    each other or for the output.  If the queue is full, then by default (full_queue_action::write_directly) the failing
+    thread writes its message to the output itself, so no messages are lost (see written_directly()).  Each message is
+    written with one fwrite(), which locks the FILE, so messages are not interleaved with those from the writer thread,
+    but they may be written out of order.  With full_queue_action::drop the message is dropped rather than waiting for
+    the output, and counted (see dropped()); if any were dropped, the writer thread writes a line with the number of
+    dropped messages before it exits.
+
+    The @a action given to the constructor is returned to rhm_assert() etc: either throw rhm::failed_assertion as
+    usual, or continue after the failed assertion ("soft" assertions, which are just logged).
+
+    Only one async_assert_log can be installed at a time (of any QueueCapacity).  The destructor uninstalls it (restoring
+    the previous handler), waits for any assertion failures still being handled by other threads, and then waits for the
+    writer thread to write all queued messages.
+
+    @note Requires C++20 mode when compiling.
+ */
+template<size_t QueueCapacity = 256>
+class async_assert_log : public _private::async_assert_log_base
+{
+public:
+  explicit async_assert_log(FILE *out_ = stderr, assertion_action action_ = assertion_action::throw_exception,
+                            full_queue_action when_full_ = full_queue_action::write_directly) :
+    async_assert_log_base(action_), out(out_), when_full(when_full_), writer([this] { write_messages(); })
+  {
+  }
+
+  ~async_assert_log() override
+  {
+    uninstall_and_wait();
+    queue.push(message{std::string(), true}); // (stop message, after all other messages already queued)
+    writer.join();
+  }
+
+  /** Queue a message to be written (from any thread).  If the queue is full, the message is written directly (see
+      full_queue_action), or if the full_queue_action is drop, false is returned and the message is counted in dropped().
+   */
+  bool log(std::string msg) override
+  {
+    message m{std::move(msg), false};
+    if(queue.try_push(std::move(m))) // (m is not moved from if the queue is full)
+      return true;
+    if(when_full == full_queue_action::write_directly)
+    {
+      fwrite(m.text.data(), 1, m.text.size(), out);
+      fflush(out);
+      written_directly_count.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    dropped_count.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  /** Number of messages that were not written because the queue was full (full_queue_action::drop only). */
+  size_t dropped() const noexcept { return dropped_count.load(std::memory_order_relaxed); }
+
+  /** Number of messages written by the writer thread so far. */
+  size_t written() const noexcept { return written_count.load(std::memory_order_acquire); }
+
+  /** Number of messages written by the failing thread because the queue was full (full_queue_action::write_directly only). */
+  size_t written_directly() const noexcept { return written_directly_count.load(std::memory_order_relaxed); }
+
+private:
+  struct message
+  {
+    std::string text;
+    bool stop = false;
+  };
+
+  void write_messages()
+  {
+    message m;
+    for(;;)
+    {
+      queue.pop(m);
+      if(m.stop)
+        break;
+      fwrite(m.text.data(), 1, m.text.size(), out);
+      // Flush if there are no more messages waiting, so each burst of messages is written without too much delay.
+      if(queue.empty())
+        fflush(out);
+      written_count.fetch_add(1, std::memory_order_release);
+    }
+    if(const size_t n = dropped(); n > 0)
+      fprintf(out, "rhm::async_assert_log: %zu assertion messages dropped (queue was full)\n", n);
+    fflush(out);
+  }
+
+  FILE *out;
+  full_queue_action when_full;
+  mpmc_queue<QueueCapacity, message> queue;
+  alignas(_private::cache_line_size) std::atomic<size_t> dropped_count{0};
+  std::atomic<size_t> written_count{0};
+  std::atomic<size_t> written_directly_count{0};
+  std::thread writer; // (last, so it is started after everything else is initialized)
+};
+
+} // end namespace rhm
@@ -0,0 +1,137 @@
+// Compare building short strings from a string literal prefix and values with rhm::concat() and
+// rhm::append_to_string_literal(), with std::to_string and operator+, and with fmt::format (as std::format would be used).
+// Build with: make bench_append_to_string_literal
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "append_to_string_literal.hh"
+
+#include "fmt/format.h"
+
+#include "benchmark/benchmark.h"
+
+// Values of different lengths, so string sizes vary as they would in real use.
+static std::vector<uint32_t> values()
+{
+  std::vector<uint32_t> v;
+  uint32_t x = 1;
+  for(int i = 0; i < 256; ++i)
+  {
+    x = x * 1664525u + 1013904223u;
+    v.push_back(x >> (i % 32));
+  }
+  return v;
+}
+
+template<typename Fn>
+static void run(benchmark::State& state, Fn&& fn)
+{
+  const auto v = values();
+  size_t i = 0;
+  size_t bytes = 0;
+  for (auto _ : state) {
+    std::string s = fn(v[i]);
+    bytes += s.size();
+    benchmark::DoNotOptimize(s);
+    i = (i + 1) % v.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed((int64_t)bytes);
+}
+
+// Short prefix (result fits in small string buffer)
+
+static void bench_short_concat(benchmark::State& state) {
+  run(state, [](uint32_t x) { return rhm::concat<"id_">(x); });
+}
+BENCHMARK(bench_short_concat);
+
+static void bench_short_append_to_string_literal(benchmark::State& state) {
+  run(state, [](uint32_t x) { return rhm::append_to_string_literal<"id_">(x); });
+}
+BENCHMARK(bench_short_append_to_string_literal);
+
+static void bench_short_to_string(benchmark::State& state) {
+  run(state, [](uint32_t x) { return "id_" + std::to_string(x); });
+}
+BENCHMARK(bench_short_to_string);
+
+static void bench_short_fmt_format(benchmark::State& state) {
+  run(state, [](uint32_t x) { return fmt::format("id_{}", x); });
+}
+BENCHMARK(bench_short_fmt_format);
+
+// Long prefix (result is allocated)
+
+static void bench_long_concat(benchmark::State& state) {
+  run(state, [](uint32_t x) { return rhm::concat<"building/floor/room/sensor_">(x); });
+}
+BENCHMARK(bench_long_concat);
+
+static void bench_long_append_to_string_literal(benchmark::State& state) {
+  run(state, [](uint32_t x) { return rhm::append_to_string_literal<"building/floor/room/sensor_">(x); });
+}
+BENCHMARK(bench_long_append_to_string_literal);
+
+static void bench_long_to_string(benchmark::State& state) {
+  run(state, [](uint32_t x) { return "building/floor/room/sensor_" + std::to_string(x); });
+}
+BENCHMARK(bench_long_to_string);
+
+static void bench_long_fmt_format(benchmark::State& state) {
+  run(state, [](uint32_t x) { return fmt::format("building/floor/room/sensor_{}", x); });
+}
+BENCHMARK(bench_long_fmt_format);
+
+// Several values with separators
+
+static void bench_multi_concat(benchmark::State& state) {
+  run(state, [](uint32_t x) { return rhm::concat<"k:", "/">(x, 'x', -(int)(x >> 8), x >> 16); });
+}
+BENCHMARK(bench_multi_concat);
+
+static void bench_multi_to_string(benchmark::State& state) {
+  run(state, [](uint32_t x) {
+    return "k:" + std::to_string(x) + "/x/" + std::to_string(-(int)(x >> 8)) + "/" + std::to_string(x >> 16);
+  });
+}
+BENCHMARK(bench_multi_to_string);
+
+static void bench_multi_fmt_format(benchmark::State& state) {
+  run(state, [](uint32_t x) { return fmt::format("k:{}/{}/{}/{}", x, 'x', -(int)(x >> 8), x >> 16); });
+}
+BENCHMARK(bench_multi_fmt_format);
+
+// Appending many strings to one reused buffer
+
+static void bench_concat_to_buffer(benchmark::State& state) {
+  const auto v = values();
+  fmt::memory_buffer buf;
+  for (auto _ : state) {
+    buf.clear();
+    for(uint32_t x : v)
+      rhm::concat_to<"sensor_", ",">(buf, x, "ok\n");
+    benchmark::DoNotOptimize(buf.data());
+  }
+  state.SetItemsProcessed(state.iterations() * (int64_t)v.size());
+  state.SetBytesProcessed(state.iterations() * (int64_t)buf.size());
+}
+BENCHMARK(bench_concat_to_buffer);
+
+static void bench_fmt_format_to_buffer(benchmark::State& state) {
+  const auto v = values();
+  fmt::memory_buffer buf;
+  for (auto _ : state) {
+    buf.clear();
+    for(uint32_t x : v)
+      fmt::format_to(std::back_inserter(buf), "sensor_{},ok\n", x);
+    benchmark::DoNotOptimize(buf.data());
+  }
+  state.SetItemsProcessed(state.iterations() * (int64_t)v.size());
+  state.SetBytesProcessed(state.iterations() * (int64_t)buf.size());
+}
+BENCHMARK(bench_fmt_format_to_buffer);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,132 @@
+// Compare checking each element with checked_add() etc. (using __builtin_add_overflow() and a branch for each element)
+// with the batch (span) versions, which the compiler can vectorize, and with unchecked addition.
+// Build with: make bench_checked_integer_math
+
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "checked_integer_math.hh"
+
+#include "benchmark/benchmark.h"
+
+template<typename T>
+static void make_inputs(size_t n, std::vector<T>& a, std::vector<T>& b)
+{
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> dist(-100, 100);
+  a.resize(n);
+  b.resize(n);
+  for(size_t i = 0; i < n; ++i)
+  {
+    a[i] = (T)dist(rng);
+    b[i] = (T)dist(rng);
+  }
+}
+
+// Check each element, stopping at the first overflow (like the batch version does).
+template<typename T>
+static void bench_add_each(benchmark::State& state) {
+  std::vector<T> a, b, out((size_t)state.range(0));
+  make_inputs((size_t)state.range(0), a, b);
+  for (auto _ : state) {
+    std::optional<size_t> first;
+    for(size_t i = 0; i < a.size(); ++i)
+    {
+      if(__builtin_add_overflow(a[i], b[i], &out[i]))
+      {
+        first = i;
+        break;
+      }
+    }
+    benchmark::DoNotOptimize(first);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(bench_add_each, int32_t)->Arg(4096);
+BENCHMARK_TEMPLATE(bench_add_each, int64_t)->Arg(4096);
+
+template<typename T>
+static void bench_add_batch(benchmark::State& state) {
+  std::vector<T> a, b, out((size_t)state.range(0));
+  make_inputs((size_t)state.range(0), a, b);
+  for (auto _ : state) {
+    auto first = checked_add<T>(std::span<const T>(a), std::span<const T>(b), std::span<T>(out));
+    benchmark::DoNotOptimize(first);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(bench_add_batch, int32_t)->Arg(4096);
+BENCHMARK_TEMPLATE(bench_add_batch, int64_t)->Arg(4096);
+
+template<typename T>
+static void bench_add_unchecked(benchmark::State& state) {
+  std::vector<T> a, b, out((size_t)state.range(0));
+  make_inputs((size_t)state.range(0), a, b);
+  for (auto _ : state) {
+    for(size_t i = 0; i < a.size(); ++i)
+      out[i] = a[i] + b[i];
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(bench_add_unchecked, int32_t)->Arg(4096);
+BENCHMARK_TEMPLATE(bench_add_unchecked, int64_t)->Arg(4096);
+
+template<typename T>
+static void bench_mul_each(benchmark::State& state) {
+  std::vector<T> a, b, out((size_t)state.range(0));
+  make_inputs((size_t)state.range(0), a, b);
+  for (auto _ : state) {
+    std::optional<size_t> first;
+    for(size_t i = 0; i < a.size(); ++i)
+    {
+      if(__builtin_mul_overflow(a[i], b[i], &out[i]))
+      {
+        first = i;
+        break;
+      }
+    }
+    benchmark::DoNotOptimize(first);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(bench_mul_each, int32_t)->Arg(4096);
+BENCHMARK_TEMPLATE(bench_mul_each, int16_t)->Arg(4096);
+BENCHMARK_TEMPLATE(bench_mul_each, int64_t)->Arg(4096);
+
+template<typename T>
+static void bench_mul_batch(benchmark::State& state) {
+  std::vector<T> a, b, out((size_t)state.range(0));
+  make_inputs((size_t)state.range(0), a, b);
+  for (auto _ : state) {
+    auto first = checked_mul<T>(std::span<const T>(a), std::span<const T>(b), std::span<T>(out));
+    benchmark::DoNotOptimize(first);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(bench_mul_batch, int32_t)->Arg(4096);
+BENCHMARK_TEMPLATE(bench_mul_batch, int16_t)->Arg(4096);
+BENCHMARK_TEMPLATE(bench_mul_batch, int64_t)->Arg(4096);
+
+// Saturating addition, one element at a time (branch free, so this loop can also be vectorized).
+template<typename T>
+static void bench_saturating_add(benchmark::State& state) {
+  std::vector<T> a, b, out((size_t)state.range(0));
+  make_inputs((size_t)state.range(0), a, b);
+  for (auto _ : state) {
+    for(size_t i = 0; i < a.size(); ++i)
+      out[i] = saturating_add<T>(a[i], b[i]);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(bench_saturating_add, int32_t)->Arg(4096);
+
+BENCHMARK_MAIN();
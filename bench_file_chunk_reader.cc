@@ -0,0 +1,141 @@
+// Compare reading lines from a generated file with each rhm::file_chunk_reader backend, with a range based for loop
+// and with for_each_batch().  The file size in MB is set by the BENCH_FILE_SIZE_MB environment variable (default 64;
+// use 1024 for a 1 GB file, bigger than most page caches in CI runners).  The files are written to the temporary
+// directory and removed at exit.
+// Build with: make bench_file_chunk_reader
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#include "file_chunk_reader.hh"
+
+#include "benchmark/benchmark.h"
+
+// Generated test file, with lines of different lengths (like a CSV file), and the same contents gzip compressed.
+class test_file
+{
+public:
+  test_file()
+  {
+    const char *mb = getenv("BENCH_FILE_SIZE_MB");
+    const size_t size = (mb ? (size_t)atol(mb) : 64) * 1024 * 1024;
+    path = std::filesystem::temp_directory_path() / "bench_file_chunk_reader.txt";
+    FILE *fp = fopen(path.c_str(), "w");
+    assert(fp);
+    std::string line;
+    unsigned long x = 12345;
+    while(bytes < size)
+    {
+      x = x * 6364136223846793005ul + 1442695040888963407ul;
+      line = std::to_string(lines) + ",sensor " + std::to_string(x >> 60) + "," + std::string((x >> 32) % 100, 'v') + "\n";
+      fputs(line.c_str(), fp);
+      bytes += line.size();
+      ++lines;
+    }
+    fclose(fp);
+  }
+
+  ~test_file()
+  {
+    std::filesystem::remove(path);
+    if(!gz_path.empty())
+      std::filesystem::remove(gz_path);
+  }
+
+#if defined(USE_ZLIB) && __has_include(<zlib.h>)
+  // Compressed on first use, since this takes a while for a big file.
+  const std::filesystem::path& gzip_path()
+  {
+    if(!gz_path.empty())
+      return gz_path;
+    gz_path = path.string() + ".gz";
+    rhm::block_file_reader r(path);
+    gzFile gz = gzopen(gz_path.c_str(), "wb1");
+    assert(gz);
+    for(std::string_view line : r)
+      gzwrite(gz, line.data(), (unsigned)line.size());
+    gzclose(gz);
+    return gz_path;
+  }
+#endif
+
+  std::filesystem::path path;
+  std::filesystem::path gz_path;
+  size_t bytes = 0;
+  size_t lines = 0;
+};
+
+static test_file& file()
+{
+  static test_file f;
+  return f;
+}
+
+static void set_file_processed(benchmark::State& state)
+{
+  state.SetBytesProcessed(state.iterations() * (int64_t)file().bytes);
+  state.SetItemsProcessed(state.iterations() * (int64_t)file().lines);
+  state.counters["lines"] = (double)file().lines;
+}
+
+// Read every line with a range based for loop.
+template<typename ReaderT>
+static void read_lines(benchmark::State& state, const std::filesystem::path& path)
+{
+  for (auto _ : state) {
+    ReaderT r(path);
+    size_t n = 0;
+    for(std::string_view line : r)
+      n += line.size();
+    assert(n == file().bytes);
+    benchmark::DoNotOptimize(n);
+  }
+  set_file_processed(state);
+}
+
+static void bench_getdelim(benchmark::State& state) { read_lines<rhm::getdelim_file_reader>(state, file().path); }
+BENCHMARK(bench_getdelim)->Unit(benchmark::kMillisecond);
+
+static void bench_block(benchmark::State& state) { read_lines<rhm::block_file_reader>(state, file().path); }
+BENCHMARK(bench_block)->Unit(benchmark::kMillisecond);
+
+static void bench_mapped(benchmark::State& state) { read_lines<rhm::mapped_file_reader>(state, file().path); }
+BENCHMARK(bench_mapped)->Unit(benchmark::kMillisecond);
+
+#if defined(USE_ZLIB) && __has_include(<zlib.h>)
+static void bench_gzip(benchmark::State& state) { read_lines<rhm::gzip_file_reader>(state, file().gzip_path()); }
+BENCHMARK(bench_gzip)->Unit(benchmark::kMillisecond);
+#endif
+
+// Read in batches of state.range(0) lines with for_each_batch().
+template<typename ReaderT>
+static void read_batches(benchmark::State& state)
+{
+  rhm::line_arena arena;
+  for (auto _ : state) {
+    ReaderT r(file().path);
+    size_t n = 0;
+    r.for_each_batch(arena, (size_t)state.range(0), [&](std::span<const std::string_view> batch) {
+      for(auto line : batch)
+        n += line.size();
+    });
+    assert(n == file().bytes);
+    benchmark::DoNotOptimize(n);
+  }
+  set_file_processed(state);
+}
+
+static void bench_batch_getdelim(benchmark::State& state) { read_batches<rhm::getdelim_file_reader>(state); }
+BENCHMARK(bench_batch_getdelim)->Arg(64)->Arg(4096)->Unit(benchmark::kMillisecond);
+
+static void bench_batch_block(benchmark::State& state) { read_batches<rhm::block_file_reader>(state); }
+BENCHMARK(bench_batch_block)->Arg(64)->Arg(4096)->Unit(benchmark::kMillisecond);
+
+static void bench_batch_mapped(benchmark::State& state) { read_batches<rhm::mapped_file_reader>(state); }
+BENCHMARK(bench_batch_mapped)->Arg(64)->Arg(4096)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,66 @@
+// Measure the cost of recording values with rhm::instrument::counter, scoped_timer and scoped_hw_counters (used
+// directly, so this doesn't depend on RHM_INSTRUMENTATION), from one thread and from several threads at once.
+// Build with: make bench_instrumentation
+
+#include <cstdint>
+
+#include "instrumentation.hh"
+
+#include "benchmark/benchmark.h"
+
+static const rhm::instrument::counter values("bench.values");
+static const rhm::instrument::counter timer("bench.timer");
+static const rhm::instrument::counter timer_ns("bench.timer_ns");
+static const rhm::instrument::counter hw_cycles("bench.hw.cycles");
+static const rhm::instrument::counter hw_cache_misses("bench.hw.cache_misses");
+static const rhm::instrument::counter hw_branch_misses("bench.hw.branch_misses");
+
+static void bench_baseline(benchmark::State& state) {
+  uint64_t x = 1;
+  for (auto _ : state) {
+    x = x * 6364136223846793005ul + 1;
+    benchmark::DoNotOptimize(x >> 40);
+  }
+}
+BENCHMARK(bench_baseline)->ThreadRange(1, 4);
+
+static void bench_record(benchmark::State& state) {
+  uint64_t x = 1;
+  for (auto _ : state) {
+    x = x * 6364136223846793005ul + 1;
+    values.record(x >> 40);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bench_record)->ThreadRange(1, 4);
+
+static void bench_scoped_timer(benchmark::State& state) {
+  for (auto _ : state) {
+    rhm::instrument::scoped_timer t(timer);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bench_scoped_timer)->ThreadRange(1, 4);
+
+static void bench_scoped_timer_steady_clock(benchmark::State& state) {
+  for (auto _ : state) {
+    rhm::instrument::scoped_timer<rhm::instrument::steady_clock_ns> t(timer_ns);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bench_scoped_timer_steady_clock);
+
+static void bench_scoped_hw_counters(benchmark::State& state) {
+  if(!rhm::instrument::this_thread_hw_counters().valid())
+  {
+    state.SkipWithError("perf_event_open() not available");
+    return;
+  }
+  for (auto _ : state) {
+    rhm::instrument::scoped_hw_counters c(hw_cycles, hw_cache_misses, hw_branch_misses);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bench_scoped_hw_counters);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,117 @@
+// Compare the general (iterator based) ring_buffer with the index based specialization used for
+// fixed size containers with power of two capacity, and measure throughput for different
+// capacities and element sizes.
+// Build with: make bench_ring_buffer
+
+#include <array>
+#include <vector>
+
+#include "ring_buffer.hh"
+
+#include "benchmark/benchmark.h"
+
+// Index based specialization:
+using pow2_array_buffer = rhm::ring_buffer<1024, std::array<int, 1024>>;
+// General iterator based implementation:
+using array_buffer = rhm::ring_buffer<1000, std::array<int, 1000>>;
+using vector_buffer = rhm::ring_buffer<1024, std::vector<int>>;
+
+// Push into a full buffer, replacing the oldest item each time.
+template<typename BufferT>
+static void bench_push_full(benchmark::State& state) {
+  BufferT buf;
+  buf.fill(0);
+  int i = 0;
+  for (auto _ : state) {
+    buf.push(++i);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(bench_push_full, pow2_array_buffer);
+BENCHMARK_TEMPLATE(bench_push_full, array_buffer);
+BENCHMARK_TEMPLATE(bench_push_full, vector_buffer);
+
+// Fill the buffer with push(), then empty it with front() and pop_front().
+template<typename BufferT>
+static void bench_push_then_pop(benchmark::State& state) {
+  BufferT buf;
+  buf.fill(0);
+  buf.reset();
+  for (auto _ : state) {
+    for(int i = 0; i < (int)buf.capacity(); ++i)
+      buf.push(i);
+    int sum = 0;
+    while(!buf.empty())
+    {
+      sum += *buf.front();
+      buf.pop_front();
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * (int64_t)buf.capacity());
+}
+BENCHMARK_TEMPLATE(bench_push_then_pop, pow2_array_buffer);
+BENCHMARK_TEMPLATE(bench_push_then_pop, array_buffer);
+BENCHMARK_TEMPLATE(bench_push_then_pop, vector_buffer);
+
+// Interleaved push and pop with a small number of items in the buffer (e.g. a queue that is kept nearly empty).
+template<typename BufferT>
+static void bench_interleaved(benchmark::State& state) {
+  BufferT buf;
+  buf.fill(0);
+  buf.reset();
+  buf.push(0);
+  int i = 0;
+  for (auto _ : state) {
+    buf.push(++i);
+    benchmark::DoNotOptimize(*buf.front());
+    buf.pop_front();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(bench_interleaved, pow2_array_buffer);
+BENCHMARK_TEMPLATE(bench_interleaved, array_buffer);
+BENCHMARK_TEMPLATE(bench_interleaved, vector_buffer);
+
+// Fill then empty a power of two std::array buffer, with different capacities and element sizes.
+template<size_t Size>
+struct element {
+  char bytes[Size];
+};
+
+template<size_t Capacity, size_t ElementSize>
+static void bench_throughput(benchmark::State& state) {
+  using buffer_t = rhm::ring_buffer<Capacity, std::array<element<ElementSize>, Capacity>>;
+  static buffer_t buf; // (static since it may be too big for the stack)
+  buf.fill(element<ElementSize>{});
+  buf.reset();
+  element<ElementSize> e{};
+  for (auto _ : state) {
+    for(size_t i = 0; i < Capacity; ++i)
+    {
+      e.bytes[0] = (char)i;
+      buf.push(e);
+    }
+    char sum = 0;
+    while(!buf.empty())
+    {
+      sum = (char)(sum + buf.front()->bytes[0]);
+      buf.pop_front();
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * (int64_t)Capacity);
+  state.SetBytesProcessed(state.iterations() * (int64_t)(Capacity * ElementSize));
+  state.counters["buffer_bytes"] = (double)sizeof(buf);
+}
+BENCHMARK_TEMPLATE(bench_throughput, 16, 8);
+BENCHMARK_TEMPLATE(bench_throughput, 1024, 8);
+BENCHMARK_TEMPLATE(bench_throughput, 65536, 8);
+BENCHMARK_TEMPLATE(bench_throughput, 16, 64);
+BENCHMARK_TEMPLATE(bench_throughput, 1024, 64);
+BENCHMARK_TEMPLATE(bench_throughput, 65536, 64);
+BENCHMARK_TEMPLATE(bench_throughput, 1024, 256);
+BENCHMARK_TEMPLATE(bench_throughput, 16384, 256);
+
+BENCHMARK_MAIN();
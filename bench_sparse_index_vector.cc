@@ -0,0 +1,178 @@
+// Compare the different index search methods used by sparse_index_vector::insert(), to find the
+// sizes at which one becomes faster than another (see sparse_index_vector linear_search_max_size and count_search_max_size),
+// building a sparse_index_vector with insert() or assign_unsorted(), and erasing items.
+// Building, iterating and equal_range() are also compared with std::multimap<size_t, int>.
+// Build with: make bench_sparse_index_vector
+// To use AVX2 (if available), build with: make bench_sparse_index_vector CXXFLAGS=-mavx2 (or -march=native)
+
+#include <cstddef>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "sparse_index_vector.hh"
+
+#include "benchmark/benchmark.h"
+
+// Sorted indices 0, 2, 4, ... and a set of random keys to search for (including keys past the end).
+struct search_data {
+  std::vector<size_t> indices;
+  std::vector<size_t> keys;
+  explicit search_data(size_t n) : indices(n), keys(1024) {
+    for(size_t i = 0; i < n; ++i)
+      indices[i] = 2 * i;
+    std::mt19937_64 rng(n);
+    std::uniform_int_distribution<size_t> dist(0, 2 * n + 1);
+    for(auto& k : keys)
+      k = dist(rng);
+  }
+};
+
+template<size_t (*Search)(const size_t*, size_t, size_t)>
+static void bench_search(benchmark::State& state) {
+  const search_data data((size_t)state.range(0));
+  size_t k = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Search(data.indices.data(), data.indices.size(), data.keys[k]));
+    k = (k + 1) % data.keys.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(bench_search, rhm::_private::index_lower_bound_linear)->RangeMultiplier(2)->Range(4, 4096);
+BENCHMARK_TEMPLATE(bench_search, rhm::_private::index_lower_bound_count)->RangeMultiplier(2)->Range(4, 4096);
+BENCHMARK_TEMPLATE(bench_search, rhm::_private::index_lower_bound_binary)->RangeMultiplier(2)->Range(4, 4096);
+
+// Insert into a sparse_index_vector with the given number of items (using whichever search method insert() chooses), then erase it again by iterator.
+static void bench_insert(benchmark::State& state) {
+  const search_data data((size_t)state.range(0));
+  rhm::sparse_index_vector<int> v;
+  for(size_t i : data.indices)
+    v.insert(i, (int)i);
+  size_t k = 0;
+  for (auto _ : state) {
+    v.erase(v.insert(data.keys[k], -1));
+    k = (k + 1) % data.keys.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bench_insert)->RangeMultiplier(4)->Range(4, 4096);
+
+// Build a sparse_index_vector from items in random order, with insert() for each item, or with assign_unsorted().
+static std::vector<std::pair<size_t, int>> random_pairs(size_t n) {
+  std::vector<std::pair<size_t, int>> pairs(n);
+  std::mt19937_64 rng(n);
+  std::uniform_int_distribution<size_t> dist(0, n);
+  for(size_t i = 0; i < n; ++i)
+    pairs[i] = {dist(rng), (int)i};
+  return pairs;
+}
+
+static void bench_build_insert(benchmark::State& state) {
+  const auto pairs = random_pairs((size_t)state.range(0));
+  for (auto _ : state) {
+    rhm::sparse_index_vector<int> v;
+    for(const auto& [index, value] : pairs)
+      v.insert(index, value);
+    benchmark::DoNotOptimize(v);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(bench_build_insert)->RangeMultiplier(8)->Range(64, 32768);
+
+static void bench_build_assign_unsorted(benchmark::State& state) {
+  const auto pairs = random_pairs((size_t)state.range(0));
+  for (auto _ : state) {
+    rhm::sparse_index_vector<int> v;
+    v.assign_unsorted(pairs);
+    benchmark::DoNotOptimize(v);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(bench_build_assign_unsorted)->RangeMultiplier(8)->Range(64, 32768);
+
+// Erase a quarter of the items one at a time by iterator, then compact().
+static void bench_erase_burst(benchmark::State& state) {
+  const auto pairs = random_pairs((size_t)state.range(0));
+  for (auto _ : state) {
+    state.PauseTiming();
+    rhm::sparse_index_vector<int> v(pairs);
+    state.ResumeTiming();
+    for(auto i = v.begin(); i != v.end(); )
+      i = (*i % 4 == 0) ? v.erase(i) : std::next(i);
+    v.compact();
+    benchmark::DoNotOptimize(v);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) / 4);
+}
+BENCHMARK(bench_erase_burst)->RangeMultiplier(8)->Range(64, 32768);
+
+static void bench_build_multimap(benchmark::State& state) {
+  const auto pairs = random_pairs((size_t)state.range(0));
+  for (auto _ : state) {
+    std::multimap<size_t, int> m(pairs.begin(), pairs.end());
+    benchmark::DoNotOptimize(m);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(bench_build_multimap)->RangeMultiplier(8)->Range(64, 32768);
+
+// Iterate over all items in index order.
+static void bench_iterate(benchmark::State& state) {
+  const rhm::sparse_index_vector<int> v(random_pairs((size_t)state.range(0)));
+  for (auto _ : state) {
+    long sum = 0;
+    for(auto [index, value] : v.pairs())
+      sum += (long)index + value;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * state.range(0) * (int64_t)(sizeof(size_t) + sizeof(int)));
+}
+BENCHMARK(bench_iterate)->RangeMultiplier(8)->Range(64, 32768);
+
+static void bench_iterate_multimap(benchmark::State& state) {
+  const auto pairs = random_pairs((size_t)state.range(0));
+  const std::multimap<size_t, int> m(pairs.begin(), pairs.end());
+  for (auto _ : state) {
+    long sum = 0;
+    for(const auto& [index, value] : m)
+      sum += (long)index + value;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * state.range(0) * (int64_t)(sizeof(size_t) + sizeof(int)));
+}
+BENCHMARK(bench_iterate_multimap)->RangeMultiplier(8)->Range(64, 32768);
+
+// Find all items with random indices.
+static void bench_equal_range(benchmark::State& state) {
+  const size_t n = (size_t)state.range(0);
+  const rhm::sparse_index_vector<int> v(random_pairs(n));
+  const search_data data(n);
+  size_t k = 0;
+  for (auto _ : state) {
+    auto [first, last] = v.equal_range(data.keys[k] / 2);
+    benchmark::DoNotOptimize(std::distance(first, last));
+    k = (k + 1) % data.keys.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bench_equal_range)->RangeMultiplier(8)->Range(64, 32768);
+
+static void bench_equal_range_multimap(benchmark::State& state) {
+  const size_t n = (size_t)state.range(0);
+  const auto pairs = random_pairs(n);
+  const std::multimap<size_t, int> m(pairs.begin(), pairs.end());
+  const search_data data(n);
+  size_t k = 0;
+  for (auto _ : state) {
+    auto [first, last] = m.equal_range(data.keys[k] / 2);
+    benchmark::DoNotOptimize(std::distance(first, last));
+    k = (k + 1) % data.keys.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bench_equal_range_multimap)->RangeMultiplier(8)->Range(64, 32768);
+
+BENCHMARK_MAIN();
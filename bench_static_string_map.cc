@@ -0,0 +1,78 @@
+// Compare looking up fixed strings in rhm::static_string_map (perfect hash generated at compile time) with
+// std::unordered_map<std::string, size_t> and a linear search of the keys.
+// Build with: make bench_static_string_map
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "static_string_map.hh"
+
+#include "benchmark/benchmark.h"
+
+using topics = rhm::static_string_map<"CONNECT", "CONNACK", "PUBLISH", "PUBACK", "PUBREC", "PUBREL", "PUBCOMP",
+  "SUBSCRIBE", "SUBACK", "UNSUBSCRIBE", "UNSUBACK", "PINGREQ", "PINGRESP", "DISCONNECT", "AUTH",
+  "sensor/temperature", "sensor/humidity", "sensor/pressure", "status", "config">;
+
+// Names looked up: every key, plus some strings which are not keys.
+static std::vector<std::string> lookup_names()
+{
+  std::vector<std::string> names(topics::keys.begin(), topics::keys.end());
+  for(auto k : topics::keys)
+    names.push_back(std::string(k) + "/x");
+  return names;
+}
+
+static void bench_static_string_map(benchmark::State& state) {
+  const auto names = lookup_names();
+  for (auto _ : state) {
+    size_t sum = 0;
+    for(const auto& n : names)
+      sum += topics::find(n);
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * (int64_t)names.size());
+}
+BENCHMARK(bench_static_string_map);
+
+static void bench_unordered_map(benchmark::State& state) {
+  const auto names = lookup_names();
+  std::unordered_map<std::string, size_t> map;
+  for(size_t i = 0; i < topics::size(); ++i)
+    map.emplace(topics::keys[i], i);
+  for (auto _ : state) {
+    size_t sum = 0;
+    for(const auto& n : names)
+    {
+      auto i = map.find(n);
+      sum += (i == map.end()) ? topics::npos : i->second;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * (int64_t)names.size());
+}
+BENCHMARK(bench_unordered_map);
+
+static void bench_linear_search(benchmark::State& state) {
+  const auto names = lookup_names();
+  for (auto _ : state) {
+    size_t sum = 0;
+    for(const auto& n : names)
+    {
+      size_t found = topics::npos;
+      for(size_t i = 0; i < topics::size(); ++i)
+        if(topics::keys[i] == n)
+        {
+          found = i;
+          break;
+        }
+      sum += found;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * (int64_t)names.size());
+}
+BENCHMARK(bench_linear_search);
+
+BENCHMARK_MAIN();
@@ -18,59 +18,608 @@
 //   #error this compiler is not supported
 // #endif
 
-template <typename TR, typename T1, typename T2>
-inline constexpr TR checked_add(T1 a, T2 b) noexcept
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+/* What to do if the result of checked_add(), checked_sub() or checked_mul() overflows the result type TR:
+     abort            Call abort().
+     throw_exception  Throw std::overflow_error.
+     saturate         Return the maximum or minimum value of TR (whichever is nearest the true result).
+     wrap             Return the true result modulo 2^N, where N is the number of bits in TR (i.e. the same as unsigned arithmetic).
+   The default policy is abort, unless CHECKED_INTEGER_MATH_DEFAULT_POLICY is defined to another policy before including this header
+   (e.g. -DCHECKED_INTEGER_MATH_DEFAULT_POLICY=overflow_policy::throw_exception).
+   The policy can also be given for each call, e.g. checked_add<int, overflow_policy::saturate>(a, b), or use saturating_add(),
+   wrapping_add() etc.  try_add() etc. return std::nullopt on overflow instead.
+ */
+enum class overflow_policy { abort, throw_exception, saturate, wrap };
+
+#ifndef CHECKED_INTEGER_MATH_DEFAULT_POLICY
+#define CHECKED_INTEGER_MATH_DEFAULT_POLICY overflow_policy::abort
+#endif
+
+namespace checked_integer_math_private {
+
+    enum class op { add, sub, mul };
+
+    template <typename T>
+    constexpr bool is_negative(T x) noexcept
+    {
+        if constexpr(std::is_signed_v<T>)
+            return x < 0;
+        else
+            return false;
+    }
+
+    // Store a op b in result (modulo 2^N if it doesn't fit). Return true if it overflowed.
+    template <op Op, typename TR, typename T1, typename T2>
+    constexpr bool overflowed(T1 a, T2 b, TR& result) noexcept
+    {
+        #if defined(_c_lib_stdckdint)
+            if constexpr(Op == op::add) return ckd_add(&result, a, b);
+            else if constexpr(Op == op::sub) return ckd_sub(&result, a, b);
+            else return ckd_mul(&result, a, b);
+        #else
+            if constexpr(Op == op::add) return __builtin_add_overflow(a, b, &result);
+            else if constexpr(Op == op::sub) return __builtin_sub_overflow(a, b, &result);
+            else return __builtin_mul_overflow(a, b, &result);
+        #endif
+    }
+
+    // True if the true result of a op b is negative. (Only needed, and only correct, if it overflowed TR.)
+    template <op Op, typename TR, typename T1, typename T2>
+    constexpr bool overflow_is_negative(T1 a, T2 b) noexcept
+    {
+        if constexpr(Op == op::mul)
+            return is_negative(a) != is_negative(b);
+        else if constexpr(std::is_same_v<T1, TR> && std::is_same_v<T2, TR>)
+        {
+            // Same types: signed a + b can only overflow below the minimum if b < 0, and a - b if b > 0. Unsigned a - b can only go below 0.
+            if constexpr(Op == op::add) return is_negative(b);
+            else if constexpr(std::is_signed_v<TR>) return b > 0;
+            else return true;
+        }
+        else
+        {
+            // (Exact for any combination of 64-bit or smaller types.)
+            static_assert(sizeof(T1) <= 8 && sizeof(T2) <= 8);
+            if constexpr(Op == op::add) return (__int128)a + (__int128)b < 0;
+            else return (__int128)a - (__int128)b < 0;
+        }
+    }
+
+    template <op Op, overflow_policy Policy, typename TR, typename T1, typename T2>
+    constexpr TR apply(T1 a, T2 b) noexcept(Policy != overflow_policy::throw_exception)
+    {
+        static_assert(std::is_integral_v<TR> && std::is_integral_v<T1> && std::is_integral_v<T2>);
+        TR result;
+        const bool overflow = overflowed<Op>(a, b, result);
+        if constexpr(Policy == overflow_policy::wrap)
+        {
+            return result;
+        }
+        else if constexpr(Policy == overflow_policy::saturate && Op != op::mul && std::is_same_v<T1, TR> && std::is_same_v<T2, TR>)
+        {
+            // Same as below, but with the overflow test done with bit operations, so loops using this can also be vectorized.
+            using U = std::make_unsigned_t<TR>;
+            const TR r = (TR)(Op == op::add ? (U)a + (U)b : (U)a - (U)b);
+            if constexpr(std::is_signed_v<TR>)
+            {
+                // If a + b or a - b overflowed, the true result has the same sign as a: minimum (max + 1) if negative, else maximum.
+                const TR limit = (TR)(((U)a >> (sizeof(TR) * 8 - 1)) + (U)std::numeric_limits<TR>::max());
+                const bool over = (TR)(Op == op::add ? (a ^ r) & (b ^ r) : (a ^ b) & (a ^ r)) < 0;
+                return over ? limit : r;
+            }
+            else if constexpr(Op == op::add)
+                return r < a ? std::numeric_limits<TR>::max() : r;
+            else
+                return a < b ? (TR)0 : r;
+        }
+        else if constexpr(Policy == overflow_policy::saturate)
+        {
+            // Select (rather than branch) between saturated value and result, which compiles to conditional moves.
+            const TR limit = overflow_is_negative<Op, TR>(a, b) ? std::numeric_limits<TR>::min() : std::numeric_limits<TR>::max();
+            return overflow ? limit : result;
+        }
+        else
+        {
+            if(overflow) [[unlikely]]
+            {
+                if constexpr(Policy == overflow_policy::throw_exception)
+                    throw std::overflow_error(Op == op::add ? "addition overflow" : Op == op::sub ? "subtraction overflow" : "multiplication overflow");
+                else
+                    abort();
+            }
+            return result;
+        }
+    }
+
+} // end namespace checked_integer_math_private
+
+
+template <typename TR, overflow_policy Policy = CHECKED_INTEGER_MATH_DEFAULT_POLICY, typename T1, typename T2>
+inline constexpr TR checked_add(T1 a, T2 b) noexcept(Policy != overflow_policy::throw_exception)
 {
-    TR result;
-    #if defined(_c_lib_stdckdint)
-        bool overflow = ckd_add(&result, a, b);
-    #else
-        bool overflow = __builtin_add_overflow(a, b, &result);
-    #endif
+    return checked_integer_math_private::apply<checked_integer_math_private::op::add, Policy, TR>(a, b);
+} 
 
-    // todo compile time option to choose to either abort() or throw exception. (and need to remove noexcept)
-    if(overflow) [[unlikely]]
-        abort();
-        //throw std::overflow_error("addition overflow"); 
+template <typename TR, overflow_policy Policy = CHECKED_INTEGER_MATH_DEFAULT_POLICY, typename T1, typename T2>
+inline constexpr TR checked_sub(T1 a, T2 b) noexcept(Policy != overflow_policy::throw_exception)
+{
+    return checked_integer_math_private::apply<checked_integer_math_private::op::sub, Policy, TR>(a, b);
+} 
 
-    return result;
+template <typename TR, overflow_policy Policy = CHECKED_INTEGER_MATH_DEFAULT_POLICY, typename T1, typename T2>
+inline constexpr TR checked_mul(T1 a, T2 b) noexcept(Policy != overflow_policy::throw_exception)
+{
+    return checked_integer_math_private::apply<checked_integer_math_private::op::mul, Policy, TR>(a, b);
 } 
 
+// Saturating arithmetic (branch-free): result is clamped to the range of TR.
 template <typename TR, typename T1, typename T2>
-inline constexpr TR checked_sub(T1 a, T2 b) noexcept
-{
-    TR result;
-    #if defined(_c_lib_stdckdint)
-        bool overflow = ckd_sub(&result, a, b);
-    #else
-        bool overflow = __builtin_sub_overflow(a, b, &result);
-    #endif
+inline constexpr TR saturating_add(T1 a, T2 b) noexcept { return checked_add<TR, overflow_policy::saturate>(a, b); }
 
-    // todo compile time option to choose to either abort() or throw exception. (and need to remove noexcept)
-    if(overflow) [[unlikely]]
-        abort();
-        //throw std::overflow_error("addition overflow"); 
+template <typename TR, typename T1, typename T2>
+inline constexpr TR saturating_sub(T1 a, T2 b) noexcept { return checked_sub<TR, overflow_policy::saturate>(a, b); }
 
-    return result;
-} 
+template <typename TR, typename T1, typename T2>
+inline constexpr TR saturating_mul(T1 a, T2 b) noexcept { return checked_mul<TR, overflow_policy::saturate>(a, b); }
+
+// Wrapping arithmetic: result is modulo 2^N (without undefined behavior for signed types).
+template <typename TR, typename T1, typename T2>
+inline constexpr TR wrapping_add(T1 a, T2 b) noexcept { return checked_add<TR, overflow_policy::wrap>(a, b); }
+
+template <typename TR, typename T1, typename T2>
+inline constexpr TR wrapping_sub(T1 a, T2 b) noexcept { return checked_sub<TR, overflow_policy::wrap>(a, b); }
 
 template <typename TR, typename T1, typename T2>
-inline constexpr TR checked_mul(T1 a, T2 b) noexcept
+inline constexpr TR wrapping_mul(T1 a, T2 b) noexcept { return checked_mul<TR, overflow_policy::wrap>(a, b); }
+
+// Return the result, or std::nullopt if it overflows TR.
+template <typename TR, typename T1, typename T2>
+inline constexpr std::optional<TR> try_add(T1 a, T2 b) noexcept
 {
-    TR result;
-    #if defined(_c_lib_stdckdint)
-        bool overflow = ckd_mul(&result, a, b);
-    #else
-        bool overflow = __builtin_mul_overflow(a, b, &result);
-    #endif
+    TR r;
+    if(checked_integer_math_private::overflowed<checked_integer_math_private::op::add>(a, b, r)) [[unlikely]]
+        return std::nullopt;
+    return r;
+}
 
-    // todo compile time option to choose to either abort() or throw exception. (and need to remove noexcept)
-    if(overflow) [[unlikely]]
-        abort();
-        //throw std::overflow_error("addition overflow"); 
+template <typename TR, typename T1, typename T2>
+inline constexpr std::optional<TR> try_sub(T1 a, T2 b) noexcept
+{
+    TR r;
+    if(checked_integer_math_private::overflowed<checked_integer_math_private::op::sub>(a, b, r)) [[unlikely]]
+        return std::nullopt;
+    return r;
+}
 
-    return result;
-} 
+template <typename TR, typename T1, typename T2>
+inline constexpr std::optional<TR> try_mul(T1 a, T2 b) noexcept
+{
+    TR r;
+    if(checked_integer_math_private::overflowed<checked_integer_math_private::op::mul>(a, b, r)) [[unlikely]]
+        return std::nullopt;
+    return r;
+}
+
+
+
+/* Batch versions: out[i] = a[i] op b[i] for each i (all spans must have the same size), with the result modulo 2^N if it
+   overflows.  Returns the index of the first element that overflowed, or std::nullopt if none did.
+   To allow the compiler to vectorize the loop (-O2 or -O3), there is no branch for each element: elements are processed in
+   blocks, and the overflow conditions for a block are combined with bitwise OR, and then tested once for the block (the
+   block is then checked again one element at a time to find the index).  out may be the same as a or b, to compute the
+   result in place (but must not otherwise overlap them); each block of an input that is overwritten is then copied first,
+   so that it can still be checked again. For mul, the product is computed in a type with twice the number of bits (up to
+   32 bit types); 64 bit types use __builtin_mul_overflow() for each element, but still only test the combined flags once
+   for each block.
+ */
+
+namespace checked_integer_math_private {
+
+    inline constexpr size_t batch_block_size = 64;
+
+    template <typename T> struct wider;
+    template <> struct wider<int8_t> { using type = int16_t; };
+    template <> struct wider<uint8_t> { using type = uint16_t; };
+    template <> struct wider<int16_t> { using type = int32_t; };
+    template <> struct wider<uint16_t> { using type = uint32_t; };
+    template <> struct wider<int32_t> { using type = int64_t; };
+    template <> struct wider<uint32_t> { using type = uint64_t; };
+
+    // x86 has no signed 32 x 32 -> 64 bit vector multiply before SSE4.1 (pmuldq), so the wide product isn't vectorized, and
+    // __builtin_mul_overflow() is faster.
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(__SSE4_1__)
+    inline constexpr bool vector_signed_mul32 = false;
+#else
+    inline constexpr bool vector_signed_mul32 = true;
+#endif
+
+    template <typename T>
+    inline constexpr bool use_wide_mul = requires { typename wider<T>::type; } && (sizeof(T) < 4 || std::is_unsigned_v<T> || vector_signed_mul32);
+
+    // Compute out[i] = a[i] op b[i] for i in [0, n) and return nonzero if any overflowed.
+    template <op Op, typename T>
+    inline T block(const T *a, const T *b, T *out, size_t n) noexcept
+    {
+        using U = std::make_unsigned_t<T>;
+        T flags = 0;
+        for(size_t i = 0; i < n; ++i)
+        {
+            const T x = a[i];
+            const T y = b[i];
+            if constexpr(Op == op::add)
+            {
+                const T r = (T)((U)x + (U)y);
+                out[i] = r;
+                if constexpr(std::is_signed_v<T>)
+                    flags |= (T)((x ^ r) & (y ^ r)); // sign bit set if x and y have the same sign and r has the other sign
+                else
+                    flags |= (T)(r < x);
+            }
+            else if constexpr(Op == op::sub)
+            {
+                const T r = (T)((U)x - (U)y);
+                out[i] = r;
+                if constexpr(std::is_signed_v<T>)
+                    flags |= (T)((x ^ y) & (x ^ r)); // sign bit set if x and y have different signs and r has the sign of y
+                else
+                    flags |= (T)(x < y);
+            }
+            else if constexpr(use_wide_mul<T>)
+            {
+                // The product fits in T if the high half of the wide product is just the sign extension of the low half
+                // (which compiles to a high and low half multiply, e.g. pmulhw and pmullw, and no widening of the vectors).
+                using W = typename wider<T>::type;
+                const W wide = (W)x * (W)y;
+                const T r = (T)wide;
+                const T high = (T)(wide >> (sizeof(T) * 8));
+                out[i] = r;
+                if constexpr(std::is_signed_v<T>)
+                    flags |= (T)(high ^ (T)(r >> (sizeof(T) * 8 - 1)));
+                else
+                    flags |= high;
+            }
+            else
+            {
+                T r;
+                flags |= (T)__builtin_mul_overflow(x, y, &r);
+                out[i] = r;
+            }
+        }
+        if constexpr(std::is_signed_v<T> && Op != op::mul)
+            return (T)(flags < 0);
+        else
+            return flags;
+    }
+
+    template <op Op, typename T>
+    std::optional<size_t> batch(std::span<const T> a, std::span<const T> b, std::span<T> out) noexcept
+    {
+        static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>);
+        const size_t n = std::min({a.size(), b.size(), out.size()});
+        const bool a_overwritten = a.data() == out.data();
+        const bool b_overwritten = b.data() == out.data();
+        T saved_a[batch_block_size];
+        T saved_b[batch_block_size];
+        for(size_t begin = 0; begin < n; begin += batch_block_size)
+        {
+            const size_t len = std::min(n - begin, batch_block_size);
+            const T *pa = a.data() + begin;
+            const T *pb = b.data() + begin;
+            if(a_overwritten) [[unlikely]]
+                pa = std::copy_n(pa, len, saved_a) - len;
+            if(b_overwritten) [[unlikely]]
+                pb = a_overwritten ? saved_a : std::copy_n(pb, len, saved_b) - len;
+            if(block<Op>(pa, pb, out.data() + begin, len)) [[unlikely]]
+            {
+                for(size_t i = 0; i < len; ++i)
+                {
+                    T r;
+                    if(overflowed<Op>(pa[i], pb[i], r))
+                    {
+                        // (finish computing the rest of out)
+                        const size_t end = begin + len;
+                        if(end < n)
+                            batch<Op, T>(a.subspan(end), b.subspan(end), out.subspan(end));
+                        return begin + i;
+                    }
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
+} // end namespace checked_integer_math_private
+
+template <typename T>
+inline std::optional<size_t> checked_add(std::span<const T> a, std::span<const T> b, std::span<T> out) noexcept
+{
+    return checked_integer_math_private::batch<checked_integer_math_private::op::add, T>(a, b, out);
+}
+
+template <typename T>
+inline std::optional<size_t> checked_sub(std::span<const T> a, std::span<const T> b, std::span<T> out) noexcept
+{
+    return checked_integer_math_private::batch<checked_integer_math_private::op::sub, T>(a, b, out);
+}
+
+template <typename T>
+inline std::optional<size_t> checked_mul(std::span<const T> a, std::span<const T> b, std::span<T> out) noexcept
+{
+    return checked_integer_math_private::batch<checked_integer_math_private::op::mul, T>(a, b, out);
+}
+
+
+
+/* bounded<T, Min, Max>: an integer value of type T which is known (at compile time) to be in the range [Min, Max].
+   Arithmetic operators on bounded values compute the range of the result at compile time, and only check for
+   overflow (with checked_add() etc. and the default overflow policy) if that range might not fit in the result type,
+   otherwise the result is computed without any check. The result type is std::common_type_t of the operand types,
+   and the result has the computed range (limited to the range of the result type, if checked).
+   For example, if i is a bounded<size_t, 0, Capacity-1> then i + bounded_constant<size_t(1)> is a
+   bounded<size_t, 1, Capacity> computed with a plain addition, while adding two unbounded size_t values is checked.
+   Converting to a bounded type with a smaller range (or from a plain integer) is explicit, and checks the value (abort,
+   throw std::overflow_error or saturate, depending on CHECKED_INTEGER_MATH_DEFAULT_POLICY). Converting to a bounded
+   type whose range includes the source range is implicit and free. bounded converts implicitly to T.  In arithmetic with a
+   bounded value, a plain integer of type U is treated as checked<U> (so checked<int>(x) + 1 is checked, and is a checked<int>).
+   checked<T> is bounded<T> with the full range of T (so all arithmetic is checked, unless combined with narrower bounded values).
+   Requires 64-bit or smaller types; range calculations use __int128.
+ */
+
+template <typename T, T Min = std::numeric_limits<T>::min(), T Max = std::numeric_limits<T>::max()>
+class bounded;
+
+namespace checked_integer_math_private {
+
+    template <typename T> inline constexpr bool is_bounded = false;
+    template <typename T, T Min, T Max> inline constexpr bool is_bounded<bounded<T, Min, Max>> = true;
+
+    // True if U is a bounded type with a range inside [Min, Max].
+    template <typename U, auto Min, auto Max>
+    constexpr bool bounded_within() noexcept
+    {
+        if constexpr(is_bounded<U>)
+            return std::cmp_greater_equal(U::min_value, Min) && std::cmp_less_equal(U::max_value, Max);
+        else
+            return false;
+    }
+
+    struct value_range
+    {
+        __int128 min;
+        __int128 max;
+        bool exact = true; // (false if an end of the range could not be computed in __int128)
+    };
+
+    template <typename T> constexpr value_range range_of = {std::numeric_limits<T>::min(), std::numeric_limits<T>::max()};
+
+    template <typename R>
+    constexpr bool range_fits(value_range r) noexcept
+    {
+        return r.exact && r.min >= std::numeric_limits<R>::min() && r.max <= std::numeric_limits<R>::max();
+    }
+
+    // Range of results that can actually be returned in R (after a checked operation).
+    template <typename R>
+    constexpr value_range clamp_range(value_range r) noexcept
+    {
+        if(!r.exact)
+            return range_of<R>;
+        return {std::max<__int128>(r.min, std::numeric_limits<R>::min()), std::min<__int128>(r.max, std::numeric_limits<R>::max())};
+    }
+
+    template <op Op>
+    constexpr value_range result_range(value_range a, value_range b) noexcept
+    {
+        if constexpr(Op == op::add)
+            return {a.min + b.min, a.max + b.max};
+        else if constexpr(Op == op::sub)
+            return {a.min - b.max, a.max - b.min};
+        else
+        {
+            // (The product of the maximum 64-bit unsigned values does not fit in __int128.)
+            const __int128 ends[4][2] = {{a.min, b.min}, {a.min, b.max}, {a.max, b.min}, {a.max, b.max}};
+            value_range r{0, 0};
+            for(int i = 0; i < 4; ++i)
+            {
+                __int128 p = 0;
+                if(__builtin_mul_overflow(ends[i][0], ends[i][1], &p))
+                    return {0, 0, false};
+                r.min = (i == 0) ? p : std::min(r.min, p);
+                r.max = (i == 0) ? p : std::max(r.max, p);
+            }
+            return r;
+        }
+    }
+
+    template <op Op, typename T1, T1 Min1, T1 Max1, typename T2, T2 Min2, T2 Max2>
+    struct bounded_result
+    {
+        using value_type = std::common_type_t<T1, T2>;
+        static constexpr value_range range = result_range<Op>({Min1, Max1}, {Min2, Max2});
+        static constexpr bool needs_check = !range_fits<value_type>(range);
+        static constexpr value_range result = clamp_range<value_type>(range);
+        using type = bounded<value_type, (value_type)result.min, (value_type)result.max>;
+    };
+
+    template <op Op, typename T1, T1 Min1, T1 Max1, typename T2, T2 Min2, T2 Max2>
+    constexpr auto bounded_op(bounded<T1, Min1, Max1> a, bounded<T2, Min2, Max2> b)
+        noexcept(CHECKED_INTEGER_MATH_DEFAULT_POLICY != overflow_policy::throw_exception || !bounded_result<Op, T1, Min1, Max1, T2, Min2, Max2>::needs_check)
+    {
+        using result = bounded_result<Op, T1, Min1, Max1, T2, Min2, Max2>;
+        using R = typename result::value_type;
+        // If no check is needed, the wrapping version never actually wraps, but avoids undefined behavior warnings and
+        // compiles to the plain operation.
+        constexpr overflow_policy policy = result::needs_check ? CHECKED_INTEGER_MATH_DEFAULT_POLICY : overflow_policy::wrap;
+        return result::type::assume(apply<Op, policy, R>(a.value(), b.value()));
+    }
+
+} // end namespace checked_integer_math_private
+
+template <typename T, T Min, T Max>
+class bounded
+{
+    static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool> && sizeof(T) <= 8);
+    static_assert(Min <= Max);
+    static_assert(CHECKED_INTEGER_MATH_DEFAULT_POLICY != overflow_policy::wrap, "bounded: wrap overflow policy can't keep values in range");
+
+public:
+    using value_type = T;
+    static constexpr T min_value = Min;
+    static constexpr T max_value = Max;
+
+    constexpr bounded() noexcept requires(Min <= 0 && 0 <= Max) : v(0) {}
+
+    // Check that x is in range. (Implicit if U is a bounded type with a range inside [Min, Max], with no check.)
+    template <typename U>
+    explicit(!checked_integer_math_private::bounded_within<U, Min, Max>()) constexpr bounded(U x) noexcept(checked_integer_math_private::bounded_within<U, Min, Max>() || CHECKED_INTEGER_MATH_DEFAULT_POLICY != overflow_policy::throw_exception)
+        : v(to_range(x))
+    {
+    }
+
+    // Use x without any check; x must be in range.
+    static constexpr bounded assume(T x) noexcept
+    {
+        bounded b{uninitialized{}};
+        b.v = x;
+        return b;
+    }
+
+    // Return std::nullopt if x is outside [Min, Max].
+    template <std::integral U>
+    static constexpr std::optional<bounded> try_make(U x) noexcept
+    {
+        if(std::cmp_less(x, Min) || std::cmp_greater(x, Max))
+            return std::nullopt;
+        return assume((T)x);
+    }
+
+    constexpr T value() const noexcept { return v; }
+    constexpr operator T() const noexcept { return v; }
+
+    template <typename U>
+    constexpr bounded& operator+=(U x) { return *this = bounded(*this + as_bounded(x)); }
+    template <typename U>
+    constexpr bounded& operator-=(U x) { return *this = bounded(*this - as_bounded(x)); }
+    template <typename U>
+    constexpr bounded& operator*=(U x) { return *this = bounded(*this * as_bounded(x)); }
+
+private:
+    struct uninitialized {};
+    constexpr explicit bounded(uninitialized) noexcept {}
+
+    template <typename U>
+    static constexpr auto as_bounded(U x)
+    {
+        if constexpr(checked_integer_math_private::is_bounded<U>)
+            return x;
+        else
+            return bounded<U>(x);
+    }
+
+    template <typename U>
+    static constexpr T to_range(U x)
+    {
+        if constexpr(checked_integer_math_private::is_bounded<U>)
+        {
+            if constexpr(checked_integer_math_private::bounded_within<U, Min, Max>())
+                return (T)x.value();
+            else
+                return to_range(x.value());
+        }
+        else
+        {
+            static_assert(std::is_integral_v<U>);
+            const bool below = std::cmp_less(x, Min);
+            const bool above = std::cmp_greater(x, Max);
+            if constexpr(CHECKED_INTEGER_MATH_DEFAULT_POLICY == overflow_policy::saturate)
+                return below ? Min : above ? Max : (T)x;
+            else
+            {
+                if(below || above) [[unlikely]]
+                {
+                    if constexpr(CHECKED_INTEGER_MATH_DEFAULT_POLICY == overflow_policy::throw_exception)
+                        throw std::overflow_error("value out of range");
+                    else
+                        abort();
+                }
+                return (T)x;
+            }
+        }
+    }
+
+    T v;
+};
+
+template <typename T>
+using checked = bounded<T>;
+
+// bounded value with range [V, V].
+template <auto V>
+inline constexpr bounded<decltype(V), V, V> bounded_constant = bounded<decltype(V), V, V>::assume(V);
+
+template <typename T1, T1 Min1, T1 Max1, typename T2, T2 Min2, T2 Max2>
+constexpr auto operator+(bounded<T1, Min1, Max1> a, bounded<T2, Min2, Max2> b) noexcept(noexcept(checked_integer_math_private::bounded_op<checked_integer_math_private::op::add>(a, b)))
+{
+    return checked_integer_math_private::bounded_op<checked_integer_math_private::op::add>(a, b);
+}
+
+template <typename T1, T1 Min1, T1 Max1, typename T2, T2 Min2, T2 Max2>
+constexpr auto operator-(bounded<T1, Min1, Max1> a, bounded<T2, Min2, Max2> b) noexcept(noexcept(checked_integer_math_private::bounded_op<checked_integer_math_private::op::sub>(a, b)))
+{
+    return checked_integer_math_private::bounded_op<checked_integer_math_private::op::sub>(a, b);
+}
+
+template <typename T1, T1 Min1, T1 Max1, typename T2, T2 Min2, T2 Max2>
+constexpr auto operator*(bounded<T1, Min1, Max1> a, bounded<T2, Min2, Max2> b) noexcept(noexcept(checked_integer_math_private::bounded_op<checked_integer_math_private::op::mul>(a, b)))
+{
+    return checked_integer_math_private::bounded_op<checked_integer_math_private::op::mul>(a, b);
+}
+
+template <typename T1, T1 Min1, T1 Max1, typename U> requires(std::is_integral_v<U> && !std::is_same_v<U, bool>)
+constexpr auto operator+(bounded<T1, Min1, Max1> a, U b) noexcept(noexcept(a + bounded<U>(b)))
+{
+    return a + bounded<U>(b);
+}
+
+template <typename U, typename T2, T2 Min2, T2 Max2> requires(std::is_integral_v<U> && !std::is_same_v<U, bool>)
+constexpr auto operator+(U a, bounded<T2, Min2, Max2> b) noexcept(noexcept(bounded<U>(a) + b))
+{
+    return bounded<U>(a) + b;
+}
+
+template <typename T1, T1 Min1, T1 Max1, typename U> requires(std::is_integral_v<U> && !std::is_same_v<U, bool>)
+constexpr auto operator-(bounded<T1, Min1, Max1> a, U b) noexcept(noexcept(a - bounded<U>(b)))
+{
+    return a - bounded<U>(b);
+}
+
+template <typename U, typename T2, T2 Min2, T2 Max2> requires(std::is_integral_v<U> && !std::is_same_v<U, bool>)
+constexpr auto operator-(U a, bounded<T2, Min2, Max2> b) noexcept(noexcept(bounded<U>(a) - b))
+{
+    return bounded<U>(a) - b;
+}
+
+template <typename T1, T1 Min1, T1 Max1, typename U> requires(std::is_integral_v<U> && !std::is_same_v<U, bool>)
+constexpr auto operator*(bounded<T1, Min1, Max1> a, U b) noexcept(noexcept(a * bounded<U>(b)))
+{
+    return a * bounded<U>(b);
+}
+
+template <typename U, typename T2, T2 Min2, T2 Max2> requires(std::is_integral_v<U> && !std::is_same_v<U, bool>)
+constexpr auto operator*(U a, bounded<T2, Min2, Max2> b) noexcept(noexcept(bounded<U>(a) * b))
+{
+    return bounded<U>(a) * b;
+}
 
 
 
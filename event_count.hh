@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+
+#if defined(__linux__) && !defined(EVENT_COUNT_NO_FUTEX)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "ring_buffer.hh"
+
+namespace rhm {
+
+namespace _private {
+  // Hint to the CPU that we are in a spin loop.
+  inline void cpu_relax() noexcept
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+  }
+}
+
+/** @brief Lets threads sleep until some condition becomes true, without a mutex, and notify them cheaply.
+
+    An event count is like a condition variable for lock-free data structures (such as rhm::spsc_ring_buffer
+    or rhm::mpmc_queue): the condition is checked and changed without a lock, and the event count is only
+    used to sleep when the condition is false, and to wake sleeping threads when it may have changed. (Based on
+    the event count described by Dmitry Vyukov, <https://www.1024cores.net/home/lock-free-algorithms/eventcounts>.)
+
+    A waiting thread calls prepare_wait(), checks its condition again, then either calls cancel_wait() (if the
+    condition is now true) or wait() with the key returned by prepare_wait(), which sleeps until a notify_one() or notify_all() after prepare_wait().
+    A notification between prepare_wait() and wait() is therefore never lost. await() does all of this for a
+    given predicate:
+    @code
+      // consumer:
+      buffer_ready.await([&] { return !buffer.empty(); });
+      // producer:
+      buffer.try_push(item);
+      buffer_ready.notify_one();
+    @endcode
+
+    Waiting uses a futex on Linux (or C++20 std::atomic::wait() otherwise), on a 32-bit epoch counter that is
+    incremented by each notification. Notifying first checks a count of waiting threads, and if there are none,
+    does no atomic read-modify-write and no system call, so notify_one() and notify_all() can be called after every
+    change (e.g. every push) at very little cost when the consumer is not sleeping. (Define EVENT_COUNT_NO_FUTEX
+    to use std::atomic::wait() on Linux as well.)
+
+    @note Requires C++20 mode when compiling.
+ */
+class event_count
+{
+public:
+  /** Returned by prepare_wait(), to be passed to wait(). */
+  using key = uint32_t;
+
+  event_count() noexcept = default;
+  event_count(const event_count&) = delete;
+  event_count& operator=(const event_count&) = delete;
+
+  /** Announce that this thread is about to wait.  Check the condition after this, then call either wait() or cancel_wait(). */
+  key prepare_wait() noexcept
+  {
+    return epoch_of(state.fetch_add(1, std::memory_order_seq_cst));
+  }
+
+  /** Don't wait after prepare_wait() returned @a k (the condition became true). */
+  void cancel_wait(key k) noexcept
+  {
+    // If there has been a notification since prepare_wait(), it has already removed a waiter from the count (this one
+    // or another). It's possible that the count is now one more than the number of threads actually waiting, which
+    // only causes one unnecessary wake up system call.
+    uint64_t s = state.load(std::memory_order_relaxed);
+    while(epoch_of(s) == k && waiters_of(s) > 0)
+      if(state.compare_exchange_weak(s, s - 1, std::memory_order_relaxed))
+        break;
+  }
+
+  /** Sleep until notified after the prepare_wait() call that returned @a k. (Returns immediately if that has already happened.) */
+  void wait(key k) noexcept
+  {
+    for(;;)
+    {
+      const uint64_t s = state.load(std::memory_order_acquire);
+      if(epoch_of(s) != k)
+        break;
+#if defined(__linux__) && !defined(EVENT_COUNT_NO_FUTEX)
+      futex(FUTEX_WAIT_PRIVATE, k);
+#else
+      state.wait(s, std::memory_order_acquire);
+#endif
+    }
+  }
+
+  /** Wake one waiting thread, if any are waiting. */
+  void notify_one() noexcept
+  {
+    if(begin_notify(false)) [[unlikely]]
+    {
+#if defined(__linux__) && !defined(EVENT_COUNT_NO_FUTEX)
+      futex(FUTEX_WAKE_PRIVATE, 1);
+#else
+      state.notify_all(); // (other waiters will see that the epoch has not changed since their prepare_wait(), and wait again)
+#endif
+    }
+  }
+
+  /** Wake all waiting threads. */
+  void notify_all() noexcept
+  {
+    if(begin_notify(true)) [[unlikely]]
+    {
+#if defined(__linux__) && !defined(EVENT_COUNT_NO_FUTEX)
+      futex(FUTEX_WAKE_PRIVATE, INT32_MAX);
+#else
+      state.notify_all();
+#endif
+    }
+  }
+
+  /** Return when @a condition() returns true, sleeping on this event count while it is false.  @a condition must
+      become true only in a thread which then calls notify_one() or notify_all().  If @a spin is nonzero, @a condition
+      is first checked up to @a spin times before sleeping (which can avoid sleeping if it will soon become true, at
+      the cost of using the CPU while spinning).
+   */
+  template<typename PredT>
+  void await(PredT&& condition, unsigned int spin = 0)
+  {
+    for(unsigned int i = 0; i < spin; ++i)
+    {
+      if(condition())
+        return;
+      _private::cpu_relax();
+    }
+    while(!condition())
+    {
+      const key k = prepare_wait();
+      if(condition())
+      {
+        cancel_wait(k);
+        return;
+      }
+      wait(k);
+    }
+  }
+
+  /** Approximate number of threads waiting (after prepare_wait(), and not yet notified or cancelled). */
+  uint32_t waiting() const noexcept { return waiters_of(state.load(std::memory_order_relaxed)); }
+
+private:
+  // state holds the epoch (incremented by each notification) in the upper 32 bits, and the number of waiting threads in
+  // the lower 32 bits, so that a notification can increment the epoch and remove the thread(s) it wakes from the
+  // count in one atomic operation. Then, once a waiting thread has been notified, further notifications don't make
+  // any system calls until a thread waits again.
+  static constexpr uint64_t epoch_one = uint64_t(1) << 32;
+  static key epoch_of(uint64_t s) noexcept { return (key)(s >> 32); }
+  static uint32_t waiters_of(uint64_t s) noexcept { return (uint32_t)s; }
+
+  // The sequentially consistent fence and load make sure that either we see the waiter count incremented by
+  // prepare_wait(), or the waiting thread sees the change to its condition (made before the notify call)
+  // when it checks it again after prepare_wait().
+  bool begin_notify(bool all) noexcept
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t s = state.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      if(waiters_of(s) == 0)
+        return false;
+      const uint64_t next = all ? (uint64_t)(epoch_of(s) + 1) << 32 : s + epoch_one - 1;
+      if(state.compare_exchange_weak(s, next, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return true;
+    }
+  }
+
+#if defined(__linux__) && !defined(EVENT_COUNT_NO_FUTEX)
+  // Wait for or wake threads sleeping on the epoch half of state. (Used instead of std::atomic::wait() and
+  // notify_one() since in libstdc++ these spin and yield for a while before sleeping, which is much slower when
+  // the threads share a CPU, and keep their own count of waiting threads.)
+  void futex(int op, uint32_t val) noexcept
+  {
+    static_assert(sizeof(state) == sizeof(uint64_t));
+    uint32_t *epoch = reinterpret_cast<uint32_t*>(&state) + (std::endian::native == std::endian::little ? 1 : 0);
+    syscall(SYS_futex, epoch, op, val, nullptr, nullptr, 0);
+  }
+#endif
+
+  alignas(_private::cache_line_size) std::atomic<uint64_t> state{0};
+};
+
+} // end namespace rhm
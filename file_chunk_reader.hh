@@ -0,0 +1,1010 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "instrumentation_hooks.hh"
+
+#if defined(USE_ZLIB) && __has_include(<zlib.h>)
+#include <climits>
+#include <stdexcept>
+#include <zlib.h>
+#endif
+
+#if defined(USE_ZSTD) && __has_include(<zstd.h>)
+#include <deque>
+#include <future>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <zstd.h>
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace rhm {
+
+template<typename BackendT> class file_chunk_reader;
+
+/** Return a pointer to the first @a delim character in [@a p, @a end), or @a end if not found.
+    Compares 32 (AVX2) or 16 (SSE2, NEON) characters at a time, then uses memchr() for the remainder (or for everything
+    if none of those are available).
+ */
+inline const char* find_delimiter(const char *p, const char *end, char delim) noexcept
+{
+#if defined(__AVX2__)
+  const __m256i d = _mm256_set1_epi8(delim);
+  for(; end - p >= 32; p += 32)
+  {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const unsigned int m = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, d));
+    if(m != 0)
+      return p + __builtin_ctz(m);
+  }
+#elif defined(__SSE2__)
+  const __m128i d = _mm_set1_epi8(delim);
+  for(; end - p >= 16; p += 16)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const unsigned int m = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(v, d));
+    if(m != 0)
+      return p + __builtin_ctz(m);
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const uint8x16_t d = vdupq_n_u8((uint8_t)delim);
+  for(; end - p >= 16; p += 16)
+  {
+    const uint8x16_t eq = vceqq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(p)), d);
+    // Narrow each 8-bit comparison result to 4 bits, giving a 64-bit mask with 4 bits per character.
+    const uint64_t m = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    if(m != 0)
+      return p + (__builtin_ctzll(m) >> 2);
+  }
+#endif
+  const void *f = memchr(p, delim, (size_t)(end - p));
+  return f ? static_cast<const char*>(f) : end;
+}
+
+
+namespace _private {
+
+  // Throw std::system_error for errno, with a message containing the failed operation and the file path.
+  [[noreturn]] inline void throw_file_error(const char *what, const std::filesystem::path& path)
+  {
+    const int err = errno;
+    std::string msg(what);
+    msg += ": \"";
+    msg += path.c_str();
+    msg += "\"";
+    throw std::system_error(err, std::system_category(), msg);
+  }
+
+  inline int open_file(const std::filesystem::path& path)
+  {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+      throw_file_error("open", path);
+    return fd;
+  }
+
+} // end namespace _private
+
+
+/** @brief Reads lines with getdelim() into a single buffer owned by the backend, which getdelim() enlarges as needed.
+
+    This is the approach used by FileChunkReader in read_file_lines_as_range_2.cc. It works with any file (including
+    pipes and other non-seekable files), but each line is copied from stdio's buffer into the line buffer.
+ */
+class getdelim_backend
+{
+  FILE *fp = nullptr;
+  int delimiter = 0;
+  char *buf = nullptr;  // allocated by getdelim(), freed by destructor
+  size_t bufsize = 0;
+  size_t linelen = 0;
+  bool done = false;
+
+  void close() noexcept
+  {
+    if(buf)
+      free(buf);
+    buf = nullptr;
+    bufsize = 0;
+    if(fp)
+    {
+      [[maybe_unused]] const int err = fclose(fp);
+      assert(err == 0);
+    }
+    fp = nullptr;
+  }
+
+public:
+  /** True if lines remain valid after the next read_line() (i.e. they point into memory that isn't reused). */
+  static constexpr bool stable_lines = false;
+
+  getdelim_backend(const std::filesystem::path& path, char delim) : delimiter(delim)
+  {
+    fp = fopen(path.c_str(), "r");
+    if(!fp)
+      _private::throw_file_error("fopen", path);
+  }
+
+  getdelim_backend(const getdelim_backend&) = delete;
+  getdelim_backend& operator=(const getdelim_backend&) = delete;
+
+  // The line buffer is transferred, not reallocated (or leaked).
+  getdelim_backend(getdelim_backend&& old) noexcept :
+    fp(std::exchange(old.fp, nullptr)), delimiter(old.delimiter), buf(std::exchange(old.buf, nullptr)),
+    bufsize(std::exchange(old.bufsize, 0)), linelen(std::exchange(old.linelen, 0)), done(std::exchange(old.done, true))
+  {
+  }
+
+  getdelim_backend& operator=(getdelim_backend&& old) noexcept
+  {
+    if(this != &old)
+    {
+      close();
+      fp = std::exchange(old.fp, nullptr);
+      delimiter = old.delimiter;
+      buf = std::exchange(old.buf, nullptr);
+      bufsize = std::exchange(old.bufsize, 0);
+      linelen = std::exchange(old.linelen, 0);
+      done = std::exchange(old.done, true);
+    }
+    return *this;
+  }
+
+  ~getdelim_backend() noexcept
+  {
+    close();
+  }
+
+  /** Read the next line into the buffer. May throw std::system_error. */
+  void read_line()
+  {
+    const ssize_t r = getdelim(&buf, &bufsize, delimiter, fp);
+    if(r < 0) [[unlikely]]
+    {
+      linelen = 0;
+      done = true;
+      if(ferror(fp))
+        throw std::system_error(errno, std::system_category(), "getdelim");
+      return;
+    }
+    linelen = (size_t)r;
+  }
+
+  /** Current line (including delimiter). Valid until the next call to read_line(). */
+  std::string_view get_line() const noexcept { return std::string_view(buf, linelen); }
+
+  bool at_end() const noexcept { return done; }
+
+  /** Size of the line buffer */
+  size_t buffer_size() const noexcept { return bufsize; }
+};
+
+
+/** @brief Reads the file with read(); the simplest source for basic_block_backend. */
+class fd_source
+{
+  int fd = -1;
+
+public:
+  explicit fd_source(const std::filesystem::path& path) : fd(_private::open_file(path))
+  {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL); // only a hint, ignore errors
+  }
+
+  fd_source(const fd_source&) = delete;
+  fd_source& operator=(const fd_source&) = delete;
+
+  fd_source(fd_source&& old) noexcept : fd(std::exchange(old.fd, -1)) {}
+
+  fd_source& operator=(fd_source&& old) noexcept
+  {
+    if(this != &old)
+    {
+      if(fd >= 0)
+        ::close(fd);
+      fd = std::exchange(old.fd, -1);
+    }
+    return *this;
+  }
+
+  ~fd_source() noexcept
+  {
+    if(fd >= 0)
+      ::close(fd);
+  }
+
+  /** Read up to @a n bytes into @a p. Return the number of bytes read, 0 at end of file. May throw std::system_error. */
+  size_t read(char *p, size_t n)
+  {
+    ssize_t r;
+    do {
+      r = ::read(fd, p, n);
+    } while(r < 0 && errno == EINTR);
+    if(r < 0) [[unlikely]]
+      throw std::system_error(errno, std::system_category(), "read");
+    return (size_t)r;
+  }
+};
+
+
+/** @brief Reads data from SourceT in large blocks (block_size, default 1 MiB) into a reusable buffer, and finds
+    delimiters in it with find_delimiter().
+
+    SourceT is constructed from the file path (and any extra constructor arguments), and must have a method
+    size_t read(char *p, size_t n) which reads up to n bytes into p, returning 0 at the end.  fd_source reads the file
+    directly (block_read_backend); gzip_source and zstd_source decompress it straight into the block buffer
+    (gzip_backend, zstd_backend).
+
+    A line which continues past the end of the buffer is moved to the start of the buffer before the next block is
+    read, so lines are always contiguous (the buffer is only enlarged if a line is longer than the buffer). Lines are
+    not copied out of the buffer. (Same as BlockFileChunkReader in read_file_lines_as_range_2.cc.)
+ */
+template<typename SourceT>
+class basic_block_backend
+{
+public:
+  static constexpr size_t default_block_size = 1024 * 1024;
+  static constexpr bool stable_lines = false;
+
+private:
+  SourceT source;
+  char delimiter = 0;
+  std::vector<char> buf;
+  size_t filled = 0;     // number of bytes of file data in buf
+  size_t line_begin = 0; // current line is [line_begin, line_end) in buf
+  size_t line_end = 0;
+  bool eof = false;      // source has no more data
+  bool done = false;     // no more lines
+
+  // read more data into buf after 'filled', enlarging buf if full.
+  void read_block()
+  {
+    if(filled == buf.size())
+      buf.resize(buf.size() * 2);
+    rhm_instrument_scoped_timer("file_chunk_reader.read_block_ticks");
+    const size_t r = source.read(buf.data() + filled, buf.size() - filled);
+    rhm_instrument_record("file_chunk_reader.read_block_bytes", r);
+    if(r == 0)
+      eof = true;
+    filled += r;
+  }
+
+public:
+  /** Any arguments after @a block_size are passed to the SourceT constructor after @a path. */
+  template<typename... SourceArgs>
+  explicit basic_block_backend(const std::filesystem::path& path, char delim, size_t block_size = default_block_size, SourceArgs&&... args) :
+    source(path, std::forward<SourceArgs>(args)...), delimiter(delim), buf(block_size > 0 ? block_size : 1)
+  {
+  }
+
+  basic_block_backend(const basic_block_backend&) = delete;
+  basic_block_backend& operator=(const basic_block_backend&) = delete;
+
+  basic_block_backend(basic_block_backend&& old) noexcept :
+    source(std::move(old.source)), delimiter(old.delimiter), buf(std::move(old.buf)), filled(std::exchange(old.filled, 0)),
+    line_begin(std::exchange(old.line_begin, 0)), line_end(std::exchange(old.line_end, 0)), eof(std::exchange(old.eof, true)),
+    done(std::exchange(old.done, true))
+  {
+  }
+
+  basic_block_backend& operator=(basic_block_backend&& old) noexcept
+  {
+    if(this != &old)
+    {
+      source = std::move(old.source);
+      delimiter = old.delimiter;
+      buf = std::move(old.buf);
+      filled = std::exchange(old.filled, 0);
+      line_begin = std::exchange(old.line_begin, 0);
+      line_end = std::exchange(old.line_end, 0);
+      eof = std::exchange(old.eof, true);
+      done = std::exchange(old.done, true);
+    }
+    return *this;
+  }
+
+  /** Find the next line, reading more of the file if needed. May throw std::system_error (or std::runtime_error from a decompressing source). */
+  void read_line()
+  {
+    size_t pos = line_end;  // start of next line
+    size_t scan = pos;      // where to continue searching for the delimiter
+    for(;;)
+    {
+      const char *end = buf.data() + filled;
+      const char *d = find_delimiter(buf.data() + scan, end, delimiter);
+      if(d != end)
+      {
+        line_begin = pos;
+        line_end = (size_t)(d - buf.data()) + 1;
+        return;
+      }
+      if(eof)
+      {
+        // last line without a delimiter, or no more lines
+        line_begin = pos;
+        line_end = filled;
+        done = (pos == filled);
+        return;
+      }
+      // Move the partial line to the start of the buffer and read the next block after it.
+      const size_t partial = filled - pos;
+      if(pos > 0)
+        memmove(buf.data(), buf.data() + pos, partial);
+      filled = partial;
+      pos = 0;
+      scan = partial;
+      read_block();
+    }
+  }
+
+  /** Current line (including delimiter). Valid until the next call to read_line(). */
+  std::string_view get_line() const noexcept { return std::string_view(buf.data() + line_begin, line_end - line_begin); }
+
+  bool at_end() const noexcept { return done; }
+
+  /** Size of the block buffer */
+  size_t buffer_size() const noexcept { return buf.size(); }
+
+  const SourceT& data_source() const noexcept { return source; }
+};
+
+using block_read_backend = basic_block_backend<fd_source>;
+
+
+#if defined(USE_ZLIB) && __has_include(<zlib.h>)
+
+/** @brief Decompresses a gzip file with zlib (gzread()), for basic_block_backend.  Files with several gzip members
+    (e.g. concatenated with cat) are read as one stream.  (zlib also reads a file which isn't compressed unchanged.)
+    Define USE_ZLIB and link with -lz to use.
+ */
+class gzip_source
+{
+  gzFile gz = nullptr;
+
+public:
+  static constexpr unsigned int zlib_buffer_size = 128 * 1024;
+
+  explicit gzip_source(const std::filesystem::path& path)
+  {
+    gz = gzopen(path.c_str(), "rb");
+    if(!gz)
+      _private::throw_file_error("gzopen", path);
+    gzbuffer(gz, zlib_buffer_size); // larger than zlib's default of 8 KiB
+  }
+
+  gzip_source(const gzip_source&) = delete;
+  gzip_source& operator=(const gzip_source&) = delete;
+
+  gzip_source(gzip_source&& old) noexcept : gz(std::exchange(old.gz, nullptr)) {}
+
+  gzip_source& operator=(gzip_source&& old) noexcept
+  {
+    if(this != &old)
+    {
+      if(gz)
+        gzclose(gz);
+      gz = std::exchange(old.gz, nullptr);
+    }
+    return *this;
+  }
+
+  ~gzip_source() noexcept
+  {
+    if(gz)
+      gzclose(gz);
+  }
+
+  /** Decompress up to @a n bytes into @a p. Return the number of bytes, 0 at end of file. Throws std::system_error or std::runtime_error. */
+  size_t read(char *p, size_t n)
+  {
+    const int r = gzread(gz, p, (unsigned int) std::min<size_t>(n, INT_MAX));
+    if(r < 0) [[unlikely]]
+    {
+      int errnum = 0;
+      const char *msg = gzerror(gz, &errnum);
+      if(errnum == Z_ERRNO)
+        throw std::system_error(errno, std::system_category(), "gzread");
+      throw std::runtime_error(std::string("gzread: ") + msg);
+    }
+    return (size_t)r;
+  }
+};
+
+using gzip_backend = basic_block_backend<gzip_source>;
+using gzip_file_reader = file_chunk_reader<gzip_backend>;
+
+#endif
+
+
+#if defined(USE_ZSTD) && __has_include(<zstd.h>)
+
+/** @brief Decompresses a zstd file for basic_block_backend.
+
+    The file is mapped into memory with mmap().  If the file contains more than one zstd frame (e.g. written by pzstd,
+    or several .zst files concatenated), and @a threads is more than 1, then up to @a threads frames are decompressed
+    in parallel by other threads (with std::async()) while the caller reads lines from the current one, and each
+    frame's data is copied into the block buffer in order.  Each frame in progress is held in memory, so this uses
+    about threads * frame size of memory.  Otherwise (one frame, or @a threads is 1) the file is decompressed in the
+    calling thread, directly into the block buffer.
+
+    Define USE_ZSTD and link with -lzstd to use.
+ */
+class zstd_source
+{
+  struct dctx_deleter { void operator()(ZSTD_DCtx *d) const noexcept { ZSTD_freeDCtx(d); } };
+  using dctx_ptr = std::unique_ptr<ZSTD_DCtx, dctx_deleter>;
+
+  const char *data = nullptr;
+  size_t size = 0;
+
+  // single thread:
+  dctx_ptr dctx;
+  ZSTD_inBuffer input{nullptr, 0, 0};
+  bool frame_open = false;  // decoder has not finished the current frame
+
+  // multiple threads:
+  size_t nthreads = 1;
+  size_t next_frame = 0;    // offset in data of next frame to start decompressing
+  std::deque<std::future<std::vector<char>>> pending;
+  std::vector<char> frame;  // decompressed frame being read
+  size_t frame_pos = 0;
+
+  [[noreturn]] static void throw_zstd_error(size_t r)
+  {
+    throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(r));
+  }
+
+  static size_t check(size_t r)
+  {
+    if(ZSTD_isError(r)) [[unlikely]]
+      throw_zstd_error(r);
+    return r;
+  }
+
+  static size_t frame_size(const char *p, size_t n)
+  {
+    return check(ZSTD_findFrameCompressedSize(p, n));
+  }
+
+  // Decompress one frame (in another thread).
+  static std::vector<char> decompress_frame(const char *src, size_t srcsize)
+  {
+    dctx_ptr d(ZSTD_createDCtx());
+    if(!d)
+      throw std::bad_alloc();
+    const unsigned long long content_size = ZSTD_getFrameContentSize(src, srcsize);
+    const bool known = content_size != ZSTD_CONTENTSIZE_UNKNOWN && content_size != ZSTD_CONTENTSIZE_ERROR;
+    std::vector<char> out(known ? (size_t)content_size : std::max<size_t>(srcsize * 4, 64 * 1024));
+    ZSTD_inBuffer in{src, srcsize, 0};
+    ZSTD_outBuffer o{out.data(), out.size(), 0};
+    for(;;)
+    {
+      const size_t r = check(ZSTD_decompressStream(d.get(), &o, &in));
+      if(r == 0)
+        break;
+      if(o.pos == o.size)
+      {
+        out.resize(out.size() * 2 + 1);
+        o.dst = out.data();
+        o.size = out.size();
+      }
+      else if(in.pos == in.size)
+        throw std::runtime_error("zstd: truncated frame");
+    }
+    out.resize(o.pos);
+    return out;
+  }
+
+  // Keep nthreads frames in progress.
+  void start_frames()
+  {
+    while(pending.size() < nthreads && next_frame < size)
+    {
+      const size_t n = frame_size(data + next_frame, size - next_frame);
+      pending.push_back(std::async(std::launch::async, decompress_frame, data + next_frame, n));
+      next_frame += n;
+    }
+  }
+
+  size_t read_parallel(char *p, size_t n)
+  {
+    size_t total = 0;
+    while(total < n)
+    {
+      if(frame_pos == frame.size())
+      {
+        if(pending.empty())
+          break;
+        frame = pending.front().get(); // rethrows any exception from decompress_frame()
+        pending.pop_front();
+        frame_pos = 0;
+        start_frames();
+        continue;
+      }
+      const size_t c = std::min(n - total, frame.size() - frame_pos);
+      memcpy(p + total, frame.data() + frame_pos, c);
+      frame_pos += c;
+      total += c;
+    }
+    return total;
+  }
+
+  size_t read_stream(char *p, size_t n)
+  {
+    ZSTD_outBuffer out{p, n, 0};
+    while(out.pos < out.size && (input.pos < input.size || frame_open))
+    {
+      const size_t in_before = input.pos;
+      const size_t out_before = out.pos;
+      frame_open = (check(ZSTD_decompressStream(dctx.get(), &out, &input)) != 0);
+      if(input.pos == in_before && out.pos == out_before)
+        throw std::runtime_error("zstd: truncated frame");
+    }
+    return out.pos;
+  }
+
+  void close() noexcept
+  {
+    pending.clear(); // waits for threads still using the mapping
+    if(data)
+      munmap(const_cast<char*>(data), size);
+    data = nullptr;
+    size = 0;
+  }
+
+public:
+  explicit zstd_source(const std::filesystem::path& path, unsigned int threads = std::thread::hardware_concurrency())
+  {
+    const int fd = _private::open_file(path);
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+      ::close(fd);
+      _private::throw_file_error("fstat", path);
+    }
+    size = (size_t)st.st_size;
+    if(size > 0)
+    {
+      void *m = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(m == MAP_FAILED)
+      {
+        ::close(fd);
+        _private::throw_file_error("mmap", path);
+      }
+      data = static_cast<const char*>(m);
+      madvise(m, size, MADV_SEQUENTIAL); // only a hint, ignore errors
+    }
+    ::close(fd);
+    try
+    {
+      if(threads > 1 && size > 0 && frame_size(data, size) < size)
+      {
+        nthreads = threads;
+        start_frames();
+      }
+      else
+      {
+        dctx.reset(ZSTD_createDCtx());
+        if(!dctx)
+          throw std::bad_alloc();
+        input = ZSTD_inBuffer{data, size, 0};
+      }
+    }
+    catch(...)
+    {
+      close();
+      throw;
+    }
+  }
+
+  zstd_source(const zstd_source&) = delete;
+  zstd_source& operator=(const zstd_source&) = delete;
+
+  zstd_source(zstd_source&& old) noexcept :
+    data(std::exchange(old.data, nullptr)), size(std::exchange(old.size, 0)), dctx(std::move(old.dctx)),
+    input(std::exchange(old.input, ZSTD_inBuffer{nullptr, 0, 0})), frame_open(std::exchange(old.frame_open, false)),
+    nthreads(old.nthreads), next_frame(std::exchange(old.next_frame, 0)), pending(std::move(old.pending)),
+    frame(std::move(old.frame)), frame_pos(std::exchange(old.frame_pos, 0))
+  {
+  }
+
+  zstd_source& operator=(zstd_source&& old) noexcept
+  {
+    if(this != &old)
+    {
+      close();
+      data = std::exchange(old.data, nullptr);
+      size = std::exchange(old.size, 0);
+      dctx = std::move(old.dctx);
+      input = std::exchange(old.input, ZSTD_inBuffer{nullptr, 0, 0});
+      frame_open = std::exchange(old.frame_open, false);
+      nthreads = old.nthreads;
+      next_frame = std::exchange(old.next_frame, 0);
+      pending = std::move(old.pending);
+      frame = std::move(old.frame);
+      frame_pos = std::exchange(old.frame_pos, 0);
+    }
+    return *this;
+  }
+
+  ~zstd_source() noexcept
+  {
+    close();
+  }
+
+  /** Decompress up to @a n bytes into @a p. Return the number of bytes, 0 at end of file. Throws std::runtime_error if the data is invalid. */
+  size_t read(char *p, size_t n)
+  {
+    return dctx ? read_stream(p, n) : read_parallel(p, n);
+  }
+
+  /** True if frames are being decompressed by other threads. */
+  bool parallel() const noexcept { return !dctx; }
+};
+
+using zstd_backend = basic_block_backend<zstd_source>;
+using zstd_file_reader = file_chunk_reader<zstd_backend>;
+
+#endif
+
+
+/** @brief Maps the whole file into memory (read only) with mmap(), and returns lines as string_views into the mapping.
+
+    Nothing is copied, and lines remain valid until the backend is destroyed (not just until the next read_line()),
+    so they can be kept without copying them into a line_arena. The file must be a regular file.
+    (MappedFileChunkReader in read_file_lines_as_range_2.cc uses this to map the file.)
+ */
+class mmap_backend
+{
+  const char *data = nullptr;
+  size_t size = 0;
+  const char *line = nullptr;     // start of current line
+  const char *line_end = nullptr; // one past end of current line (including delimiter)
+  char delimiter = 0;
+  bool done = false;
+
+  void unmap() noexcept
+  {
+    if(data)
+    {
+      [[maybe_unused]] const int err = munmap(const_cast<char*>(data), size);
+      assert(err == 0);
+    }
+    data = nullptr;
+    size = 0;
+  }
+
+public:
+  static constexpr bool stable_lines = true;
+
+  mmap_backend(const std::filesystem::path& path, char delim) : delimiter(delim)
+  {
+    const int fd = _private::open_file(path);
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+      ::close(fd);
+      _private::throw_file_error("fstat", path);
+    }
+    size = (size_t)st.st_size;
+    if(size > 0) // (mmap() of 0 bytes is an error; leave data null for an empty file.)
+    {
+      void *m = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(m == MAP_FAILED)
+      {
+        ::close(fd);
+        _private::throw_file_error("mmap", path);
+      }
+      data = static_cast<const char*>(m);
+      madvise(m, size, MADV_SEQUENTIAL); // only a hint, ignore errors
+    }
+    ::close(fd); // mapping remains valid after closing
+    line = line_end = data;
+  }
+
+  mmap_backend(const mmap_backend&) = delete;
+  mmap_backend& operator=(const mmap_backend&) = delete;
+
+  mmap_backend(mmap_backend&& old) noexcept :
+    data(std::exchange(old.data, nullptr)), size(std::exchange(old.size, 0)), line(std::exchange(old.line, nullptr)),
+    line_end(std::exchange(old.line_end, nullptr)), delimiter(old.delimiter), done(std::exchange(old.done, true))
+  {
+  }
+
+  mmap_backend& operator=(mmap_backend&& old) noexcept
+  {
+    if(this != &old)
+    {
+      unmap();
+      data = std::exchange(old.data, nullptr);
+      size = std::exchange(old.size, 0);
+      line = std::exchange(old.line, nullptr);
+      line_end = std::exchange(old.line_end, nullptr);
+      delimiter = old.delimiter;
+      done = std::exchange(old.done, true);
+    }
+    return *this;
+  }
+
+  ~mmap_backend() noexcept
+  {
+    unmap();
+  }
+
+  void read_line() noexcept
+  {
+    line = line_end;
+    const char *end = data + size;
+    if(line == end)
+    {
+      done = true;
+      return;
+    }
+    const char *d = find_delimiter(line, end, delimiter);
+    line_end = (d == end) ? end : d + 1;
+  }
+
+  /** Current line (including delimiter). Valid until the backend is destroyed. */
+  std::string_view get_line() const noexcept { return std::string_view(line, (size_t)(line_end - line)); }
+
+  bool at_end() const noexcept { return done; }
+
+  /** Entire contents of the file. */
+  std::string_view contents() const noexcept { return std::string_view(data, size); }
+};
+
+
+/** @brief Input iterator for any backend (or reader) class with read_line(), get_line() and at_end() methods.
+    Compare with std::default_sentinel to check for the end.  Unless the backend's stable_lines is true, the string_view
+    returned becomes invalid when the iterator is advanced.
+
+    If RHM_INSTRUMENTATION is enabled (see instrumentation.hh), the time taken by each read_line() (tsc_clock ticks) and the
+    size of each line are recorded in the "file_chunk_reader.read_line_ticks" and "file_chunk_reader.line_bytes" counters.
+    basic_block_backend also records the time spent waiting for each block of data from its source (i.e. the stalls)
+    and the number of bytes read in "file_chunk_reader.read_block_ticks" and "file_chunk_reader.read_block_bytes".
+ */
+template<typename BackendT>
+class file_chunk_iterator
+{
+public:
+  using iterator_category = std::input_iterator_tag;
+  using difference_type = std::ptrdiff_t;
+  using value_type = std::string_view;
+  using reference = value_type;
+  using pointer = void;
+
+private:
+  BackendT *backend = nullptr;
+
+  void read_line()
+  {
+    rhm_instrument_scoped_timer("file_chunk_reader.read_line_ticks");
+    backend->read_line();
+    rhm_instrument_record("file_chunk_reader.line_bytes", backend->get_line().size());
+  }
+
+public:
+  file_chunk_iterator() noexcept = default;
+
+  /** Reads the first line, may throw */
+  explicit file_chunk_iterator(BackendT *b) : backend(b) { read_line(); }
+
+  value_type operator*() const noexcept { return backend->get_line(); }
+
+  file_chunk_iterator& operator++() { read_line(); return *this; }
+
+  // post increment: (as with other input iterators, the previous value is not available after incrementing)
+  void operator++(int) { ++*this; }
+
+  friend bool operator==(const file_chunk_iterator& i, const std::default_sentinel_t&) noexcept
+  {
+    return i.backend->at_end();
+  }
+};
+
+
+/** @brief Bump allocator for keeping copies of lines (or other small strings) without allocating each one separately.
+
+    Memory is allocated in blocks of at least block_size bytes. copy() and allocate() take space from the end of the
+    current block, moving on to a new block when it is full.  reset() makes all of the memory available for reuse
+    (invalidating all string_views and pointers returned), but keeps the blocks, so a program that keeps one batch of
+    lines at a time, then calls reset() before the next batch, stops allocating once the blocks are big enough for
+    a batch.  release() frees all blocks.
+ */
+class line_arena
+{
+public:
+  static constexpr size_t default_block_size = 64 * 1024;
+
+  explicit line_arena(size_t block_size_ = default_block_size) noexcept : block_size(block_size_ > 0 ? block_size_ : 1) {}
+
+  line_arena(const line_arena&) = delete;
+  line_arena& operator=(const line_arena&) = delete;
+  line_arena(line_arena&&) noexcept = default;
+  line_arena& operator=(line_arena&&) noexcept = default;
+
+  /** Get @a n bytes of uninitialized memory, valid until reset(), release() or destruction. */
+  char* allocate(size_t n)
+  {
+    if(blocks.empty() || blocks[current].size - used < n)
+      next_block(n);
+    char *p = blocks[current].data.get() + used;
+    used += n;
+    return p;
+  }
+
+  /** Copy @a s into the arena, and return a view of the copy. */
+  std::string_view copy(std::string_view s)
+  {
+    if(s.empty())
+      return {};
+    char *p = allocate(s.size());
+    memcpy(p, s.data(), s.size());
+    return std::string_view(p, s.size());
+  }
+
+  /** Make all memory available for reuse, keeping the blocks already allocated. */
+  void reset() noexcept
+  {
+    current = 0;
+    used = 0;
+    used_before = 0;
+  }
+
+  /** Free all memory. */
+  void release() noexcept
+  {
+    blocks.clear();
+    reset();
+  }
+
+  /** Number of bytes allocated since the last reset() (not counting unused space left at the end of each block). */
+  size_t bytes_used() const noexcept { return used_before + used; }
+
+  /** Total size of all blocks. */
+  size_t capacity() const noexcept
+  {
+    size_t c = 0;
+    for(const auto& b : blocks)
+      c += b.size;
+    return c;
+  }
+
+  /** Number of blocks allocated. */
+  size_t block_count() const noexcept { return blocks.size(); }
+
+private:
+  struct block
+  {
+    std::unique_ptr<char[]> data;
+    size_t size = 0;
+  };
+
+  // Move to the next block that has space for n bytes, allocating a new one after the current block if the next
+  // existing block (if any) is too small.
+  void next_block(size_t n)
+  {
+    const size_t i = blocks.empty() ? 0 : current + 1;
+    if(!blocks.empty())
+      used_before += used;
+    if(i == blocks.size() || blocks[i].size < n)
+    {
+      const size_t s = std::max(block_size, n);
+      blocks.insert(blocks.begin() + (std::ptrdiff_t)i, block{std::make_unique_for_overwrite<char[]>(s), s});
+    }
+    current = i;
+    used = 0;
+  }
+
+  std::vector<block> blocks;
+  size_t block_size;
+  size_t current = 0;     // index of block currently being allocated from
+  size_t used = 0;        // bytes used in current block
+  size_t used_before = 0; // bytes used in blocks before current
+};
+
+
+/** @brief Reads lines (chunks ending with a delimiter character) from a file, using one of the backends above
+    (getdelim_backend, block_read_backend, mmap_backend, gzip_backend or zstd_backend; or any class with the same
+    interface).
+
+    begin() and end() provide an input iterator and sentinel, so the reader can be used directly in a range based for loop
+    or in a range pipeline.  Each line includes its delimiter (except for a last line without one).  All lines are read from
+    one buffer owned by the backend, which is reused for each line (not one buffer or FILE per iterator), so string_views
+    of lines are only valid until the iterator is advanced, unless BackendT::stable_lines is true (mmap_backend).  To keep
+    lines, copy them into a line_arena, or use for_each_batch().
+
+    The file is opened by the constructor (which throws std::system_error if it can't be opened), and closed when the
+    reader is destroyed.  The reader can be moved (the backend's buffer moves with it), but any iterators are then
+    invalid.  There is only one pass through the file: calling begin() again continues from the current line.
+ */
+template<typename BackendT>
+class file_chunk_reader
+{
+  BackendT src;
+
+public:
+  using backend_type = BackendT;
+  using iterator = file_chunk_iterator<BackendT>;
+
+  /** Open @a path. Any additional arguments are passed to the backend constructor (e.g. block size for block_read_backend) */
+  template<typename... Args>
+  explicit file_chunk_reader(const std::filesystem::path& path, char delim = '\n', Args&&... args) :
+    src(path, delim, std::forward<Args>(args)...)
+  {
+  }
+
+  /** Reads the first line, may throw */
+  iterator begin() { return iterator(&src); }
+  std::default_sentinel_t end() const noexcept { return std::default_sentinel; }
+
+  BackendT& backend() noexcept { return src; }
+  const BackendT& backend() const noexcept { return src; }
+
+  /** Read the rest of the file in batches of up to @a batch_size lines, and call @a fn with a std::span<const std::string_view>
+      of each batch.  Lines are copied into @a arena (unless BackendT::stable_lines), which is reset after each batch, so
+      the lines in a batch are valid only during that call to fn.  Returns the number of lines read.
+   */
+  template<typename Fn>
+  size_t for_each_batch(line_arena& arena, size_t batch_size, Fn&& fn)
+  {
+    if(batch_size == 0)
+      batch_size = 1;
+    std::vector<std::string_view> batch;
+    batch.reserve(batch_size);
+    size_t n = 0;
+    auto flush = [&] {
+      fn(std::span<const std::string_view>(batch));
+      batch.clear();
+      arena.reset();
+    };
+    for(const std::string_view line : *this)
+    {
+      if constexpr(BackendT::stable_lines)
+        batch.push_back(line);
+      else
+        batch.push_back(arena.copy(line));
+      ++n;
+      if(batch.size() == batch_size)
+        flush();
+    }
+    if(!batch.empty())
+      flush();
+    return n;
+  }
+};
+
+using getdelim_file_reader = file_chunk_reader<getdelim_backend>;
+using block_file_reader = file_chunk_reader<block_read_backend>;
+using mapped_file_reader = file_chunk_reader<mmap_backend>;
+
+} // end namespace rhm
@@ -0,0 +1,472 @@
+#pragma once
+
+/* Lightweight instrumentation for hot paths, which can be left in production code and read without a profiler:
+        rhm_instrument_record(name, value)        Record an integer value in the counter called name (a string literal):
+                                                  the count, sum and maximum of values recorded, and a histogram of
+                                                  their magnitudes (one bucket per power of two).
+        rhm_instrument_scoped_timer(name)         Record the time from here to the end of the enclosing scope (in
+                                                  tsc_clock ticks) in counter name.
+        rhm_instrument_scoped_hw_counters(name)   Record CPU cycles, cache misses and branch misses from here to the end of
+                                                  the enclosing scope in counters name.cycles, name.cache_misses and
+                                                  name.branch_misses, using Linux perf_event_open().  Nothing is recorded
+                                                  if the counters can't be opened (e.g. not permitted by perf_event_paranoid).
+
+   These macros do nothing, and their arguments are not evaluated, unless RHM_INSTRUMENTATION is defined as 1.  It must
+   be defined the same way for all translation units in a program, before including any rhm header (ring_buffer.hh,
+   sparse_index_vector.hh, file_chunk_reader.hh and tree_to_range.cc record counters when it is enabled).  The macros are
+   defined in instrumentation_hooks.hh, which is all that those headers include: it only includes this header if
+   RHM_INSTRUMENTATION is 1, so they don't depend on it (or on <mutex>, perf_event.h etc.) otherwise.
+
+   Each thread records into its own shard of counters (allocated the first time the thread records anything), with plain
+   loads and stores rather than atomic read-modify-write instructions or locks, so recording a value costs a few
+   nanoseconds.  snapshot() adds up all shards (and totals from threads that have exited), and print_report() writes
+   them as a table.  The counter, scoped_timer and scoped_hw_counters classes can also be used directly, regardless of
+   RHM_INSTRUMENTATION.
+
+   Up to RHM_INSTRUMENTATION_MAX_COUNTERS (default 64) differently named counters can be used; values recorded in any
+   more are ignored.  Counters with the same name share totals (e.g. the counters in each instantiation of a template).
+
+   @note Requires C++20 mode when compiling.
+*/
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "instrumentation_hooks.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/perf_event.h>)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define RHM_INSTRUMENTATION_HAVE_PERF_EVENT 1
+#endif
+
+#ifndef RHM_INSTRUMENTATION_MAX_COUNTERS
+#define RHM_INSTRUMENTATION_MAX_COUNTERS 64
+#endif
+
+namespace rhm::instrument {
+
+constexpr size_t max_counters = RHM_INSTRUMENTATION_MAX_COUNTERS;
+
+/// Histogram bucket i counts values with std::bit_width(value) == i, i.e. 0 in bucket 0, and [2^(i-1), 2^i) in bucket i.
+constexpr size_t histogram_buckets = 65;
+
+/** Totals for one counter from all threads, returned by snapshot(). */
+struct counter_stats
+{
+  std::string name;
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  uint64_t max = 0;
+  std::array<uint64_t, histogram_buckets> histogram{};
+
+  double mean() const noexcept { return count > 0 ? (double)sum / (double)count : 0.0; }
+
+  /** Upper limit of the histogram bucket containing the @a p'th fraction of values (e.g. 0.99), so an estimate within a factor of two. */
+  uint64_t percentile(double p) const noexcept
+  {
+    const double target = p * (double)count;
+    uint64_t seen = 0;
+    for(size_t i = 0; i < histogram_buckets; ++i)
+    {
+      seen += histogram[i];
+      if(seen > 0 && (double)seen >= target)
+        return std::min(max, i == 0 ? 0 : i == 64 ? UINT64_MAX : (uint64_t(1) << i) - 1);
+    }
+    return max;
+  }
+};
+
+namespace _private {
+
+  // Value which is only written by the thread that owns it, but can be read from other threads without locking.
+  // (Same as _private::relaxed_counter in ring_buffer.hh.)
+  class relaxed_value {
+    std::atomic<uint64_t> v{0};
+  public:
+    void add(uint64_t n) noexcept { v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    void raise(uint64_t n) noexcept { if(n > v.load(std::memory_order_relaxed)) v.store(n, std::memory_order_relaxed); }
+    uint64_t get() const noexcept { return v.load(std::memory_order_relaxed); }
+    void reset() noexcept { v.store(0, std::memory_order_relaxed); }
+  };
+
+  // One counter in one thread's shard.
+  struct counter_slot
+  {
+    relaxed_value count;
+    relaxed_value sum;
+    relaxed_value max;
+    std::array<relaxed_value, histogram_buckets> histogram;
+
+    void record(uint64_t value) noexcept
+    {
+      count.add(1);
+      sum.add(value);
+      max.raise(value);
+      histogram[(size_t)std::bit_width(value)].add(1);
+    }
+
+    void add_to(counter_stats& s) const noexcept
+    {
+      s.count += count.get();
+      s.sum += sum.get();
+      s.max = std::max(s.max, max.get());
+      for(size_t i = 0; i < histogram_buckets; ++i)
+        s.histogram[i] += histogram[i].get();
+    }
+
+    void reset() noexcept
+    {
+      count.reset();
+      sum.reset();
+      max.reset();
+      for(auto& h : histogram)
+        h.reset();
+    }
+  };
+
+  struct thread_shard
+  {
+    std::array<counter_slot, max_counters> slots;
+  };
+
+  // Counter names, and the shards of all threads.  Never destroyed, so threads can still exit (and add their totals)
+  // after the end of main().
+  class registry
+  {
+    std::mutex mutex;
+    std::vector<const char*> names;     // (index is the counter id)
+    std::vector<thread_shard*> shards;  // threads which are still running
+    std::vector<counter_stats> retired; // totals from threads which have exited
+
+  public:
+    static registry& instance()
+    {
+      static registry *r = new registry;
+      return *r;
+    }
+
+    // Return the id for counter @a name, or max_counters if there are already too many.
+    size_t add_counter(const char *name)
+    {
+      std::lock_guard lock(mutex);
+      for(size_t i = 0; i < names.size(); ++i)
+        if(strcmp(names[i], name) == 0)
+          return i;
+      if(names.size() == max_counters)
+        return max_counters;
+      names.push_back(name);
+      return names.size() - 1;
+    }
+
+    const char *name(size_t id)
+    {
+      std::lock_guard lock(mutex);
+      return id < names.size() ? names[id] : "";
+    }
+
+    thread_shard *add_thread()
+    {
+      auto s = new thread_shard;
+      std::lock_guard lock(mutex);
+      shards.push_back(s);
+      return s;
+    }
+
+    void remove_thread(thread_shard *s)
+    {
+      std::lock_guard lock(mutex);
+      retired.resize(max_counters);
+      for(size_t i = 0; i < max_counters; ++i)
+        s->slots[i].add_to(retired[i]);
+      std::erase(shards, s);
+      delete s;
+    }
+
+    std::vector<counter_stats> snapshot()
+    {
+      std::lock_guard lock(mutex);
+      std::vector<counter_stats> stats(names.size());
+      for(size_t i = 0; i < names.size(); ++i)
+      {
+        stats[i].name = names[i];
+        for(const thread_shard *s : shards)
+          s->slots[i].add_to(stats[i]);
+        if(i < retired.size())
+        {
+          const counter_stats& r = retired[i];
+          stats[i].count += r.count;
+          stats[i].sum += r.sum;
+          stats[i].max = std::max(stats[i].max, r.max);
+          for(size_t b = 0; b < histogram_buckets; ++b)
+            stats[i].histogram[b] += r.histogram[b];
+        }
+      }
+      return stats;
+    }
+
+    void reset()
+    {
+      std::lock_guard lock(mutex);
+      for(thread_shard *s : shards)
+        for(auto& slot : s->slots)
+          slot.reset();
+      retired.clear();
+    }
+  };
+
+  // This thread's shard: nullptr until something is recorded, then again after the thread's thread_local objects are destroyed.
+  inline thread_local thread_shard *current_shard = nullptr;
+  inline thread_local bool shard_released = false;
+
+  struct shard_owner
+  {
+    thread_shard *shard = nullptr;
+    ~shard_owner()
+    {
+      current_shard = nullptr;
+      shard_released = true;
+      if(shard)
+        registry::instance().remove_thread(shard);
+    }
+  };
+
+  [[gnu::cold]] [[gnu::noinline]] inline thread_shard *new_thread_shard()
+  {
+    if(shard_released)
+      return nullptr; // thread is exiting
+    static thread_local shard_owner owner;
+    owner.shard = registry::instance().add_thread();
+    current_shard = owner.shard;
+    return current_shard;
+  }
+
+} // end namespace _private
+
+
+/** Named counter.  Values recorded with record() go into the calling thread's shard.  Usually created as a static
+    variable by the rhm_instrument_*() macros, but can also be used directly (e.g. as a static member of a class).
+ */
+class counter
+{
+  size_t id;
+
+public:
+  /** @a name must remain valid for the rest of the program (e.g. a string literal). */
+  explicit counter(const char *name) : id(_private::registry::instance().add_counter(name)) {}
+
+  counter(const counter&) = delete;
+  counter& operator=(const counter&) = delete;
+
+  void record(uint64_t value) const noexcept
+  {
+    if(id >= max_counters) [[unlikely]]
+      return;
+    _private::thread_shard *s = _private::current_shard;
+    if(!s) [[unlikely]]
+    {
+      s = _private::new_thread_shard();
+      if(!s)
+        return;
+    }
+    s->slots[id].record(value);
+  }
+
+  /** False if there were already RHM_INSTRUMENTATION_MAX_COUNTERS other counters, so values recorded are ignored. */
+  bool valid() const noexcept { return id < max_counters; }
+
+  const char *name() const { return _private::registry::instance().name(id); }
+};
+
+
+/** Reads the CPU time stamp counter (rdtsc) on x86.  This counts at a constant rate on current CPUs (which is not
+    necessarily the current core clock rate), and is not serializing, so very short intervals may be reordered with the
+    instructions being timed.  Other CPUs use steady_clock_ns.
+ */
+struct tsc_clock
+{
+  static uint64_t now() noexcept
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+};
+
+/** std::chrono::steady_clock in nanoseconds. */
+struct steady_clock_ns
+{
+  static uint64_t now() noexcept
+  {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+};
+
+/** Records the time between construction and destruction (in ClockT ticks) in a counter. */
+template<typename ClockT = tsc_clock>
+class scoped_timer
+{
+  const counter& c;
+  uint64_t start;
+
+public:
+  explicit scoped_timer(const counter& c_) noexcept : c(c_), start(ClockT::now()) {}
+  scoped_timer(const scoped_timer&) = delete;
+  scoped_timer& operator=(const scoped_timer&) = delete;
+  ~scoped_timer() { c.record(ClockT::now() - start); }
+};
+
+
+/** CPU cycles, cache misses and branch misses for the calling thread (user space only), from Linux perf_event_open().
+    valid() is false if they couldn't be opened (not Linux, or not permitted, e.g. in a container or if
+    /proc/sys/kernel/perf_event_paranoid is too high), and read() then returns zeros.  Each read() is a system call,
+    so use these around larger pieces of work rather than every item.
+ */
+class hw_counters
+{
+public:
+  struct values
+  {
+    uint64_t cycles = 0;
+    uint64_t cache_misses = 0;
+    uint64_t branch_misses = 0;
+  };
+
+  hw_counters() noexcept
+  {
+#ifdef RHM_INSTRUMENTATION_HAVE_PERF_EVENT
+    const uint64_t configs[3] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for(size_t i = 0; i < 3; ++i)
+    {
+      perf_event_attr attr{};
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = configs[i];
+      attr.disabled = (i == 0);
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+      fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds[0], 0);
+      if(fds[i] < 0)
+      {
+        close_all();
+        return;
+      }
+    }
+    ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+  }
+
+  hw_counters(const hw_counters&) = delete;
+  hw_counters& operator=(const hw_counters&) = delete;
+
+  ~hw_counters() { close_all(); }
+
+  bool valid() const noexcept { return fds[0] >= 0; }
+
+  values read() const noexcept
+  {
+    values v;
+#ifdef RHM_INSTRUMENTATION_HAVE_PERF_EVENT
+    struct { uint64_t nr; uint64_t v[3]; } group{};
+    if(valid() && ::read(fds[0], &group, sizeof(group)) == (ssize_t)sizeof(group))
+    {
+      v.cycles = group.v[0];
+      v.cache_misses = group.v[1];
+      v.branch_misses = group.v[2];
+    }
+#endif
+    return v;
+  }
+
+private:
+  int fds[3] = {-1, -1, -1};
+
+  void close_all() noexcept
+  {
+#ifdef RHM_INSTRUMENTATION_HAVE_PERF_EVENT
+    for(int& fd : fds)
+      if(fd >= 0)
+        ::close(std::exchange(fd, -1));
+#endif
+  }
+};
+
+/** hw_counters for the calling thread, opened the first time it is used in each thread. */
+inline hw_counters& this_thread_hw_counters()
+{
+  static thread_local hw_counters hw;
+  return hw;
+}
+
+/** Records the hardware counters used by the calling thread between construction and destruction in three counters. */
+class scoped_hw_counters
+{
+  const counter& cycles;
+  const counter& cache_misses;
+  const counter& branch_misses;
+  const hw_counters& hw;
+  hw_counters::values start;
+
+public:
+  scoped_hw_counters(const counter& cycles_, const counter& cache_misses_, const counter& branch_misses_) :
+    cycles(cycles_), cache_misses(cache_misses_), branch_misses(branch_misses_), hw(this_thread_hw_counters()), start(hw.read())
+  {
+  }
+
+  scoped_hw_counters(const scoped_hw_counters&) = delete;
+  scoped_hw_counters& operator=(const scoped_hw_counters&) = delete;
+
+  ~scoped_hw_counters()
+  {
+    if(!hw.valid())
+      return;
+    const hw_counters::values end = hw.read();
+    cycles.record(end.cycles - start.cycles);
+    cache_misses.record(end.cache_misses - start.cache_misses);
+    branch_misses.record(end.branch_misses - start.branch_misses);
+  }
+};
+
+
+/** Totals of all counters from all threads, in the order the counters were first created. (Values being recorded
+    by other threads at the same time may or may not be included.) */
+inline std::vector<counter_stats> snapshot() { return _private::registry::instance().snapshot(); }
+
+/** Set all counters back to zero.  Values being recorded by other threads at the same time may be lost. */
+inline void reset() { _private::registry::instance().reset(); }
+
+/** Write a table of all counters which have recorded any values to @a out. */
+inline void print_report(FILE *out = stderr)
+{
+  fprintf(out, "%-40s %12s %14s %12s %12s %12s %12s\n", "counter", "count", "sum", "mean", "p50<=", "p99<=", "max");
+  for(const counter_stats& s : snapshot())
+  {
+    if(s.count == 0)
+      continue;
+    fprintf(out, "%-40s %12" PRIu64 " %14" PRIu64 " %12.1f %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+      s.name.c_str(), s.count, s.sum, s.mean(), s.percentile(0.5), s.percentile(0.99), s.max);
+  }
+}
+
+} // end namespace rhm::instrument
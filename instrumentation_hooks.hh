@@ -0,0 +1,42 @@
+#pragma once
+
+/* The rhm_instrument_record(), rhm_instrument_scoped_timer() and rhm_instrument_scoped_hw_counters() macros (see
+   instrumentation.hh), for headers which record counters in their hot paths.  Unless RHM_INSTRUMENTATION is defined as 1,
+   the macros do nothing and instrumentation.hh is not included, so including this header adds nothing to a build.
+*/
+
+#ifndef RHM_INSTRUMENTATION
+#define RHM_INSTRUMENTATION 0
+#endif
+
+#define RHM_INSTRUMENT_CONCAT_(a, b) a##b
+#define RHM_INSTRUMENT_CONCAT(a, b) RHM_INSTRUMENT_CONCAT_(a, b)
+
+#if RHM_INSTRUMENTATION
+
+#include "instrumentation.hh"
+
+#define rhm_instrument_record(name, value) do { \
+    static const ::rhm::instrument::counter rhm_instrument_counter_(name); \
+    rhm_instrument_counter_.record((uint64_t)(value)); \
+  } while(0)
+
+#define rhm_instrument_scoped_timer(name) \
+  static const ::rhm::instrument::counter RHM_INSTRUMENT_CONCAT(rhm_instrument_timer_counter_, __LINE__)(name); \
+  const ::rhm::instrument::scoped_timer<> RHM_INSTRUMENT_CONCAT(rhm_instrument_timer_, __LINE__)(RHM_INSTRUMENT_CONCAT(rhm_instrument_timer_counter_, __LINE__))
+
+#define rhm_instrument_scoped_hw_counters(name) \
+  static const ::rhm::instrument::counter RHM_INSTRUMENT_CONCAT(rhm_instrument_cycles_, __LINE__)(name ".cycles"); \
+  static const ::rhm::instrument::counter RHM_INSTRUMENT_CONCAT(rhm_instrument_cache_misses_, __LINE__)(name ".cache_misses"); \
+  static const ::rhm::instrument::counter RHM_INSTRUMENT_CONCAT(rhm_instrument_branch_misses_, __LINE__)(name ".branch_misses"); \
+  const ::rhm::instrument::scoped_hw_counters RHM_INSTRUMENT_CONCAT(rhm_instrument_hw_, __LINE__)( \
+    RHM_INSTRUMENT_CONCAT(rhm_instrument_cycles_, __LINE__), RHM_INSTRUMENT_CONCAT(rhm_instrument_cache_misses_, __LINE__), \
+    RHM_INSTRUMENT_CONCAT(rhm_instrument_branch_misses_, __LINE__))
+
+#else
+
+#define rhm_instrument_record(name, value) ((void)0)
+#define rhm_instrument_scoped_timer(name) ((void)0)
+#define rhm_instrument_scoped_hw_counters(name) ((void)0)
+
+#endif
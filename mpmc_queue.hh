@@ -0,0 +1,217 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "ring_buffer.hh"
+
+namespace rhm {
+
+/** @brief Bounded lock-free FIFO queue for any number of producer and consumer threads.
+
+    Items are stored in a fixed size std::array of Capacity slots inside this object (no heap allocation), as with
+    ring_buffer<Capacity, std::array<T, Capacity>>.  Each slot also has an atomic sequence number, which tells
+    producers and consumers whether it is ready to be written or read at a given position in the queue. Producers
+    and consumers claim a position by incrementing a shared counter (compare and swap), then wait for the slot's
+    sequence number (based on Dmitry Vyukov's bounded MPMC queue,
+    <https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue>).
+
+    try_push(), try_emplace() and try_pop() never block, and return false if the queue was full or empty.
+
+    push(), emplace() and pop() block the calling thread until there is space or an item available. Waiting is
+    done with C++20 std::atomic::wait() on the sequence number of the slot being waited for, and the thread is
+    woken with notify_all() when that slot changes. Producers and consumers only call notify_all() if some thread
+    is actually blocked waiting, so this costs very little if the blocking methods aren't being used.
+
+    Like ring_buffer, items are not destroyed when popped; a popped item is left in its moved-from state, and is
+    replaced by assignment when the slot is reused.  T must be default constructible and move assignable.
+
+    @note In the non-blocking methods, all threads make progress without locks, though a thread
+    may need to retry its compare and swap if another thread claimed the same position first.
+
+    @note Requires C++20 mode when compiling.
+ */
+template<size_t Capacity, typename T>
+class mpmc_queue
+{
+  static_assert(Capacity > 0, "mpmc_queue: Capacity must be greater than 0");
+  static_assert(std::is_default_constructible_v<T>, "mpmc_queue: T must be default constructible");
+
+public:
+  using value_type = T;
+
+  mpmc_queue() noexcept(std::is_nothrow_default_constructible_v<T>)
+  {
+    for(size_t i = 0; i < Capacity; ++i)
+      slots[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  // Not copyable or movable, since other threads may be using it.
+  mpmc_queue(const mpmc_queue<Capacity, T>&) = delete;
+  mpmc_queue<Capacity, T>& operator=(const mpmc_queue<Capacity, T>&) = delete;
+
+
+  /** Push a copy of @a item if the queue is not full. Return true if pushed, false if full. */
+  bool try_push(const T& item) { return try_emplace(item); }
+
+  /** Push @a item, moving it into the queue, if the queue is not full. Return true if pushed, false if full (@a item is not moved from). */
+  bool try_push(T&& item) { return try_emplace(std::move(item)); }
+
+  /** Assign a new item from @a args into the next slot, if the queue is not full.  Return true if pushed, false if full.
+      If a single argument is given and T can be assigned from it, it is assigned directly into the slot, otherwise
+      a new T is constructed from @a args and move assigned into the slot.
+   */
+  template<typename... Args>
+  bool try_emplace(Args&&... args)
+  {
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    slot_t *s = nullptr;
+    for(;;)
+    {
+      s = &slots[pos % Capacity];
+      const size_t seq = s->seq.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+      if(diff == 0)
+      {
+        if(enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if(diff < 0)
+      {
+        return false; // full: slot still holds the item from Capacity positions ago
+      }
+      else
+      {
+        pos = enqueue_pos.load(std::memory_order_relaxed); // another producer claimed pos, try again
+      }
+    }
+    _private::assign_item(s->value, std::forward<Args>(args)...);
+    publish(s->seq, pos + 1, pop_waiters);
+    return true;
+  }
+
+  /** Move the front item into @a item and remove it from the queue.  Return true if an item was popped, false if the queue was empty. */
+  bool try_pop(T& item)
+  {
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    slot_t *s = nullptr;
+    for(;;)
+    {
+      s = &slots[pos % Capacity];
+      const size_t seq = s->seq.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+      if(diff == 0)
+      {
+        if(dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if(diff < 0)
+      {
+        return false; // empty: slot has not been written for this position yet
+      }
+      else
+      {
+        pos = dequeue_pos.load(std::memory_order_relaxed); // another consumer claimed pos, try again
+      }
+    }
+    item = std::move(s->value);
+    publish(s->seq, pos + Capacity, push_waiters);
+    return true;
+  }
+
+
+  /** Push a copy of @a item, blocking until there is space in the queue. */
+  void push(const T& item) { emplace(item); }
+
+  /** Push @a item, moving it into the queue, blocking until there is space in the queue. */
+  void push(T&& item) { emplace(std::move(item)); }
+
+  /** Same as try_emplace(), but blocks until there is space in the queue. */
+  template<typename... Args>
+  void emplace(Args&&... args)
+  {
+    // Note: arguments are only forwarded (moved from) by the try_emplace() call that succeeds.
+    while(!try_emplace(std::forward<Args>(args)...))
+    {
+      // full: wait for the slot at the current enqueue position to be popped.
+      const size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+      wait_for_change(slots[pos % Capacity].seq, pos, push_waiters);
+    }
+  }
+
+  /** Pop the front item into @a item, blocking until an item is available. */
+  void pop(T& item)
+  {
+    while(!try_pop(item))
+    {
+      // empty: wait for the slot at the current dequeue position to be pushed.
+      const size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+      wait_for_change(slots[pos % Capacity].seq, pos + 1, pop_waiters);
+    }
+  }
+
+  /** Pop and return the front item, blocking until an item is available. */
+  T pop()
+  {
+    T item;
+    pop(item);
+    return item;
+  }
+
+
+  /** Approximate number of items in the queue. (Other threads may be pushing or popping at the same time.) */
+  size_t size() const noexcept
+  {
+    const size_t d = dequeue_pos.load(std::memory_order_acquire);
+    const size_t e = enqueue_pos.load(std::memory_order_acquire);
+    return e > d ? e - d : 0;
+  }
+
+  /** Return true if the queue is (approximately) empty. */
+  bool empty() const noexcept { return size() == 0; }
+
+  /** Return true if the queue is (approximately) full. */
+  bool full() const noexcept { return size() >= Capacity; }
+
+  /** Get the maximum capacity of the queue (same as Capacity parameter). */
+  constexpr size_t capacity() const noexcept { return Capacity; }
+
+private:
+  struct slot_t
+  {
+    std::atomic<size_t> seq;
+    T value{};
+  };
+
+  // Store new sequence number for a slot, then wake any threads blocked in push() or pop().
+  // Sequentially consistent ordering makes sure that either we see the waiter count incremented by
+  // wait_for_change(), or the waiting thread sees the new sequence number before it blocks.
+  static void publish(std::atomic<size_t>& seq, size_t val, std::atomic<unsigned int>& waiters)
+  {
+    seq.store(val, std::memory_order_seq_cst);
+    if(waiters.load(std::memory_order_seq_cst) > 0) [[unlikely]]
+      seq.notify_all();
+  }
+
+  // Block until seq is no longer less than ready_val (i.e. less than the sequence number that would make it available for us.)
+  static void wait_for_change(std::atomic<size_t>& seq, size_t ready_val, std::atomic<unsigned int>& waiters)
+  {
+    waiters.fetch_add(1, std::memory_order_seq_cst);
+    const size_t cur = seq.load(std::memory_order_seq_cst);
+    if(static_cast<std::ptrdiff_t>(cur - ready_val) < 0)
+      seq.wait(cur, std::memory_order_seq_cst);
+    waiters.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  std::array<slot_t, Capacity> slots;
+
+  alignas(_private::cache_line_size) std::atomic<size_t> enqueue_pos{0};
+  alignas(_private::cache_line_size) std::atomic<size_t> dequeue_pos{0};
+  alignas(_private::cache_line_size) std::atomic<unsigned int> push_waiters{0};
+  std::atomic<unsigned int> pop_waiters{0};
+};
+
+} // end namespace rhm
@@ -0,0 +1,200 @@
+// Example and test of rhm::event_count: waking a consumer thread when items are pushed into a lock-free
+// rhm::spsc_ring_buffer, compared with using std::condition_variable.
+// Build with: make notify_thread
+// Benchmarks (wakeup latency and throughput, event_count vs. condition_variable): make notify_thread_benchmark
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "event_count.hh"
+#include "spsc_ring_buffer.hh"
+
+// Signal a waiting thread using rhm::event_count. notify() costs only a fence and a load if nobody is waiting.
+struct event_count_signal
+{
+  rhm::event_count ec;
+
+  template<typename PredT>
+  void await(PredT&& condition) { ec.await(condition); }
+
+  void notify() { ec.notify_one(); }
+};
+
+// Signal a waiting thread using std::condition_variable. The mutex must be locked (briefly) when notifying,
+// otherwise the waiting thread could check the condition, then miss the notification before it starts waiting.
+struct condition_variable_signal
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+
+  template<typename PredT>
+  void await(PredT&& condition)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, condition);
+  }
+
+  void notify()
+  {
+    { std::lock_guard<std::mutex> lock(mutex); }
+    cv.notify_one();
+  }
+};
+
+using int_buffer = rhm::spsc_ring_buffer<1024, std::array<long, 1024>>;
+
+// Push n items from a producer thread, with a consumer thread which sleeps whenever the buffer is empty.  The
+// producer also waits (on a separate signal) if the buffer is full.  Pauses the producer every pause_every items
+// so the consumer actually goes to sleep sometimes. Returns the sum of the items received by the consumer.
+template<typename SignalT>
+long produce_and_consume(long n, long pause_every = 0)
+{
+  int_buffer buffer;
+  SignalT not_empty;
+  SignalT not_full;
+  long sum = 0;
+  std::thread consumer([&] {
+    for(long received = 0; received < n; ++received)
+    {
+      long item = 0;
+      not_empty.await([&] { return buffer.try_pop(item); });
+      not_full.notify();
+      sum += item;
+    }
+  });
+  for(long i = 1; i <= n; ++i)
+  {
+    not_full.await([&] { return buffer.try_push(i); });
+    not_empty.notify();
+    if(pause_every > 0 && i % pause_every == 0)
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  consumer.join();
+  return sum;
+}
+
+void test_producer_consumer()
+{
+  constexpr long n = 100'000;
+  constexpr long expected = n * (n + 1) / 2;
+  assert(produce_and_consume<event_count_signal>(n) == expected);
+  assert(produce_and_consume<event_count_signal>(5000, 100) == 5000L * 5001 / 2);
+  assert(produce_and_consume<condition_variable_signal>(n) == expected);
+  puts("producer/consumer ok");
+}
+
+// notify_all() wakes every waiting thread, and notifying with no waiters does nothing.
+void test_notify_all()
+{
+  rhm::event_count ec;
+  ec.notify_all();
+  ec.notify_one();
+  assert(ec.waiting() == 0);
+
+  std::atomic<bool> go{false};
+  std::atomic<int> woken{0};
+  std::vector<std::thread> threads;
+  for(int i = 0; i < 4; ++i)
+    threads.emplace_back([&] {
+      ec.await([&] { return go.load(); });
+      woken.fetch_add(1);
+    });
+  while(ec.waiting() < 4)
+    std::this_thread::yield();
+  assert(woken.load() == 0);
+  go.store(true);
+  ec.notify_all();
+  for(auto& t : threads)
+    t.join();
+  assert(woken.load() == 4);
+  assert(ec.waiting() == 0);
+
+  // A notification after prepare_wait() but before wait() is not lost.
+  const auto k = ec.prepare_wait();
+  std::thread notifier([&] { ec.notify_one(); });
+  notifier.join();
+  ec.wait(k);
+  assert(ec.waiting() == 0);
+  puts("notify_all ok");
+}
+
+#ifdef ENABLE_BENCHMARK
+
+#include "benchmark/benchmark.h"
+
+// Wakeup latency: two threads take turns, each waking the other and then sleeping until woken. Each
+// iteration is one round trip (two wakeups).
+template<typename SignalT>
+static void bench_ping_pong(benchmark::State& state) {
+  SignalT ping;
+  SignalT pong;
+  std::atomic<long> turn{0};
+  std::atomic<bool> stop{false};
+  std::thread other([&] {
+    for(long t = 1; ; t += 2)
+    {
+      ping.await([&] { return turn.load() == t || stop.load(); });
+      if(stop.load())
+        break;
+      turn.store(t + 1);
+      pong.notify();
+    }
+  });
+  long t = 0;
+  for (auto _ : state) {
+    turn.store(t + 1);
+    ping.notify();
+    pong.await([&] { return turn.load() == t + 2; });
+    t += 2;
+  }
+  stop.store(true);
+  ping.notify();
+  other.join();
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(bench_ping_pong, event_count_signal)->UseRealTime();
+BENCHMARK_TEMPLATE(bench_ping_pong, condition_variable_signal)->UseRealTime();
+
+// Throughput: items per second through an spsc_ring_buffer, notifying after every push and pop.
+template<typename SignalT>
+static void bench_throughput(benchmark::State& state) {
+  const long n = state.range(0);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(produce_and_consume<SignalT>(n));
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK_TEMPLATE(bench_throughput, event_count_signal)->Arg(100'000)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(bench_throughput, condition_variable_signal)->Arg(100'000)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Cost of notifying when no thread is waiting.
+template<typename SignalT>
+static void bench_notify_no_waiters(benchmark::State& state) {
+  SignalT signal;
+  for (auto _ : state) {
+    signal.notify();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(bench_notify_no_waiters, event_count_signal);
+BENCHMARK_TEMPLATE(bench_notify_no_waiters, condition_variable_signal);
+
+BENCHMARK_MAIN();
+
+#else
+
+int main()
+{
+  test_notify_all();
+  test_producer_consumer();
+  return 0;
+}
+
+#endif
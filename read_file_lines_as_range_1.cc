@@ -40,6 +40,8 @@
 //
 //  An alternative design would be instead for FileChunkReader to be the only reader of the file, reading new data on request from
 //  any iterator, and providing data from its own buffer. This is probably a cleaner implementation.  For this implementation, see read_file_lines_as_range_2.cc.
+//  Both are combined into a reusable header in file_chunk_reader.hh, which uses one buffer per reader (not one buffer and FILE*
+//  per iterator as here).
 //
 
 
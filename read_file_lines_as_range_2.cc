@@ -34,6 +34,13 @@
 //  more consistent with standard iterators.  More methods are const and/or noexcept.
 //
 //  For an alternative design, however, see read_file_lines_as_range_1.cc
+//
+//  MappedFileChunkReader (below FileChunkReader) is a variant which uses mmap() to access the file, and returns
+//  string_views into the mapped memory rather than copying each line into a buffer.
+//
+//  See file_chunk_reader.hh for a reusable version of these readers (rhm::file_chunk_reader, with getdelim, block read
+//  and mmap backends), and rhm::line_arena for keeping copies of lines.  BlockFileChunkReader is just rhm::block_file_reader,
+//  and MappedFileChunkReader uses rhm::mmap_backend to map the file.
 
 
 
@@ -58,10 +65,28 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <cassert>
+#include <system_error>
+#include <chrono>
+#include <utility>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <compare>
+#include <thread>
+#include <exception>
+#include <atomic>
+#include <algorithm>
 
 #include <ranges>
 #include "fmt/format.h"
+#include "mpmc_queue.hh"
+#include "file_chunk_reader.hh"
+#include "instrumentation_hooks.hh"
+
+// find_delimiter() is also used by the readers in file_chunk_reader.hh:
+using rhm::find_delimiter;
 
 
 
@@ -203,25 +228,43 @@ public:
     }
   }
 
-  FileChunkReader(FileChunkReader&& old) noexcept
+  FileChunkReader(const FileChunkReader&) = delete;
+  FileChunkReader& operator=(const FileChunkReader&) = delete;
+
+  // Transfer the getdelim() buffer too, so it is neither leaked nor reallocated by the next read_line().
+  FileChunkReader(FileChunkReader&& old) noexcept :
+    fp(std::exchange(old.fp, nullptr)), delimiter(old.delimiter), buf(std::exchange(old.buf, nullptr)),
+    bufsize(std::exchange(old.bufsize, 0)), bufstrlen(std::exchange(old.bufstrlen, 0))
   {
-    fp = old.fp;
-    delimiter = old.delimiter;
-    old.fp = nullptr;
   }
 
   FileChunkReader& operator=(FileChunkReader&& old) noexcept
   {
-    fp = old.fp;
-    delimiter = old.delimiter;
-    old.fp = nullptr;
+    if(this != &old)
+    {
+      close();
+      fp = std::exchange(old.fp, nullptr);
+      delimiter = old.delimiter;
+      buf = std::exchange(old.buf, nullptr);
+      bufsize = std::exchange(old.bufsize, 0);
+      bufstrlen = std::exchange(old.bufstrlen, 0);
+    }
     return *this;
   }
 
   ~FileChunkReader() noexcept
+  {
+    close();
+  }
+
+private:
+  void close() noexcept
   {
     if(buf)
       free(buf);
+    buf = nullptr;
+    bufsize = 0;
+    bufstrlen = 0;
     if(fp)
     {
       int err = fclose(fp);
@@ -232,8 +275,10 @@ public:
           assert(err == 0);
       }
     }
+    fp = nullptr;
   }
-    
+
+public:
 
   FileChunkIterator begin() noexcept
   {
@@ -265,6 +310,7 @@ public:
   void read_line()
   {
     // todo error if file at eof. (throw?)
+    rhm_instrument_scoped_timer("FileChunkReader.read_line_ticks");
     ssize_t r = getdelim(&buf, &bufsize, delimiter, fp);
     if(r < 0) [[unlikely]]
     {
@@ -286,6 +332,7 @@ public:
     else
     {
       bufstrlen = (size_t)r;
+      rhm_instrument_record("FileChunkReader.line_bytes", bufstrlen);
     }
     //fmt::print("getdelim returned {}, bufstrlen={}\n", r, bufstrlen);
   }
@@ -324,6 +371,840 @@ namespace std
 
 
 
+// Alternative to FileChunkReader which maps the whole file into memory with mmap() instead of reading it with getdelim().
+// Nothing is copied: each line is a string_view pointing directly into the mapping, so lines remain valid for as long as the
+// MappedFileChunkReader exists (not just until the iterator is advanced), and can be saved or used in range pipelines.
+// Since advancing an iterator doesn't change the reader, the iterator is a forward iterator, and begin() can be called
+// more than once.
+class MappedFileChunkIterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = ssize_t;
+    using value_type = std::string_view;
+    using reference = value_type;
+    using pointer = void;
+
+private:
+    const char *line = nullptr;     // start of current line
+    const char *line_end = nullptr; // one past end of current line (including delimiter)
+    const char *data_end = nullptr; // end of mapped file data
+    char delimiter = 0;
+
+    // find end of line starting at 'line'.
+    void find_line_end() noexcept
+    {
+      const char *d = find_delimiter(line, data_end, delimiter);
+      line_end = (d == data_end) ? data_end : d + 1;
+    }
+
+public:
+    MappedFileChunkIterator() noexcept = default;
+
+    MappedFileChunkIterator(const char *data, size_t size, char delim) noexcept :
+      line(data), line_end(data), data_end(data + size), delimiter(delim)
+    {
+      if(line != data_end)
+        find_line_end();
+    }
+
+    // Valid for the lifetime of the MappedFileChunkReader (not just this iterator).
+    value_type operator*() const noexcept
+    {
+      return std::string_view(line, (size_t)(line_end - line));
+    }
+
+    MappedFileChunkIterator& operator++() noexcept
+    {
+      line = line_end;
+      if(line != data_end)
+        find_line_end();
+      return *this;
+    }
+
+    MappedFileChunkIterator operator++(int) noexcept
+    {
+      MappedFileChunkIterator selfcopy = *this;
+      ++*this;
+      return selfcopy;
+    }
+
+    friend bool operator==(const MappedFileChunkIterator& lhs, const MappedFileChunkIterator& rhs) noexcept
+    {
+      return lhs.line == rhs.line;
+    }
+
+    bool at_end() const noexcept
+    {
+      return line == data_end;
+    }
+
+    friend bool operator==(const MappedFileChunkIterator& i, const std::default_sentinel_t&) noexcept
+    {
+      return i.at_end();
+    }
+};
+
+
+// A range of whole lines within a MappedFileChunkReader's mapped file (see MappedFileChunkReader::split()).
+class MappedFileChunkRange
+{
+  const char *data = nullptr;
+  size_t size = 0;
+  char delimiter = 0;
+
+public:
+  MappedFileChunkRange() noexcept = default;
+  MappedFileChunkRange(const char *data_, size_t size_, char delim_) noexcept : data(data_), size(size_), delimiter(delim_) {}
+
+  MappedFileChunkIterator begin() const noexcept { return MappedFileChunkIterator(data, size, delimiter); }
+  std::default_sentinel_t end() const noexcept { return std::default_sentinel; }
+
+  // Contents of all lines in the range
+  std::string_view contents() const noexcept { return std::string_view(data, size); }
+};
+
+
+// Maps the specified file into memory (read only), and provides begin() and end() MappedFileChunkIterators.
+// The mapping is made by rhm::mmap_backend (see file_chunk_reader.hh), and the file is unmapped when this object is destroyed.
+class MappedFileChunkReader
+{
+private:
+  rhm::mmap_backend map;
+  char delimiter = 0;
+
+public:
+
+  MappedFileChunkReader(const std::filesystem::path& path, char delim_) : map(path, delim_), delimiter(delim_)
+  {
+  }
+
+  MappedFileChunkIterator begin() const noexcept
+  {
+    const auto data = map.contents();
+    return MappedFileChunkIterator(data.data(), data.size(), delimiter);
+  }
+
+  std::default_sentinel_t end() const noexcept
+  {
+    return std::default_sentinel;
+  }
+
+  // Entire contents of the file.
+  std::string_view contents() const noexcept
+  {
+    return map.contents();
+  }
+
+  // Split the file into (at most) n ranges of whole lines of about the same size, which can be processed in parallel.
+  // Each split point is moved forward to just after the next delimiter, so no line is divided between two ranges.
+  // (Fewer than n ranges are returned if the file is small or has very long lines, but every line is in exactly one range.)
+  std::vector<MappedFileChunkRange> split(size_t n) const
+  {
+    std::vector<MappedFileChunkRange> ranges;
+    const char *data = map.contents().data();
+    const size_t size = map.contents().size();
+    if(n == 0) n = 1;
+    ranges.reserve(n);
+    const char *end = data + size;
+    const char *p = data;
+    for(size_t i = 1; i <= n && p != end; ++i)
+    {
+      const char *q = (i == n) ? end : data + (size / n) * i;
+      if(q < p) q = p;
+      if(q != end && q != data && q[-1] != delimiter)
+      {
+        q = find_delimiter(q, end, delimiter);
+        if(q != end) ++q;
+      }
+      if(q != p)
+        ranges.emplace_back(p, (size_t)(q - p), delimiter);
+      p = q;
+    }
+    return ranges;
+  }
+};
+
+
+// Call fn(line) for each line in the file, using n threads (by default, one for each CPU core), each processing one range
+// of lines from reader.split(n).  fn must be safe to call from multiple threads at once.  Lines are processed in order within
+// each range, but not across ranges.  If any call to fn throws, the first exception is rethrown after all threads have finished.
+// (Alternatively, give the ranges from split() to std::for_each(std::execution::par, ...) or a thread pool.)
+template<typename Fn>
+void parallel_for_each_line(const MappedFileChunkReader& reader, Fn&& fn, size_t n = std::thread::hardware_concurrency())
+{
+  const auto ranges = reader.split(n);
+  std::vector<std::exception_ptr> errors(ranges.size());
+  {
+    std::vector<std::jthread> threads;
+    threads.reserve(ranges.size());
+    for(size_t i = 0; i < ranges.size(); ++i)
+      threads.emplace_back([&fn, &range = ranges[i], &error = errors[i]] {
+        try {
+          for(auto line : range)
+            fn(line);
+        } catch(...) {
+          error = std::current_exception();
+        }
+      });
+  } // wait for all threads
+  for(const auto& e : errors)
+    if(e)
+      std::rethrow_exception(e);
+}
+
+
+
+
+
+// Offsets of the start of each line in a file (or other data), which can be used to find line n in O(1) time.
+// Built by scanning the data for delimiters once with extend(), and extended incrementally when more data is appended (e.g. to a log file)
+// by calling extend() again with the longer data; only the new part is scanned.
+// To reduce the size of the index, offsets are stored as a 32-bit difference from a 64-bit base offset stored for every
+// lines_per_block lines (about 4 bytes per line instead of 8).  (If a difference doesn't fit in 32 bits, because lines are very long,
+// then the full offset for that line is stored separately.)
+// The index can be saved to a file and loaded again with save() and load() (see IndexedFileChunkReader, which uses a "sidecar" file).
+class LineIndex
+{
+public:
+  static constexpr size_t lines_per_block = 64;
+
+private:
+  static constexpr uint32_t overflow_marker = UINT32_MAX;
+
+  char delimiter = '\n';
+  std::vector<uint64_t> bases;  // offset of line n*lines_per_block
+  std::vector<uint32_t> deltas; // offset of line n - bases[n / lines_per_block], or overflow_marker
+  std::vector<std::pair<size_t, uint64_t>> overflow; // (line, offset) for lines whose delta is overflow_marker, in order
+  uint64_t data_size = 0;       // size of data scanned so far
+
+  void push_start(uint64_t offset)
+  {
+    const size_t n = deltas.size();
+    if(n % lines_per_block == 0)
+      bases.push_back(offset);
+    const uint64_t delta = offset - bases.back();
+    if(delta >= overflow_marker) [[unlikely]]
+    {
+      deltas.push_back(overflow_marker);
+      overflow.emplace_back(n, offset);
+    }
+    else
+      deltas.push_back((uint32_t)delta);
+  }
+
+  // offset of the start of line n, where n <= number of delimiters
+  uint64_t start(size_t n) const noexcept
+  {
+    const uint32_t d = deltas[n];
+    if(d == overflow_marker) [[unlikely]]
+      return std::lower_bound(overflow.begin(), overflow.end(), n, [](const auto& o, size_t line) { return o.first < line; })->second;
+    return bases[n / lines_per_block] + d;
+  }
+
+public:
+  explicit LineIndex(char delim = '\n') : delimiter(delim)
+  {
+    push_start(0);
+  }
+
+  // Scan the part of data after the end of the previously scanned data (the first data_size() bytes must be the same as before).
+  void extend(std::string_view data)
+  {
+    assert(data.size() >= data_size);
+    const char *p = data.data() + data_size;
+    const char *end = data.data() + data.size();
+    while((p = find_delimiter(p, end, delimiter)) != end)
+    {
+      ++p;
+      push_start((uint64_t)(p - data.data()));
+    }
+    data_size = data.size();
+  }
+
+  // Number of lines. (The last line may not end with a delimiter.)
+  size_t size() const noexcept
+  {
+    return (start(deltas.size() - 1) == data_size) ? deltas.size() - 1 : deltas.size();
+  }
+
+  // Offset of the first character of line n
+  uint64_t line_begin(size_t n) const noexcept
+  {
+    assert(n < size());
+    return start(n);
+  }
+
+  // Offset just past the end of line n (including delimiter)
+  uint64_t line_end(size_t n) const noexcept
+  {
+    assert(n < size());
+    return (n + 1 < deltas.size()) ? start(n + 1) : data_size;
+  }
+
+  uint64_t indexed_size() const noexcept { return data_size; }
+  char get_delimiter() const noexcept { return delimiter; }
+
+  // Approximate memory used by the index
+  size_t memory_size() const noexcept
+  {
+    return bases.capacity() * sizeof(uint64_t) + deltas.capacity() * sizeof(uint32_t) + overflow.capacity() * sizeof(overflow[0]);
+  }
+
+  // Write index to a file. Throws std::system_error on error.
+  void save(const std::filesystem::path& path) const
+  {
+    FILE *fp = fopen(path.c_str(), "wb");
+    if(!fp)
+      throw std::system_error(errno, std::system_category(), STRERROR(errno));
+    const uint64_t header[] = { file_magic, (uint64_t)(unsigned char)delimiter, lines_per_block, data_size, deltas.size(), overflow.size() };
+    bool ok = fwrite(header, sizeof(header), 1, fp) == 1
+      && fwrite(bases.data(), sizeof(uint64_t), bases.size(), fp) == bases.size()
+      && fwrite(deltas.data(), sizeof(uint32_t), deltas.size(), fp) == deltas.size()
+      && fwrite(overflow.data(), sizeof(overflow[0]), overflow.size(), fp) == overflow.size();
+    if(fclose(fp) != 0)
+      ok = false;
+    if(!ok)
+      throw std::system_error(errno, std::system_category(), STRERROR(errno));
+  }
+
+  // Read index saved by save(), if it exists and was made with the same delimiter. Return false if not, or if the counts in its
+  // header don't match the size of the index file (index is unchanged).
+  // Note that it is not possible to tell whether the file the index was made from has been changed (other than by appending
+  // to it) since the index was saved; use extend() to add any new lines.
+  bool load(const std::filesystem::path& path)
+  {
+    FILE *fp = fopen(path.c_str(), "rb");
+    if(!fp)
+      return false;
+    uint64_t header[6];
+    LineIndex tmp(delimiter);
+    std::error_code ec;
+    const uint64_t file_size = std::filesystem::file_size(path, ec);
+    bool ok = !ec && fread(header, sizeof(header), 1, fp) == 1
+      && header[0] == file_magic && header[1] == (uint64_t)(unsigned char)delimiter && header[2] == lines_per_block && header[4] > 0;
+    if(ok)
+    {
+      // There is one delta per line start (at most one more than the number of bytes indexed), and each overflow entry is for one of them.
+      // (These limits are checked first so that calculating the expected file size can't overflow.)
+      const uint64_t n_deltas = header[4];
+      const uint64_t n_overflow = header[5];
+      ok = n_deltas <= file_size / sizeof(uint32_t) && n_deltas - 1 <= header[3] && n_overflow <= n_deltas
+        && file_size == sizeof(header) + (n_deltas + lines_per_block - 1) / lines_per_block * sizeof(uint64_t)
+            + n_deltas * sizeof(uint32_t) + n_overflow * sizeof(tmp.overflow[0]);
+    }
+    if(ok)
+    {
+      tmp.data_size = header[3];
+      tmp.deltas.resize(header[4]);
+      tmp.bases.resize((header[4] + lines_per_block - 1) / lines_per_block);
+      tmp.overflow.resize(header[5]);
+      ok = fread(tmp.bases.data(), sizeof(uint64_t), tmp.bases.size(), fp) == tmp.bases.size()
+        && fread(tmp.deltas.data(), sizeof(uint32_t), tmp.deltas.size(), fp) == tmp.deltas.size()
+        && fread(tmp.overflow.data(), sizeof(tmp.overflow[0]), tmp.overflow.size(), fp) == tmp.overflow.size();
+    }
+    fclose(fp);
+    if(ok)
+      *this = std::move(tmp);
+    return ok;
+  }
+
+private:
+  static constexpr uint64_t file_magic = 0x3158444e494c4d48; // "HMLINDX1"
+};
+
+
+class IndexedFileChunkReader;
+
+// Random access iterator for IndexedFileChunkReader.
+class IndexedFileChunkIterator
+{
+public:
+    using iterator_category = std::input_iterator_tag; // (operator* doesn't return a real reference, so this can be only a C++17 input iterator)
+    using iterator_concept = std::random_access_iterator_tag;
+    using difference_type = ssize_t;
+    using value_type = std::string_view;
+    using reference = value_type;
+    using pointer = void;
+
+private:
+    const IndexedFileChunkReader* reader = nullptr;
+    difference_type n = 0;
+
+public:
+    IndexedFileChunkIterator() noexcept = default;
+    IndexedFileChunkIterator(const IndexedFileChunkReader* r, size_t n_) noexcept : reader(r), n((difference_type)n_) {}
+
+    value_type operator*() const noexcept;
+    value_type operator[](difference_type i) const noexcept { return *(*this + i); }
+
+    // Line number
+    size_t line_number() const noexcept { return (size_t)n; }
+
+    IndexedFileChunkIterator& operator++() noexcept { ++n; return *this; }
+    IndexedFileChunkIterator operator++(int) noexcept { auto prev = *this; ++n; return prev; }
+    IndexedFileChunkIterator& operator--() noexcept { --n; return *this; }
+    IndexedFileChunkIterator operator--(int) noexcept { auto prev = *this; --n; return prev; }
+    IndexedFileChunkIterator& operator+=(difference_type d) noexcept { n += d; return *this; }
+    IndexedFileChunkIterator& operator-=(difference_type d) noexcept { n -= d; return *this; }
+    friend IndexedFileChunkIterator operator+(IndexedFileChunkIterator i, difference_type d) noexcept { return i += d; }
+    friend IndexedFileChunkIterator operator+(difference_type d, IndexedFileChunkIterator i) noexcept { return i += d; }
+    friend IndexedFileChunkIterator operator-(IndexedFileChunkIterator i, difference_type d) noexcept { return i -= d; }
+    friend difference_type operator-(const IndexedFileChunkIterator& a, const IndexedFileChunkIterator& b) noexcept { return a.n - b.n; }
+    friend bool operator==(const IndexedFileChunkIterator& a, const IndexedFileChunkIterator& b) noexcept { return a.n == b.n; }
+    friend auto operator<=>(const IndexedFileChunkIterator& a, const IndexedFileChunkIterator& b) noexcept { return a.n <=> b.n; }
+};
+
+
+// Maps a file into memory like MappedFileChunkReader, and also makes a LineIndex of it, so that any line can be accessed in O(1) time
+// with operator[]() or random access iterators (e.g. std::ranges::subrange(r.begin() + 1000, r.begin() + 2000) for lines 1000 to 1999).
+// If use_sidecar is true, the index is loaded from (and saved to) a file with the same name plus ".lineindex" if possible, so only data
+// appended to the file since the index was last saved needs to be scanned.  Call refresh() to map and index any data appended to the file
+// since it was opened.  (Lines obtained before calling refresh() become invalid.)
+class IndexedFileChunkReader
+{
+  std::filesystem::path path;
+  MappedFileChunkReader mapped;
+  LineIndex index;
+  bool use_sidecar;
+
+  std::filesystem::path sidecar_path() const { return std::filesystem::path(path) += ".lineindex"; }
+
+  // Save the index in the sidecar file if possible. The sidecar is only a cache, so if it can't be written (e.g. read only
+  // directory), it is just removed if it is a file (in case it was partly written).
+  void save_sidecar() noexcept
+  {
+    try {
+      index.save(sidecar_path());
+    } catch(const std::system_error&) {
+      std::error_code ec;
+      if(std::filesystem::is_regular_file(sidecar_path(), ec))
+        std::filesystem::remove(sidecar_path(), ec);
+    }
+  }
+
+  void update_index()
+  {
+    if(mapped.contents().size() < index.indexed_size())
+      index = LineIndex(index.get_delimiter()); // file has been truncated or replaced, start again
+    index.extend(mapped.contents());
+  }
+
+public:
+  IndexedFileChunkReader(const std::filesystem::path& path_, char delim, bool use_sidecar_ = false) :
+    path(path_), mapped(path_, delim), index(delim), use_sidecar(use_sidecar_)
+  {
+    if(use_sidecar)
+      index.load(sidecar_path());
+    const auto loaded_size = index.indexed_size();
+    update_index();
+    if(use_sidecar && index.indexed_size() != loaded_size)
+      save_sidecar();
+  }
+
+  // Map the file again, and index any new lines if the file has grown.  Invalidates lines and iterators obtained before.
+  void refresh()
+  {
+    mapped = MappedFileChunkReader(path, index.get_delimiter());
+    const auto old_size = index.indexed_size();
+    update_index();
+    if(use_sidecar && index.indexed_size() != old_size)
+      save_sidecar();
+  }
+
+  size_t size() const noexcept { return index.size(); }
+
+  // Line n (including delimiter)
+  std::string_view operator[](size_t n) const noexcept
+  {
+    const auto b = index.line_begin(n);
+    return mapped.contents().substr(b, index.line_end(n) - b);
+  }
+
+  IndexedFileChunkIterator begin() const noexcept { return IndexedFileChunkIterator(this, 0); }
+  IndexedFileChunkIterator end() const noexcept { return IndexedFileChunkIterator(this, size()); }
+
+  const LineIndex& line_index() const noexcept { return index; }
+};
+
+IndexedFileChunkIterator::value_type IndexedFileChunkIterator::operator*() const noexcept
+{
+  return (*reader)[(size_t)n];
+}
+
+
+
+
+
+
+
+
+// Alternative to FileChunkReader which read()s the file in large blocks (block_size, default 1 MiB) into a reusable
+// buffer, and finds the delimiters in the buffer with find_delimiter().  This is rhm::block_file_reader from file_chunk_reader.hh;
+// a line which continues past the end of the buffer is moved to the start of the buffer before the next block is read, so lines
+// are always contiguous.  Like FileChunkIterator, the string_view returned becomes invalid when the iterator is advanced.
+using BlockFileChunkReader = rhm::block_file_reader;
+using BlockFileChunkIterator = BlockFileChunkReader::iterator;
+
+
+
+
+
+// Input iterator for any reader class with read_line(), get_line() and at_end() methods like FileChunkReader
+// (used by PrefetchFileChunkReader below).  The string_view returned becomes invalid when the iterator is advanced.
+template<typename ReaderT>
+using ChunkReaderIterator = rhm::file_chunk_iterator<ReaderT>;
+
+
+
+// Reads a file into NBuffers buffers of block_size bytes with a background thread, which keeps reading the following blocks
+// while the caller is using the current one.  next_block() returns the next block of the file, waiting for it if it hasn't been read yet, and
+// gives the previous block's buffer back to the reading thread to be refilled.  Buffers are passed between the threads with two rhm::mpmc_queues.
+template<size_t NBuffers = 3>
+class ThreadBlockPrefetcher
+{
+  static_assert(NBuffers >= 2);
+  static constexpr size_t npos = (size_t)-1;
+
+  struct filled_block {
+    size_t buf = 0;
+    size_t size = 0;
+    int error = 0;
+  };
+
+  int fd;
+  size_t block_size;
+  std::vector<char> storage;
+  rhm::mpmc_queue<NBuffers + 1, size_t> free_bufs; // (+1 leaves room for stop marker pushed by destructor)
+  rhm::mpmc_queue<NBuffers, filled_block> filled;
+  std::atomic<bool> stop = false;
+  size_t current = npos; // buffer returned by last next_block()
+  bool eof = false;
+  std::thread thread;
+
+  void run() noexcept
+  {
+    for(;;)
+    {
+      const size_t b = free_bufs.pop();
+      if(stop.load()) return;
+      char *dest = storage.data() + b * block_size;
+      size_t n = 0;
+      int err = 0;
+      while(n < block_size)
+      {
+        const ssize_t r = ::read(fd, dest + n, block_size - n);
+        if(r < 0)
+        {
+          if(errno == EINTR) continue;
+          err = errno;
+          break;
+        }
+        if(r == 0) break;
+        n += (size_t)r;
+      }
+      filled.push(filled_block{b, n, err});
+      if(n < block_size) return; // end of file or error
+    }
+  }
+
+public:
+  ThreadBlockPrefetcher(int fd_, size_t block_size_) : fd(fd_), block_size(block_size_), storage(NBuffers * block_size_)
+  {
+    for(size_t i = 0; i < NBuffers; ++i)
+      free_bufs.push(i);
+    thread = std::thread(&ThreadBlockPrefetcher::run, this);
+  }
+
+  ThreadBlockPrefetcher(const ThreadBlockPrefetcher&) = delete;
+  ThreadBlockPrefetcher& operator=(const ThreadBlockPrefetcher&) = delete;
+
+  ~ThreadBlockPrefetcher() noexcept
+  {
+    stop = true;
+    free_bufs.push(npos); // wake thread if waiting for a buffer
+    thread.join();
+  }
+
+  // Next block of data from the file, or an empty string_view at end of file. Valid until the next call to next_block().
+  std::string_view next_block()
+  {
+    if(eof)
+      return {};
+    if(current != npos)
+      free_bufs.push(current);
+    const filled_block fb = filled.pop();
+    current = fb.buf;
+    if(fb.error != 0) [[unlikely]]
+    {
+      eof = true;
+      throw std::system_error(fb.error, std::system_category(), STRERROR(fb.error));
+    }
+    if(fb.size < block_size)
+      eof = true;
+    return std::string_view(storage.data() + fb.buf * block_size, fb.size);
+  }
+};
+
+
+#if defined(USE_LIBURING) && __has_include(<liburing.h>)
+
+#include <liburing.h>
+#define HAVE_URING_BLOCK_PREFETCHER 1
+
+// Same as ThreadBlockPrefetcher, but uses io_uring to keep reads of the next NBuffers blocks in flight, without a separate thread.
+// Build with -DUSE_LIBURING and link with -luring (e.g. make read_file_lines_as_range_2 CXXFLAGS=-DUSE_LIBURING LDLIBS=-luring),
+// and use it explicitly with PrefetchFileChunkReader<UringBlockPrefetcher<>>.  (Experimental: it has only been compiled, not yet
+// run against a real liburing, so it is not the default.  test_prefetch_reader() and the benchmarks also test it if it is enabled.)
+template<size_t NBuffers = 3>
+class UringBlockPrefetcher
+{
+  static_assert(NBuffers >= 2);
+  static constexpr size_t npos = (size_t)-1;
+
+  struct buffer_state {
+    off_t offset = 0;    // file offset of this block
+    size_t filled = 0;   // bytes read so far
+    bool done = false;   // block is full, or reached end of file, or error
+    bool in_flight = false;
+    int error = 0;
+  };
+
+  io_uring ring;
+  int fd;
+  size_t block_size;
+  std::vector<char> storage;
+  std::array<buffer_state, NBuffers> bufs;
+  off_t next_offset = 0; // offset of next block to start reading
+  size_t next_buf = 0;   // buffer which will hold the next block in file order
+  size_t current = npos; // buffer returned by last next_block()
+  bool eof = false;
+
+  void submit(size_t b)
+  {
+    buffer_state& s = bufs[b];
+    io_uring_sqe *sqe = io_uring_get_sqe(&ring); // (never null, there are never more than NBuffers requests)
+    io_uring_prep_read(sqe, fd, storage.data() + b * block_size + s.filled, (unsigned)(block_size - s.filled), (uint64_t)(s.offset + (off_t)s.filled));
+    io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(b));
+    s.in_flight = true;
+    const int r = io_uring_submit(&ring);
+    if(r < 0) [[unlikely]]
+      throw std::system_error(-r, std::system_category(), STRERROR(-r));
+  }
+
+  void start(size_t b)
+  {
+    bufs[b] = buffer_state{next_offset};
+    next_offset += (off_t)block_size;
+    submit(b);
+  }
+
+  // Wait for one read to complete, and resubmit if it was a short read before end of file.
+  void wait_one()
+  {
+    io_uring_cqe *cqe = nullptr;
+    const int r = io_uring_wait_cqe(&ring, &cqe);
+    if(r < 0) [[unlikely]]
+    {
+      if(r == -EINTR) return;
+      throw std::system_error(-r, std::system_category(), STRERROR(-r));
+    }
+    const size_t b = reinterpret_cast<size_t>(io_uring_cqe_get_data(cqe));
+    const int res = cqe->res;
+    io_uring_cqe_seen(&ring, cqe);
+    buffer_state& s = bufs[b];
+    s.in_flight = false;
+    if(res < 0)
+    {
+      if(res == -EINTR || res == -EAGAIN)
+        submit(b);
+      else
+      {
+        s.error = -res;
+        s.done = true;
+      }
+    }
+    else if(res == 0)
+      s.done = true;
+    else
+    {
+      s.filled += (size_t)res;
+      if(s.filled == block_size)
+        s.done = true;
+      else
+        submit(b);
+    }
+  }
+
+public:
+  UringBlockPrefetcher(int fd_, size_t block_size_) : fd(fd_), block_size(block_size_), storage(NBuffers * block_size_)
+  {
+    const int r = io_uring_queue_init(NBuffers, &ring, 0);
+    if(r < 0)
+      throw std::system_error(-r, std::system_category(), STRERROR(-r));
+    for(size_t b = 0; b < NBuffers; ++b)
+      start(b);
+  }
+
+  UringBlockPrefetcher(const UringBlockPrefetcher&) = delete;
+  UringBlockPrefetcher& operator=(const UringBlockPrefetcher&) = delete;
+
+  ~UringBlockPrefetcher() noexcept
+  {
+    // Reads still in flight must complete before the buffers are freed.
+    try {
+      for(const auto& s : bufs)
+        while(s.in_flight)
+          wait_one();
+    } catch(...) {}
+    io_uring_queue_exit(&ring);
+  }
+
+  // Next block of data from the file, or an empty string_view at end of file. Valid until the next call to next_block().
+  std::string_view next_block()
+  {
+    if(eof)
+      return {};
+    if(current != npos)
+      start(current); // previous block is no longer needed; reuse its buffer for the block NBuffers ahead
+    const size_t b = next_buf;
+    while(!bufs[b].done)
+      wait_one();
+    next_buf = (b + 1) % NBuffers;
+    current = b;
+    if(bufs[b].error != 0) [[unlikely]]
+    {
+      eof = true;
+      throw std::system_error(bufs[b].error, std::system_category(), STRERROR(bufs[b].error));
+    }
+    if(bufs[b].filled < block_size)
+      eof = true;
+    return std::string_view(storage.data() + b * block_size, bufs[b].filled);
+  }
+};
+
+#endif
+
+template<size_t NBuffers = 3>
+using DefaultBlockPrefetcher = ThreadBlockPrefetcher<NBuffers>;
+
+
+// Reads lines from a file in blocks (block_size, default 1 MiB) like BlockFileChunkReader, but uses PrefetcherT to read the next blocks
+// in advance (asynchronously) while lines in the current block are being used, so that the caller doesn't have to wait for a read()
+// at the end of each block (if it is using lines more slowly than the file can be read).  PrefetcherT is ThreadBlockPrefetcher by default
+// (or UringBlockPrefetcher if given explicitly).  Lines are returned as string_views into the block buffers, except that a line that continues
+// into the next block is copied into a separate buffer.  As with FileChunkReader, a line is only valid until the iterator is advanced.
+template<typename PrefetcherT = DefaultBlockPrefetcher<>>
+class PrefetchFileChunkReader
+{
+public:
+  static constexpr size_t default_block_size = 1024 * 1024;
+
+private:
+  // fd must be declared before prefetcher, so that it is opened before prefetcher is constructed, and closed after it is destroyed.
+  struct file_descriptor {
+    int fd;
+    explicit file_descriptor(const std::filesystem::path& path) : fd(open(path.c_str(), O_RDONLY))
+    {
+      if(fd < 0)
+      {
+        std::string msg(STRERROR(errno));
+        msg += ": \"";
+        msg += path.c_str();
+        msg += "\"";
+        throw std::system_error(errno, std::system_category(), msg);
+      }
+      posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL); // only a hint, ignore errors
+    }
+    ~file_descriptor() { close(fd); }
+  } file;
+  PrefetcherT prefetcher;
+  char delimiter;
+  std::string_view block; // current block
+  size_t pos = 0;         // start of next line in block
+  std::string carry;      // line that continued from one block into the following block(s)
+  std::string_view line;
+  bool eof = false;
+  bool done = false;
+
+public:
+  PrefetchFileChunkReader(const std::filesystem::path& path, char delim_, size_t block_size = default_block_size) :
+    file(path), prefetcher(file.fd, block_size > 0 ? block_size : 1), delimiter(delim_)
+  {
+  }
+
+  PrefetchFileChunkReader(const PrefetchFileChunkReader&) = delete;
+  PrefetchFileChunkReader& operator=(const PrefetchFileChunkReader&) = delete;
+
+  ChunkReaderIterator<PrefetchFileChunkReader> begin()
+  {
+    return ChunkReaderIterator<PrefetchFileChunkReader>(this);
+  }
+
+  std::default_sentinel_t end() const noexcept
+  {
+    return std::default_sentinel;
+  }
+
+  bool at_end() const noexcept
+  {
+    return done;
+  }
+
+  // Current line (including delimiter). Valid until the next call to read_line().
+  std::string_view get_line() const noexcept
+  {
+    return line;
+  }
+
+  void read_line()
+  {
+    carry.clear();
+    bool use_carry = false;
+    for(;;)
+    {
+      const char *b = block.data() + pos;
+      const char *e = block.data() + block.size();
+      const char *d = find_delimiter(b, e, delimiter);
+      if(d != e)
+      {
+        const size_t len = (size_t)(d - b) + 1;
+        pos += len;
+        if(use_carry)
+        {
+          carry.append(b, len);
+          line = carry;
+        }
+        else
+          line = std::string_view(b, len);
+        return;
+      }
+      if(b != e)
+      {
+        carry.append(b, (size_t)(e - b));
+        use_carry = true;
+      }
+      if(eof)
+      {
+        // last line without a delimiter, or no more lines
+        pos = block.size();
+        line = carry;
+        done = !use_carry;
+        return;
+      }
+      block = prefetcher.next_block();
+      pos = 0;
+      if(block.empty())
+        eof = true;
+    }
+  }
+};
+
+
+
+
+
+
 void test_iterate()
 {
     fmt::print("--> test_iterate reading lines from \"testfile.txt\"...\n");
@@ -365,10 +1246,347 @@ void test_range()
 
 
 
+void test_mapped_range()
+{
+    fmt::print("--> test_mapped_range reading lines from \"testfile.txt\" with MappedFileChunkReader...\n");
+    MappedFileChunkReader fr("testfile.txt", '\n');
+    static_assert(std::forward_iterator<MappedFileChunkIterator>);
+    static_assert(std::ranges::forward_range<MappedFileChunkReader>);
+    // Lines can be kept after the iterator has moved on, for as long as fr exists:
+    std::vector<std::string_view> lines;
+    for (auto line : fr | std::views::filter([](const auto s){ return (s.length() > 4); }))
+      lines.push_back(line);
+    for (auto line : lines)
+      fmt::print("\t>3 characters: '{}'\n", line.substr(0, line.size() - 1));
+    size_t n = 0;
+    size_t total = 0;
+    for (auto line : fr)
+    {
+      ++n;
+      total += line.size();
+    }
+    assert(total == fr.contents().size());
+    fmt::print("...done. {} lines, {} bytes.\n", n, total);
+}
+
+
+
+void test_block_reader()
+{
+    fmt::print("--> test_block_reader reading lines from \"testfile.txt\" with BlockFileChunkReader...\n");
+    static_assert(std::input_iterator<BlockFileChunkIterator>);
+    // Read with a tiny block size, so that lines span blocks and the buffer must be enlarged, and check that we get the same lines as MappedFileChunkReader:
+    MappedFileChunkReader expected("testfile.txt", '\n');
+    for(size_t block_size : {1, 3, 64, 1024})
+    {
+      BlockFileChunkReader fr("testfile.txt", '\n', block_size);
+      auto e = expected.begin();
+      for (auto line : fr)
+      {
+        assert(e != expected.end() && line == *e);
+        ++e;
+      }
+      assert(e == expected.end());
+    }
+    BlockFileChunkReader fr("testfile.txt", '\n');
+    for (auto line : fr)
+      fmt::print("\t> read line: '{}', length={}\n", line.substr(0, line.size() - 1), line.size());
+
+    // find_delimiter() at each possible position and length
+    std::string str(100, 'x');
+    for(size_t len = 0; len < str.size(); ++len)
+      for(size_t i = 0; i <= len; ++i)
+      {
+        if(i < len) str[i] = ',';
+        assert(find_delimiter(str.data(), str.data() + len, ',') == str.data() + i);
+        if(i < len) str[i] = 'x';
+      }
+    fmt::print("...done.\n");
+}
+
+
+
+void test_parallel()
+{
+    fmt::print("--> test_parallel splitting \"testfile.txt\" into ranges for processing in parallel...\n");
+    MappedFileChunkReader fr("testfile.txt", '\n');
+    const auto all = fr.contents();
+    for(size_t n = 1; n <= 40; ++n)
+    {
+      const auto ranges = fr.split(n);
+      assert(!ranges.empty() && ranges.size() <= n);
+      // ranges are contiguous, cover the whole file, and each ends with a delimiter (except possibly the last)
+      std::string joined;
+      for(const auto& r : ranges)
+      {
+        assert(r.contents().data() == all.data() + joined.size());
+        joined += r.contents();
+        assert(r.contents().back() == '\n' || joined.size() == all.size());
+      }
+      assert(joined == all);
+    }
+    for(const auto& r : fr.split(3))
+    {
+      fmt::print("\trange: ");
+      for(auto line : r)
+        fmt::print("'{}' ", line.substr(0, line.size() - 1));
+      fmt::print("\n");
+    }
+
+    std::atomic<size_t> lines = 0;
+    std::atomic<size_t> bytes = 0;
+    parallel_for_each_line(fr, [&](std::string_view line) { ++lines; bytes += line.size(); }, 4);
+    assert(lines == 6 && bytes == all.size());
+
+    // The ranges from split() can also be given to std::for_each() with std::execution::par, though with GCC's library this
+    // requires linking with TBB (-ltbb), so the plain sequential std::for_each() is used here to show it.
+    const auto ranges = fr.split(4);
+    std::atomic<size_t> par_lines = 0;
+    std::for_each(ranges.begin(), ranges.end(), [&](const MappedFileChunkRange& r) {
+      par_lines += (size_t) std::ranges::distance(r.begin(), r.end());
+    });
+    assert(par_lines == 6);
+    fmt::print("...done.\n");
+}
+
+
+
+void test_prefetch_reader()
+{
+    fmt::print("--> test_prefetch_reader reading lines from \"testfile.txt\" with PrefetchFileChunkReader...\n");
+    static_assert(std::input_iterator<ChunkReaderIterator<PrefetchFileChunkReader<>>>);
+    MappedFileChunkReader expected("testfile.txt", '\n');
+    auto check = [&expected]<typename ReaderT>(ReaderT& fr) {
+      auto e = expected.begin();
+      for (auto line : fr)
+      {
+        assert(e != expected.end() && line == *e);
+        ++e;
+      }
+      assert(e == expected.end());
+    };
+    // Small block sizes, so that lines span several blocks, and the file is exactly a multiple of the block size
+    for(size_t block_size : {1, 2, 4, 7, 28, 1024})
+    {
+      PrefetchFileChunkReader<> fr("testfile.txt", '\n', block_size);
+      check(fr);
+      PrefetchFileChunkReader<ThreadBlockPrefetcher<2>> fr2("testfile.txt", '\n', block_size);
+      check(fr2);
+#ifdef HAVE_URING_BLOCK_PREFETCHER
+      PrefetchFileChunkReader<UringBlockPrefetcher<>> fr3("testfile.txt", '\n', block_size);
+      check(fr3);
+#endif
+    }
+    {
+      // Destroy reader without reading all lines, while the prefetcher may still be reading.
+      PrefetchFileChunkReader<> fr("testfile.txt", '\n', 2);
+      auto i = fr.begin();
+      assert(*i == "one\n");
+    }
+    PrefetchFileChunkReader<> fr("testfile.txt", '\n');
+    for (auto line : fr)
+      fmt::print("\t> read line: '{}', length={}\n", line.substr(0, line.size() - 1), line.size());
+    fmt::print("...done.\n");
+}
+
+
+
+void test_line_index()
+{
+    fmt::print("--> test_line_index indexing lines of \"testfile.txt\"...\n");
+    static_assert(std::random_access_iterator<IndexedFileChunkIterator>);
+    static_assert(std::ranges::random_access_range<IndexedFileChunkReader>);
+    static_assert(std::ranges::sized_range<IndexedFileChunkReader>);
+    MappedFileChunkReader expected("testfile.txt", '\n');
+    std::vector<std::string_view> lines;
+    for(auto line : expected)
+      lines.push_back(line);
+    IndexedFileChunkReader fr("testfile.txt", '\n');
+    assert(fr.size() == lines.size());
+    for(size_t i = 0; i < lines.size(); ++i)
+      assert(fr[i] == lines[i]);
+    assert(*(fr.end() - 1) == "six\n");
+    assert(fr.begin()[2] == "three\n");
+    for (auto line : std::ranges::subrange(fr.begin() + 2, fr.begin() + 4))
+      fmt::print("\tline: '{}'\n", line.substr(0, line.size() - 1));
+    // iterate backwards
+    std::string rev;
+    for(auto i = fr.end(); i != fr.begin(); )
+      rev += *--i;
+    assert(rev == "six\nfive\nfour\nthree\ntwo\none\n");
+
+    // Build index incrementally, with pieces ending in the middle of a line, at a delimiter, and at the start of a line, and with no final delimiter.
+    const std::string_view data = "a\nbb\n\nccc\nd";
+    for(size_t split = 0; split <= data.size(); ++split)
+    {
+      LineIndex idx;
+      idx.extend(data.substr(0, split));
+      idx.extend(data);
+      assert(idx.size() == 5);
+      assert(idx.line_begin(1) == 2 && idx.line_end(1) == 5);
+      assert(idx.line_begin(2) == 5 && idx.line_end(2) == 6);
+      assert(idx.line_begin(4) == 10 && idx.line_end(4) == 11);
+    }
+    LineIndex empty;
+    empty.extend("");
+    assert(empty.size() == 0);
+    LineIndex big;
+    std::string many;
+    for(int i = 0; i < 1000; ++i)
+      many += fmt::format("line {}\n", i);
+    big.extend(many);
+    assert(big.size() == 1000);
+    assert(many.substr(big.line_begin(777), big.line_end(777) - big.line_begin(777)) == "line 777\n");
+
+    // Sidecar index file: write, then grow the file and reopen, which loads the saved index and then indexes only the new lines.
+    const auto tmp = std::filesystem::temp_directory_path() / "read_file_lines_as_range_2_test_index.txt";
+    FILE *fp = fopen(tmp.c_str(), "w");
+    fputs(many.c_str(), fp);
+    fclose(fp);
+    {
+      IndexedFileChunkReader r(tmp, '\n', true);
+      assert(r.size() == 1000);
+      fp = fopen(tmp.c_str(), "a");
+      fputs("appended line\nand another", fp);
+      fclose(fp);
+      r.refresh();
+      assert(r.size() == 1002 && r[1001] == "and another");
+    }
+    LineIndex saved;
+    assert(saved.load(std::filesystem::path(tmp) += ".lineindex"));
+    assert(saved.size() == 1002 && saved.indexed_size() == many.size() + 25);
+    const auto sidecar = std::filesystem::path(tmp) += ".lineindex";
+    const auto old_time = std::filesystem::last_write_time(sidecar) - std::chrono::hours(1);
+    std::filesystem::last_write_time(sidecar, old_time);
+    {
+      IndexedFileChunkReader r(tmp, '\n', true);
+      assert(r.size() == 1002 && r[1000] == "appended line\n" && r[5] == "line 5\n");
+    }
+    assert(std::filesystem::last_write_time(sidecar) == old_time); // nothing new to index, so not saved again
+
+    // A saved index whose header counts don't match its size is not loaded.
+    {
+      std::string bad(48 + 8 + 4, '\0');
+      const uint64_t header[] = { 0x3158444e494c4d48, '\n', LineIndex::lines_per_block, many.size(), (uint64_t)1 << 40, 0 };
+      memcpy(bad.data(), header, sizeof(header));
+      fp = fopen(sidecar.c_str(), "wb");
+      fwrite(bad.data(), 1, bad.size(), fp);
+      fclose(fp);
+      LineIndex corrupt;
+      assert(!corrupt.load(sidecar) && corrupt.size() == 0);
+    }
+
+    // If the sidecar can't be written (here, because a directory is in the way), the file can still be opened.
+    std::filesystem::remove(sidecar);
+    std::filesystem::create_directory(sidecar);
+    {
+      IndexedFileChunkReader r(tmp, '\n', true);
+      assert(r.size() == 1002);
+    }
+    std::filesystem::remove(sidecar);
+    std::filesystem::remove(tmp);
+    fmt::print("...done. (Index of 1000 lines uses {} bytes)\n", big.memory_size());
+}
+
+
+
+#ifdef ENABLE_BENCHMARK
+
+#include "benchmark/benchmark.h"
+
+// Generate a file of short CSV lines, larger than testfile.txt, in the temporary directory (once).
+static const std::filesystem::path& benchmark_file()
+{
+  static const std::filesystem::path path = []{
+    auto p = std::filesystem::temp_directory_path() / "read_file_lines_as_range_2_benchmark.csv";
+    FILE *fp = fopen(p.c_str(), "w");
+    if(!fp)
+      throw std::system_error(errno, std::system_category(), STRERROR(errno));
+    for(unsigned int i = 0; i < 1'000'000; ++i)
+      fmt::print(fp, "{},sensor{},{}.{},ok\n", 1700000000 + i, i % 97, i % 1000, i % 10);
+    fclose(fp);
+    return p;
+  }();
+  return path;
+}
+
+template<typename ReaderT>
+static void bench_read_lines(benchmark::State& state) {
+  const auto& path = benchmark_file();
+  const auto bytes = std::filesystem::file_size(path);
+  for (auto _ : state) {
+    ReaderT fr(path, '\n');
+    size_t n = 0;
+    for (auto line : fr)
+      n += line.size();
+    benchmark::DoNotOptimize(n);
+  }
+  state.SetBytesProcessed(state.iterations() * (int64_t)bytes);
+}
+BENCHMARK_TEMPLATE(bench_read_lines, FileChunkReader);
+BENCHMARK_TEMPLATE(bench_read_lines, BlockFileChunkReader);
+BENCHMARK_TEMPLATE(bench_read_lines, MappedFileChunkReader);
+BENCHMARK_TEMPLATE(bench_read_lines, PrefetchFileChunkReader<>);
+#ifdef HAVE_URING_BLOCK_PREFETCHER
+BENCHMARK_TEMPLATE(bench_read_lines, PrefetchFileChunkReader<UringBlockPrefetcher<>>);
+#endif
+
+static void bench_read_lines_parallel(benchmark::State& state) {
+  const auto& path = benchmark_file();
+  const auto bytes = std::filesystem::file_size(path);
+  for (auto _ : state) {
+    MappedFileChunkReader fr(path, '\n');
+    std::atomic<size_t> n = 0;
+    parallel_for_each_line(fr, [&n](std::string_view line) { if(line.size() > 40) ++n; }, (size_t)state.range(0));
+    benchmark::DoNotOptimize(n.load());
+  }
+  state.SetBytesProcessed(state.iterations() * (int64_t)bytes);
+}
+BENCHMARK(bench_read_lines_parallel)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+
+// Build a LineIndex of the whole file
+static void bench_build_line_index(benchmark::State& state) {
+  const auto& path = benchmark_file();
+  MappedFileChunkReader fr(path, '\n');
+  for (auto _ : state) {
+    LineIndex index;
+    index.extend(fr.contents());
+    benchmark::DoNotOptimize(index.size());
+  }
+  state.SetBytesProcessed(state.iterations() * (int64_t)fr.contents().size());
+}
+BENCHMARK(bench_build_line_index);
+
+// Access random lines by number with IndexedFileChunkReader
+static void bench_indexed_random_line(benchmark::State& state) {
+  IndexedFileChunkReader fr(benchmark_file(), '\n');
+  size_t n = 0;
+  for (auto _ : state) {
+    n = (n * 2654435761u + 1) % fr.size();
+    benchmark::DoNotOptimize(fr[n]);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bench_indexed_random_line);
+
+BENCHMARK_MAIN();
+
+#else
+
 int main()
 {
   test_iterate();
   test_range();
+  test_mapped_range();
+  test_block_reader();
+  test_parallel();
+  test_prefetch_reader();
+  test_line_index();
+#if RHM_INSTRUMENTATION
+  rhm::instrument::print_report();
+#endif
   return 0;
 }
 
+#endif
+
@@ -2,6 +2,18 @@
 
 #include <iostream>
 #include <iterator>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <ranges>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "instrumentation_hooks.hh"
 
 namespace rhm {
 
@@ -16,6 +28,48 @@ namespace rhm {
     {c.size()} -> std::convertible_to<size_t>;
   };
 
+  namespace _private {
+    // Size of a cache line, used to separate data written by different threads (see spsc_ring_buffer and mpmc_queue).
+    // std::hardware_destructive_interference_size could be used instead, but GCC warns that its value
+    // may differ between compiler versions or -mtune options, so it shouldn't be used in headers.
+    constexpr size_t cache_line_size = 64;
+
+    // Replace the item in a slot with a new item made from args: If a single argument is given and the item type can be
+    // assigned from it, assign it directly (which lets the old item reuse memory it already owns, e.g. std::string or std::vector
+    // capacity), otherwise construct a new item and move assign it into the slot.
+    template<typename ItemT, typename... Args>
+    void assign_item(ItemT& dest, Args&&... args)
+    {
+      if constexpr(sizeof...(Args) == 1 && (std::is_assignable_v<ItemT&, Args&&> && ...))
+        dest = (std::forward<Args>(args), ...);
+      else
+        dest = ItemT(std::forward<Args>(args)...);
+    }
+
+    // Counter which is only incremented by one thread, but which can be read from other threads without locking.
+    // (Since there is only one writer, the increment doesn't need an atomic read-modify-write instruction.)
+    class relaxed_counter {
+      std::atomic<size_t> n{0};
+    public:
+      relaxed_counter() noexcept = default;
+      relaxed_counter(const relaxed_counter& other) noexcept : n(other.get()) {}
+      relaxed_counter& operator=(const relaxed_counter& other) noexcept { n.store(other.get(), std::memory_order_relaxed); return *this; }
+      void add(size_t i = 1) noexcept { n.store(n.load(std::memory_order_relaxed) + i, std::memory_order_relaxed); }
+      size_t get() const noexcept { return n.load(std::memory_order_relaxed); }
+      void reset() noexcept { n.store(0, std::memory_order_relaxed); }
+    };
+  }
+
+  /** What ring_buffer does when a new item is pushed while it is full. */
+  enum class ring_buffer_full_policy {
+    replace_oldest,  ///< Remove the oldest item from the front of the buffer, and replace it with the new item. (Default.)
+    reject_new       ///< Don't add the new item; push() returns false.
+  };
+
+  // Test that T is a contiguous container with a fixed size N known at compile time (e.g. std::array<ItemT, N>).
+  template<typename T, size_t N>
+  concept FixedSizeContiguousContainerType = std::ranges::contiguous_range<T> && requires { std::tuple_size<T>::value; } && (std::tuple_size<T>::value == N);
+
   /* Not used. See discussion at ring_buffer::push_imp() below.
   template<typename CT> // todo could constrain CT to StdContainerType, and also check for CT::value_type
   concept ContainerTypeHasPushBack = requires (CT c, typename CT::value_type item) { c.push_back(item); };
@@ -59,20 +113,36 @@ namespace rhm {
     can be accessed from the front with pop() or front().  (But most recent item cannot be accessed
     from the back.) If an old item is replaced by a new item by push(), then T's copy or move
     assignment operator is used to replace the item. 
+
+    Batches of items can be added with push_range() and removed with pop_into().  If the container is
+    a fixed size contiguous container with power of two capacity (see the specialization below), these
+    copy the items with at most two std::copy() or memcpy() calls, and contiguous_readable() and
+    contiguous_writable() can also be used to access the items (or unused slots) directly as spans.
   
+    The FullPolicy parameter selects what happens when an item is pushed while the buffer is full:
+    ring_buffer_full_policy::replace_oldest (the default) replaces the oldest item, and
+    ring_buffer_full_policy::reject_new does not add the new item (and push() returns false). The number
+    of items replaced or rejected is counted, and can be read (from any thread) with replaced_count() and rejected_count().
+
+    If RHM_INSTRUMENTATION is enabled (see instrumentation.hh), push(), emplace() and pop() record the number of items
+    in the buffer in the "ring_buffer.occupancy" counter, whose maximum is the high water mark of all ring_buffers.
+
     @note If reset() is called or items are popped(), old items are not destroyed (destructors not
     called).  Destructors may be called if the item is later replaced by a new item. 
   
     @note This implementation is not thread safe; it is not designed or optimized for simultaneous
-    reads and writes from different threads. (A mutex lock or similar may be required.) A future
-    version could do this. E.g. use atomics (e.g. see <https://rigtorp.se/ringbuffer/>)
+    reads and writes from different threads. (A mutex lock or similar may be required.) For one
+    producer thread and one consumer thread, use spsc_ring_buffer (spsc_ring_buffer.hh) instead.
+
+    @note If ContainerT is a fixed size contiguous container such as std::array, and Capacity is a power of two,
+    a more efficient specialization is used which stores positions as counters instead of iterators. (See below.)
 
     @note Requires C++20 mode when compiling.
 
     @todo front/back naming might be confusing for a FIFO buffer since we add to back and pop from front, but this matches other containers.
 
  */
-template<size_t Capacity, StdContainerType ContainerT>
+template<size_t Capacity, StdContainerType ContainerT, ring_buffer_full_policy FullPolicy = ring_buffer_full_policy::replace_oldest>
 class ring_buffer 
 {
 
@@ -80,27 +150,31 @@ class ring_buffer
 
 public:
 
-  ring_buffer() : curSize(0), front_it(container.end()), back_it(container.begin())
+  ring_buffer() : container(), curSize(0), front_it(container.end()), back_it(container.begin())
   {}
 
-  ring_buffer(const ring_buffer<Capacity, ContainerT>& other) :
+  ring_buffer(const ring_buffer<Capacity, ContainerT, FullPolicy>& other) :
     container(other.container),
     curSize(other.curSize), 
     front_it(other.front_it == other.container.end() ? container.end() : (container.begin() + std::distance(other.container.begin(), typename ContainerT::const_iterator{other.front_it}))),
-    back_it(container.begin() + std::distance(other.container.begin(), typename ContainerT::const_iterator{other.back_it}))
+    back_it(container.begin() + std::distance(other.container.begin(), typename ContainerT::const_iterator{other.back_it})),
+    replaced(other.replaced),
+    rejected(other.rejected)
   { }
 
-  ring_buffer<Capacity, ContainerT> & operator=(const ring_buffer<Capacity, ContainerT>& other) 
+  ring_buffer<Capacity, ContainerT, FullPolicy> & operator=(const ring_buffer<Capacity, ContainerT, FullPolicy>& other) 
   {
     if(&other == this) [[unlikely]] return *this;
     container = other.container;
     curSize = other.curSize;
     front_it = other.front_it == other.container.end() ? container.end() : (container.begin() + std::distance(other.container.begin(), typename ContainerT::const_iterator{other.front_it}));
     back_it = other.front_it == other.container.end() ? container.end() : (container.begin() + std::distance(other.container.begin(), typename ContainerT::const_iterator{other.back_it}));
+    replaced = other.replaced;
+    rejected = other.rejected;
     return *this;
   }
 
-  ring_buffer<Capacity, ContainerT> & operator=(ring_buffer<Capacity, ContainerT>&& old) 
+  ring_buffer<Capacity, ContainerT, FullPolicy> & operator=(ring_buffer<Capacity, ContainerT, FullPolicy>&& old) 
   {
     if(&old == this) [[unlikely]] return *this;
     auto old_front_pos = std::distance(old.container.begin(), old.front_it);
@@ -109,10 +183,12 @@ public:
     curSize = old.curSize;
     front_it = container.begin() + old_front_pos;
     back_it = container.begin() + old_back_pos;
+    replaced = old.replaced;
+    rejected = old.rejected;
     return *this;
   }
 
-  ring_buffer(ring_buffer<Capacity, ContainerT>&& old) 
+  ring_buffer(ring_buffer<Capacity, ContainerT, FullPolicy>&& old) 
   { 
     auto old_front_pos = std::distance(old.container.begin(), old.front_it);
     auto old_back_pos = std::distance(old.container.begin(), old.back_it);
@@ -120,6 +196,8 @@ public:
     curSize = old.curSize;
     front_it = container.begin() + old_front_pos;
     back_it = container.begin() + old_back_pos;
+    replaced = old.replaced;
+    rejected = old.rejected;
   }
 
   // todo allow construction/assignment with different capacities, truncate from front for smaller capacity or copy into front of new container for larger?
@@ -176,21 +254,35 @@ public:
   /** Same as advance_front() */
   void pop_front() { advance_front(); };
 
-  /** Advance the back (an 'empty' push), if the buffer is not full.  'Used' size will be incremented.  */
-  void advance_back() 
+  /** Advance the back (an 'empty' push).  'Used' size will be incremented.  If the buffer is full, then
+      with the replace_oldest policy the front item is first removed (and counted in replaced_count()), and with the
+      reject_new policy nothing is changed, the rejection is counted in rejected_count(), and false is returned.
+   */
+  bool advance_back()
   {
-    if(curSize == Capacity)
+    if(curSize == Capacity) [[unlikely]]
     {
-      std::cerr << "ring_buffer: advance_back(): buffer is full, can't advance back.\n" << std::endl;
+      if constexpr(FullPolicy == ring_buffer_full_policy::reject_new)
+      {
+        rejected.add();
+        return false;
+      }
+      else
+      {
+        advance_front();
+        replaced.add();
+      }
     }
     assert(curSize < Capacity); // size should either have been adjusted by advance_front(), or container stil has spare capacity.
-    // throw?
 
     ++back_it;
 
     if(back_it == container.end())
     {
-      back_it = container.begin();
+      // Wrap around, unless the container can still grow (in which case the next push() will use push_back()).
+      constexpr bool has_push_back = requires(ContainerT c, ItemT v) { c.push_back(v); };
+      if(!has_push_back || container.size() >= Capacity)
+        back_it = container.begin();
     }
 
     if(front_it == container.end()) // was in initial or empty state, fix front now that we have something
@@ -201,6 +293,7 @@ public:
     assert(std::distance(container.begin(), container.end()) > 0);
 
     ++curSize;
+    return true;
   }
 
 
@@ -245,56 +338,84 @@ private:
   }
   */
 
-  void push_imp(ContainerT& cont, const ItemT& item)
+  template<typename... Args>
+  bool push_imp(ContainerT& cont, Args&&... args)
   {
     constexpr bool has_push_back = requires(ContainerT c, ItemT v) { c.push_back(v); };
     if constexpr(has_push_back) 
     {
-      if(cont.size() < Capacity) // todo also need consteval check for push_back function, throw or assert if we don't
+      if(cont.size() < Capacity && back_it == cont.end())
       {
-        cont.push_back(item);
-        front_it = cont.begin();
+        // push_back() may invalidate front_it, so restore it from its position. (If empty, the new item will be the front.)
+        const auto front_pos = (curSize == 0) ? std::distance(cont.begin(), cont.end()) : std::distance(cont.begin(), front_it);
+        constexpr bool has_emplace_back = requires(ContainerT c, Args&&... a) { c.emplace_back(std::forward<Args>(a)...); };
+        if constexpr(has_emplace_back)
+          cont.emplace_back(std::forward<Args>(args)...);
+        else
+          cont.push_back(ItemT(std::forward<Args>(args)...));
+        front_it = std::next(cont.begin(), front_pos);
         back_it = cont.end();
         ++curSize;
-        return;
+        rhm_instrument_record("ring_buffer.occupancy", curSize);
+        return true;
       }
     }
     if(curSize == Capacity)
+    {
+      if constexpr(FullPolicy == ring_buffer_full_policy::reject_new)
+      {
+        rejected.add();
+        return false;
+      }
       advance_front(); // throw away the item at the front, no longer full, curSize == Capacity-1; when we advance_back(), then back_it will again be correct.
+      replaced.add();
+    }
     if(back_it == cont.end()) // no longer filling container to capacity, need to "wrap around"
-      back_it = cont.begin(); 
-    *back_it = item;
+      back_it = cont.begin();
+    _private::assign_item(*back_it, std::forward<Args>(args)...);
     advance_back();
+    rhm_instrument_record("ring_buffer.occupancy", curSize);
+    return true;
   }
 
 
 
 public:
-  /** Push a new item.  If the buffer is full, then the oldest item is replaced with the new item.  If the current size of the container is not yet at capacity, and the container type (ContainerT) has a push_back() method, then push the item (and increase the size of the container) with push_back(). 
+  /** Push a new item.  If the buffer is full, then depending on FullPolicy, either the oldest item is replaced with the new item (replace_oldest), or the new item is not added and false is returned (reject_new).  If the current size of the container is not yet at capacity, and the container type (ContainerT) has a push_back() method, then push the item (and increase the size of the container) with push_back().
+      @return true if the item was added, false if it was rejected.
   */
-  void push(const ItemT& item) 
+  bool push(const ItemT& item)
   {
-    push_imp(container, item);
+    return push_imp(container, item);
   }
 
-  /** Push a new item.  If the buffer is full, then the oldest item is replaced with the new item.  */
-/*
-  void push(ItemT&& item) 
+  /** Push a new item, moving it into the buffer.  If the buffer is full, then (depending on FullPolicy) the oldest item is replaced with the new item (by move assignment), or the new item is rejected. */
+  bool push(ItemT&& item)
   {
-    // push_back to expand container if neccesary
-    if(container.size() < Capacity) // todo also need consteval check for push_back function
-    {
-      container.push_back(item);
-      advance_back();
-      return;
-    }
-    
-    if(full())
-      advance_front(); // throw away the item at the front, when we advance_back(), then back will be pointing to it.
-    *back_it = item;
-    advance_back();
+    return push_imp(container, std::move(item));
+  }
+
+  /** Add a new item made from @a args.  If a single argument is given and ItemT can be assigned from it (e.g. a
+      const char* or std::string_view for a std::string item), the old item in the slot is assigned from it
+      directly, which may reuse memory already allocated by the old item. Otherwise a new item is constructed from @a args
+      (with emplace_back() if the container is still growing) and move assigned into the slot.
+      If the buffer is full, then the oldest item is replaced, or the new item is rejected, as with push().
+  */
+  template<typename... Args>
+  bool emplace(Args&&... args)
+  {
+    return push_imp(container, std::forward<Args>(args)...);
+  }
+
+  /** Remove the front (oldest) item and return it, moving it out of the buffer.  The buffer must not be empty(). */
+  ItemT pop()
+  {
+    assert(!empty());
+    rhm_instrument_record("ring_buffer.occupancy", curSize);
+    ItemT item = std::move(*front());
+    advance_front();
+    return item;
   }
-*/
 
   /** Fill buffer to capacity with given value. */
   void fill(const ItemT& value)
@@ -304,6 +425,27 @@ public:
        push(value);
   }
 
+  /** Push each item in @a items, as if by calling push() for each. Return the number of items pushed. */
+  size_t push_range(std::span<const ItemT> items)
+  {
+    size_t n = 0;
+    for(const auto& item : items)
+      n += push(item) ? 1 : 0;
+    return n;
+  }
+
+  /** Pop up to out.size() items from the front of the buffer, moving them into @a out. Return the number of items popped. */
+  size_t pop_into(std::span<ItemT> out)
+  {
+    size_t n = 0;
+    while(n < out.size() && !empty())
+    {
+      out[n++] = std::move(*front());
+      advance_front();
+    }
+    return n;
+  }
+
   /** Print contents to stderr. 
       @see operator<<(std::ostream&, const ring_buffer&)
       @pynote use printQueue() instead of print() (which is a reserved word in Python)
@@ -312,8 +454,8 @@ public:
   {
     std::cerr << *this << '\n';
   }
-  template<size_t Cap, class CT> 
-  friend std::ostream& operator<<(std::ostream& os, const ring_buffer<Cap, CT>& rb);
+  template<size_t Cap, class CT, ring_buffer_full_policy P>
+  friend std::ostream& operator<<(std::ostream& os, const ring_buffer<Cap, CT, P>& rb);
 
   /** Get the number of items currently in the buffer. */
   size_t size() const {
@@ -348,8 +490,24 @@ public:
     return(curSize == Capacity);
   }
 
+  /** Number of items that have been removed to make space for new items (replace_oldest policy). May be read from other threads. */
+  size_t replaced_count() const noexcept {
+    return replaced.get();
+  }
+
+  /** Number of new items that were not added because the buffer was full (reject_new policy). May be read from other threads. */
+  size_t rejected_count() const noexcept {
+    return rejected.get();
+  }
+
+  /** Set replaced_count() and rejected_count() back to 0. */
+  void reset_counters() noexcept {
+    replaced.reset();
+    rejected.reset();
+  }
+
   /** Return an iterator representing an invalid item. Compare to the return
-      values of front(), back(), pop(), etc. */
+      values of front() and back(). */
   typename ContainerT::iterator nil() {
     return container.end();
   }
@@ -361,16 +519,19 @@ public:
 private:
   size_t curSize;
   typename ContainerT::iterator front_it, back_it;   // note need to be after container so that copy/move constructors/operators can refer to container member when assigning these
-  // push to back, pop from front; front will point to first item, 
-  // back to one past last. 
+  // push to back, pop from front; front will point to first item,
+  // back to one past last.
+
+  _private::relaxed_counter replaced;
+  _private::relaxed_counter rejected;
 
 };
 
 
 /** Output the current contents of the buffer.   Items are printed as they appear in the container, with the current position and size of the ring buffer marked with square brackets.
 */
-template<size_t Capacity, class ContainerT>
-inline std::ostream& operator<<(std::ostream& os, const ring_buffer<Capacity, ContainerT>& rb)
+template<size_t Capacity, class ContainerT, ring_buffer_full_policy FullPolicy>
+inline std::ostream& operator<<(std::ostream& os, const ring_buffer<Capacity, ContainerT, FullPolicy>& rb)
 {
   //printf("container.begin()=0x%p container.end()=0x%p container.size()=%d curSize=%lu\n", container.begin(), container.end(), container.size(), curSize);
   if(rb.container.begin() == rb.container.end())
@@ -391,5 +552,320 @@ inline std::ostream& operator<<(std::ostream& os, const ring_buffer<Capacity, Co
 }
 
 
+
+/** @brief Specialization of ring_buffer for a fixed size contiguous container (e.g. std::array) with a Capacity that is a power of two.
+
+    This has the same interface and behavior as the general ring_buffer, but instead of keeping iterators to
+    the front and back of the buffer, and checking whether they need to wrap around to the beginning of the container
+    (and using container.end() to represent the empty state), it keeps two counters that only increase: the number of
+    items ever removed from the front (head) and the number of items ever added to the back (tail). The position
+    of an item in the container is its counter masked with (Capacity-1), and size() is just tail - head.  
+    This avoids most branches in push() and pop(), and lets the compiler optimize (e.g. vectorize) loops over the buffer.
+
+    This specialization is used automatically, e.g. ring_buffer<16, std::array<int, 16>>.
+
+    (A 64-bit size_t counter won't overflow in practice.)
+*/
+template<size_t Capacity, StdContainerType ContainerT, ring_buffer_full_policy FullPolicy>
+  requires (std::has_single_bit(Capacity) && FixedSizeContiguousContainerType<ContainerT, Capacity>)
+class ring_buffer<Capacity, ContainerT, FullPolicy>
+{
+
+  using ItemT = typename ContainerT::value_type;
+  static constexpr size_t mask = Capacity - 1;
+
+public:
+
+  ring_buffer() = default;
+  ring_buffer(const ring_buffer<Capacity, ContainerT, FullPolicy>& other) = default;
+  ring_buffer(ring_buffer<Capacity, ContainerT, FullPolicy>&& old) = default;
+  ring_buffer<Capacity, ContainerT, FullPolicy>& operator=(const ring_buffer<Capacity, ContainerT, FullPolicy>& other) = default;
+  ring_buffer<Capacity, ContainerT, FullPolicy>& operator=(ring_buffer<Capacity, ContainerT, FullPolicy>&& old) = default;
+
+  /** Get an iterator for the front item (the item that would be returned by pop()). If the buffer is currently empty, nil() will be returned. */
+  typename ContainerT::iterator front() {
+    if(empty())
+      return nil();
+    return slot(head);
+  }
+
+  /** Get an iterator for the back of the buffer (the next unused "slot", which would be replaced by push()).  If the buffer is full, nil() is returned. */
+  typename ContainerT::iterator back() {
+    if(full())
+      return nil();
+    return slot(tail);
+  }
+
+  /** Advance the front of the buffer. 'Used' size will be decremented.  */
+  void advance_front() {
+    assert(!empty());
+    ++head;
+  }
+
+  /** Same as advance_front() */
+  void pop_front() { advance_front(); }
+
+  /** Advance the back (an 'empty' push).  'Used' size will be incremented. If full, either remove the front item or reject, depending on FullPolicy (see the general ring_buffer::advance_back()). */
+  bool advance_back() {
+    if(!make_space()) [[unlikely]]
+      return false;
+    ++tail;
+    return true;
+  }
+
+  /** Advance the front of the buffer by @a n items (e.g. after reading them via contiguous_readable()). */
+  void advance_front(size_t n) {
+    assert(n <= size());
+    head += n;
+  }
+
+  /** Advance the back of the buffer by @a n items (e.g. after writing them via contiguous_writable()). */
+  void advance_back(size_t n) {
+    assert(n <= Capacity - size());
+    tail += n;
+  }
+
+  /** Push a new item.  If the buffer is full, then the oldest item is replaced with the new item, or the new item is rejected, depending on FullPolicy.
+      @return true if the item was added, false if it was rejected.
+   */
+  bool push(const ItemT& item)
+  {
+    return emplace(item);
+  }
+
+  /** Push a new item, moving it into the buffer.  If the buffer is full, then the oldest item is replaced with the new item, or the new item is rejected, depending on FullPolicy. */
+  bool push(ItemT&& item)
+  {
+    return emplace(std::move(item));
+  }
+
+  /** Add a new item made from @a args, assigning directly into the slot if possible.  (See the general ring_buffer::emplace().) */
+  template<typename... Args>
+  bool emplace(Args&&... args)
+  {
+    if(!make_space()) [[unlikely]]
+      return false;
+    _private::assign_item(*slot(tail), std::forward<Args>(args)...);
+    ++tail;
+    rhm_instrument_record("ring_buffer.occupancy", size());
+    return true;
+  }
+
+  /** Remove the front (oldest) item and return it, moving it out of the buffer.  The buffer must not be empty(). */
+  ItemT pop()
+  {
+    assert(!empty());
+    rhm_instrument_record("ring_buffer.occupancy", size());
+    ItemT item = std::move(*slot(head));
+    ++head;
+    return item;
+  }
+
+  /** Fill buffer to capacity with given value. */
+  void fill(const ItemT& value)
+  {
+    std::ranges::fill(container, value);
+    head = 0;
+    tail = Capacity;
+  }
+
+  /** Push each item in @a items, as if by calling push() for each: if there isn't enough space, then with
+      the replace_oldest policy the oldest items are replaced (and if there are more than Capacity items, only
+      the last Capacity items remain in the buffer), or with the reject_new policy, only the first items that fit are added.
+      The items are copied into at most two contiguous regions of the container (with memcpy() if ItemT is trivially copyable).
+      Return the number of items pushed.
+   */
+  size_t push_range(std::span<const ItemT> items)
+  {
+    const size_t space = Capacity - size();
+    if(items.size() > space)
+    {
+      if constexpr(FullPolicy == ring_buffer_full_policy::reject_new)
+      {
+        rejected.add(items.size() - space);
+        items = items.first(space);
+      }
+      else
+      {
+        replaced.add(items.size() - space);
+      }
+    }
+    const size_t total = items.size();
+    if(items.size() > Capacity)
+    {
+      tail += items.size() - Capacity; // skip items that would be replaced anyway
+      items = items.last(Capacity);
+    }
+    if(size() + items.size() > Capacity)
+      head = tail + items.size() - Capacity;  // replace oldest items
+    const size_t start = tail & mask;
+    const size_t n1 = std::min(items.size(), Capacity - start);
+    copy_items(items.data(), n1, container.data() + start);
+    copy_items(items.data() + n1, items.size() - n1, container.data());
+    tail += items.size();
+    return total;
+  }
+
+  /** Pop up to out.size() items from the front of the buffer, moving them into @a out in at most two contiguous
+      copies (with memcpy() if ItemT is trivially copyable). Return the number of items popped. 
+   */
+  size_t pop_into(std::span<ItemT> out)
+  {
+    const auto [r1, r2] = contiguous_readable();
+    const size_t n1 = std::min(out.size(), r1.size());
+    const size_t n2 = std::min(out.size() - n1, r2.size());
+    move_items(r1.data(), n1, out.data());
+    move_items(r2.data(), n2, out.data() + n1);
+    head += n1 + n2;
+    return n1 + n2;
+  }
+
+  /** Get the items currently in the buffer, from front to back, as up to two spans. (The second span is
+      empty unless the items wrap around the end of the container.) After reading (or moving from) some number
+      of items from the front, call advance_front(n).  The spans are invalidated by any other modification of the buffer.
+   */
+  std::array<std::span<ItemT>, 2> contiguous_readable() {
+    const size_t start = head & mask;
+    const size_t n1 = std::min(size(), Capacity - start);
+    return { std::span<ItemT>(container.data() + start, n1), std::span<ItemT>(container.data(), size() - n1) };
+  }
+
+  std::array<std::span<const ItemT>, 2> contiguous_readable() const {
+    const size_t start = head & mask;
+    const size_t n1 = std::min(size(), Capacity - start);
+    return { std::span<const ItemT>(container.data() + start, n1), std::span<const ItemT>(container.data(), size() - n1) };
+  }
+
+  /** Get the unused slots at the back of the buffer as up to two spans. (The second span is empty unless
+      the unused slots wrap around the end of the container.) After writing some number of new items into
+      the first slots, call advance_back(n).  The spans are invalidated by any other modification of the buffer.
+   */
+  std::array<std::span<ItemT>, 2> contiguous_writable() {
+    const size_t start = tail & mask;
+    const size_t avail = Capacity - size();
+    const size_t n1 = std::min(avail, Capacity - start);
+    return { std::span<ItemT>(container.data() + start, n1), std::span<ItemT>(container.data(), avail - n1) };
+  }
+
+  /** Print contents to stderr. 
+      @see operator<<(std::ostream&, const ring_buffer&)
+  */
+  void print() const
+  {
+    std::cerr << *this << '\n';
+  }
+
+  /** Get the number of items currently in the buffer. */
+  size_t size() const {
+    return tail - head;
+  }
+
+  /** Get the maximum capacity of the buffer (same as Capacity parameter). */
+  constexpr size_t capacity() const {
+    return Capacity;
+  }
+
+  /** Return true if the buffer is empty (has no 'used' items), false otherwise.  */
+  bool empty() const {
+    return tail == head;
+  }
+
+  /** Logically clear the bufer, resetting to initial empty state. The contents are not destroyed. */
+  void reset() {
+    head = tail = 0;
+  }
+
+  /** Return true if the buffer is full, false otherwise. */
+  bool full() const {
+    return size() == Capacity;
+  }
+
+  /** Number of items that have been removed to make space for new items (replace_oldest policy). May be read from other threads. */
+  size_t replaced_count() const noexcept {
+    return replaced.get();
+  }
+
+  /** Number of new items that were not added because the buffer was full (reject_new policy). May be read from other threads. */
+  size_t rejected_count() const noexcept {
+    return rejected.get();
+  }
+
+  /** Set replaced_count() and rejected_count() back to 0. */
+  void reset_counters() noexcept {
+    replaced.reset();
+    rejected.reset();
+  }
+
+  /** Return an iterator representing an invalid item. Compare to the return
+      values of front() and back(). */
+  typename ContainerT::iterator nil() {
+    return container.end();
+  }
+
+  /** Output the current contents of the buffer, in the same format as operator<<() for the general ring_buffer.  */
+  friend std::ostream& operator<<(std::ostream& os, const ring_buffer<Capacity, ContainerT, FullPolicy>& rb)
+  {
+    const size_t front_i = rb.head & mask;
+    const size_t back_i = rb.tail & mask;
+    for(size_t i = 0; i < Capacity; ++i)
+    {
+      if(i == back_i)
+        os << "]";
+      if(i != 0)
+        os << ",";
+      if(i == front_i)
+        os << "[";
+      os << rb.container[i];
+    }
+    return os;
+  }
+
+public:
+  ContainerT container;
+
+private:
+  typename ContainerT::iterator slot(size_t pos) {
+    return container.begin() + static_cast<typename ContainerT::difference_type>(pos & mask);
+  }
+
+  static void copy_items(const ItemT* src, size_t n, ItemT* dest) {
+    if constexpr(std::is_trivially_copyable_v<ItemT>)
+    {
+      if(n > 0)
+        std::memcpy(dest, src, n * sizeof(ItemT));
+    }
+    else
+      std::copy_n(src, n, dest);
+  }
+
+  static void move_items(ItemT* src, size_t n, ItemT* dest) {
+    if constexpr(std::is_trivially_copyable_v<ItemT>)
+      copy_items(src, n, dest);
+    else
+      std::move(src, src + n, dest);
+  }
+
+  // If full, remove the front item or return false, depending on FullPolicy.
+  bool make_space() {
+    if(full())
+    {
+      if constexpr(FullPolicy == ring_buffer_full_policy::reject_new)
+      {
+        rejected.add();
+        return false;
+      }
+      ++head; // throw away the item at the front
+      replaced.add();
+    }
+    return true;
+  }
+
+  size_t head = 0; // total number of items removed from the front
+  size_t tail = 0; // total number of items added to the back
+  _private::relaxed_counter replaced;
+  _private::relaxed_counter rejected;
+};
+
+
 } // end namespace rhm
 
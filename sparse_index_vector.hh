@@ -1,18 +1,108 @@
 
 #pragma once
 
-#include <vector>
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <ranges>
+#include <initializer_list>
+#include <cassert>
+#include <utility>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "instrumentation_hooks.hh"
 
 namespace rhm {
 
-/** std::vector but also stores separate set of arbitrary "sparse" indices or priorities for values that determines its order. Indices do not need to be unique, they are used to order the values not identify them.  Use this instead of a std::map<size_t, value> or std::multimap<size_t, value> if insertions or changes are not frequent.  E.g. you will be setting up a list of values at startup but will otherwise only be iterating over the list, or only with occasional additions and removals.  Insertions and removals currently require linear search of the indices (could be changed in the future.).  Insertions and removals may also result in reallocation of both the values and indices containers (std::vector objects).
-  @todo an iterator adapter of some kind that creates and returns std::pair<size_t, ValueT>'s (in Aria this would really just be for compatability with existing std::maps and std::multimaps)
+namespace _private {
+
+  // Functions used by sparse_index_vector::insert() to find the position of the first index in a sorted array of
+  // indices that is not less than a new index (same result as std::lower_bound()).  Which one is used depends on
+  // the number of indices (see sparse_index_vector::find_insert_position()).  These are also used by bench_sparse_index_vector.cc
+  // to find where the crossover points between them are.
+
+  // Simple linear search, stops at the first index not less than key.  Fastest for very small arrays.
+  inline size_t index_lower_bound_linear(const size_t *indices, size_t n, size_t key) noexcept
+  {
+    size_t i = 0;
+    while(i < n && indices[i] < key)
+      ++i;
+    return i;
+  }
+
+  // Since the indices are sorted, the insert position is the number of indices less than key: compare every index with
+  // key and count the results, without any branches (so no mispredictions), several indices at a time with AVX2 or NEON
+  // if available. (Without AVX2 or NEON, the compiler may be able to vectorize the scalar loop by itself.)
+  inline size_t index_lower_bound_count(const size_t *indices, size_t n, size_t key) noexcept
+  {
+    size_t count = 0;
+    size_t i = 0;
+#if defined(__AVX2__)
+    static_assert(sizeof(size_t) == sizeof(long long));
+    // AVX2 only has a signed 64-bit comparison, so flip the sign bits to compare unsigned values.
+    const __m256i sign = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
+    const __m256i k = _mm256_xor_si256(_mm256_set1_epi64x((long long)key), sign);
+    for(; i + 4 <= n; i += 4)
+    {
+      const __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + i)), sign);
+      const int lt = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v)));
+      count += (size_t) __builtin_popcount((unsigned int)lt);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    static_assert(sizeof(size_t) == sizeof(uint64_t));
+    const uint64x2_t k = vdupq_n_u64(key);
+    uint64x2_t acc = vdupq_n_u64(0);
+    for(; i + 2 <= n; i += 2)
+    {
+      // comparison result is all 1 bits (-1) in each lane where indices[i] < key, so subtracting it adds 1.
+      acc = vsubq_u64(acc, vcltq_u64(vld1q_u64(reinterpret_cast<const uint64_t*>(indices + i)), k));
+    }
+    count = vaddvq_u64(acc);
+#endif
+    for(; i < n; ++i)
+      count += (indices[i] < key);
+    return count;
+  }
+
+  // Binary search.  Fastest for large arrays.
+  inline size_t index_lower_bound_binary(const size_t *indices, size_t n, size_t key) noexcept
+  {
+    return (size_t) (std::lower_bound(indices, indices + n, key) - indices);
+  }
+
+} // namespace _private
+
+/** std::vector but also stores separate set of arbitrary "sparse" indices or priorities for values that determines its order. Indices do not need to be unique, they are used to order the values not identify them.  Use this instead of a std::map<size_t, value> or std::multimap<size_t, value> if insertions or changes are not frequent.  E.g. you will be setting up a list of values at startup but will otherwise only be iterating over the list, or only with occasional additions and removals.  Erasing by value requires a linear search of the values.  Insertions may also result in reallocation of both the values and indices containers (std::vector objects).
   @todo most accessors could be made constexpr, if only supporting C++20+  (or multiple versions of them?)
-  @todo insert() does a linear search to find the right position to insert the new value. we could check the size of the vector and do
-   this for small vectors, and do a binary search of the indices for larger vectors.  Or what about a more parallel search? (e.g. simd/vector comparisons, use unseq or par_unseq or par execution policy with std::find_if, also dependent on amount of data?)
+
+  insert() chooses how to search the indices for the insert position based on how many there are: a simple linear search for very few
+  indices (up to linear_search_max_size), a branchless compare-and-count over all indices (vectorized with AVX2 or NEON if enabled
+  when compiling) for a medium number (up to count_search_max_size), and a binary search (std::lower_bound()) for more.
+  See bench_sparse_index_vector.cc to measure where the crossover points are on a given system.  If RHM_INSTRUMENTATION is enabled
+  (see instrumentation.hh), the number of indices compared by each search is recorded in the "sparse_index_vector.insert_scan" counter,
+  and the number of following items moved by each insert() in "sparse_index_vector.insert_moved".
+
+  Since each insert() may need to move all of the following items, building a large sparse_index_vector with insert() takes
+  O(n^2) time.  To build it (e.g. at startup) from a set of (index, value) pairs in any order, use the constructor or assign_unsorted()
+  instead, which sorts all of the items once. To add a batch of new items already sorted by index, use insert_bulk(), which merges
+  them with the existing items in one pass.
+
+  erase() does not move any items: it only marks the item as erased (a "tombstone"), which is then skipped by iterators. compact() removes
+  all erased items in one pass, restoring the contiguous layout of the values and indices vectors. This is done automatically by insert()
+  when at least 1/compact_fraction of the stored items have been erased, and by insert_bulk() and assign_unsorted(), so a burst of
+  removals costs one linear pass rather than one per removal.  Iterators remain valid after erase(), but not after compact() or any insertion.
+
+  For use in place of a std::map or std::multimap, pairs() returns a view whose iterators yield std::pair<const size_t&, T&> (references
+  to the index and value; no copies are made), e.g. <tt>for(auto [index, value] : v.pairs())</tt>, and equal_range() finds all items with
+  a given index with a binary search.
 */
 
 
@@ -20,8 +110,6 @@ template<typename T>
 class sparse_index_vector {
 public:
   using ValueVecT = std::vector<T>;
-  using iterator = typename ValueVecT::iterator;
-  using const_iterator = typename ValueVecT::const_iterator;
   using size_type = typename ValueVecT::size_type;
   using IndexT = size_t;
   using IndexVecT = std::vector<IndexT>;
@@ -29,38 +117,292 @@ public:
 private:
   ValueVecT values;
   IndexVecT indices;
+  std::vector<unsigned char> erased; // tombstone flag for each item in values and indices (same size)
+  size_type tombstones = 0; // number of items in erased that are set
+
+  // Position of the first item at or after pos which has not been erased (or values.size())
+  size_type next_live(size_type pos) const noexcept
+  {
+    if(tombstones == 0) [[likely]]
+      return pos;
+    while(pos < erased.size() && erased[pos])
+      ++pos;
+    return pos;
+  }
+
+  // Positions of the first item not less than index, and the first item greater than index, skipping forward past erased items.
+  std::pair<size_type, size_type> equal_range_positions(IndexT index) const noexcept
+  {
+    const auto [lo, hi] = std::equal_range(indices.begin(), indices.end(), index);
+    return { next_live(static_cast<size_type>(lo - indices.begin())), next_live(static_cast<size_type>(hi - indices.begin())) };
+  }
+
+  // Iterator over values, which skips erased items.
+  template<bool Const>
+  class basic_iterator {
+    friend class sparse_index_vector<T>;
+    template<bool> friend class basic_iterator;
+    using owner_ptr = std::conditional_t<Const, const sparse_index_vector<T>*, sparse_index_vector<T>*>;
+    owner_ptr owner = nullptr;
+    size_type pos = 0;
+    basic_iterator(owner_ptr o, size_type p) noexcept : owner(o), pos(p) {}
+  public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<Const, const T*, T*>;
+    using reference = std::conditional_t<Const, const T&, T&>;
+
+    basic_iterator() noexcept = default;
+    basic_iterator(const basic_iterator&) noexcept = default;
+    basic_iterator& operator=(const basic_iterator&) noexcept = default;
+    basic_iterator(const basic_iterator<false>& other) noexcept requires Const : owner(other.owner), pos(other.pos) {}
+
+    reference operator*() const { return owner->values[pos]; }
+    pointer operator->() const { return &owner->values[pos]; }
+
+    /** Index of the current item */
+    const IndexT& index() const { return owner->indices[pos]; }
+
+    basic_iterator& operator++() { pos = owner->next_live(pos + 1); return *this; }
+    basic_iterator operator++(int) { auto prev = *this; ++*this; return prev; }
+    basic_iterator& operator--() { do { --pos; } while(owner->tombstones > 0 && owner->erased[pos]); return *this; }
+    basic_iterator operator--(int) { auto prev = *this; --*this; return prev; }
+
+    friend bool operator==(const basic_iterator& a, const basic_iterator& b) noexcept { return a.pos == b.pos; }
+  };
+
+  // Iterator which yields pairs of references to index and value, for pairs().
+  template<bool Const>
+  class basic_pair_iterator {
+    basic_iterator<Const> it;
+  public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using iterator_concept = std::bidirectional_iterator_tag;
+    using value_type = std::pair<IndexT, T>;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::pair<const IndexT&, typename basic_iterator<Const>::reference>;
+
+    basic_pair_iterator() noexcept = default;
+    explicit basic_pair_iterator(basic_iterator<Const> i) noexcept : it(i) {}
+
+    reference operator*() const { return reference(it.index(), *it); }
+
+    /** The underlying iterator over values */
+    basic_iterator<Const> base() const noexcept { return it; }
+
+    basic_pair_iterator& operator++() { ++it; return *this; }
+    basic_pair_iterator operator++(int) { auto prev = *this; ++it; return prev; }
+    basic_pair_iterator& operator--() { --it; return *this; }
+    basic_pair_iterator operator--(int) { auto prev = *this; --it; return prev; }
+
+    friend bool operator==(const basic_pair_iterator& a, const basic_pair_iterator& b) noexcept { return a.it == b.it; }
+  };
+
+  template<bool Const>
+  class basic_pair_view {
+    using owner_ptr = std::conditional_t<Const, const sparse_index_vector<T>*, sparse_index_vector<T>*>;
+    owner_ptr owner;
+  public:
+    explicit basic_pair_view(owner_ptr o) noexcept : owner(o) {}
+    basic_pair_iterator<Const> begin() const noexcept { return basic_pair_iterator<Const>(owner->begin()); }
+    basic_pair_iterator<Const> end() const noexcept { return basic_pair_iterator<Const>(owner->end()); }
+    size_type size() const noexcept { return owner->size(); }
+    bool empty() const noexcept { return owner->empty(); }
+  };
 
 public:
-  iterator begin() noexcept { return values.begin(); }
-  iterator begin() const noexcept { return values.begin(); }
-  const_iterator cbegin() const noexcept { return values.cbegin(); }
-  iterator end() noexcept { return values.end(); }
-  iterator end() const noexcept { return values.end(); }
-  const_iterator cend() const noexcept { return values.cend(); }
+  using iterator = basic_iterator<false>;
+  using const_iterator = basic_iterator<true>;
+  using pair_iterator = basic_pair_iterator<false>;
+  using const_pair_iterator = basic_pair_iterator<true>;
+  using pair_view = basic_pair_view<false>;
+  using const_pair_view = basic_pair_view<true>;
+
+  /// insert() uses a linear search if there are no more than this many items.
+  static constexpr size_type linear_search_max_size = 8;
+
+  /// insert() uses a (branchless, possibly vectorized) compare-and-count search if there are no more than this many items, and a binary search if there are more.
+  /// (Measured with bench_sparse_index_vector on x86_64: binary search becomes faster at around 32-64 items with AVX2, or 16 items without.)
+#if defined(__AVX2__) || (defined(__ARM_NEON) && defined(__aarch64__))
+  static constexpr size_type count_search_max_size = 48;
+#else
+  static constexpr size_type count_search_max_size = 16;
+#endif
+
+  /// insert() calls compact() first if at least 1/compact_fraction of the stored items have been erased.
+  static constexpr size_type compact_fraction = 4;
+
+  sparse_index_vector() = default;
+
+  /** Initialize with items from a range of (index, value) pairs in any order (e.g. std::pair<size_t, T>).  See assign_unsorted().
+      (Not used for another sparse_index_vector, which is also a range, but of values; that is copied or moved as usual.) */
+  template<std::ranges::input_range R>
+    requires (!std::same_as<std::remove_cvref_t<R>, sparse_index_vector>)
+  explicit sparse_index_vector(R&& pairs)
+  {
+    assign_unsorted(std::forward<R>(pairs));
+  }
+
+  /** Initialize with (index, value) pairs in any order.  See assign_unsorted(). */
+  sparse_index_vector(std::initializer_list<std::pair<IndexT, T>> pairs)
+  {
+    assign_unsorted(pairs);
+  }
+
+  iterator begin() noexcept { return iterator(this, next_live(0)); }
+  const_iterator begin() const noexcept { return const_iterator(this, next_live(0)); }
+  const_iterator cbegin() const noexcept { return begin(); }
+  iterator end() noexcept { return iterator(this, values.size()); }
+  const_iterator end() const noexcept { return const_iterator(this, values.size()); }
+  const_iterator cend() const noexcept { return end(); }
+
+  /** Return a view of all items as pairs of references to index and value (std::pair<const size_t&, T&>), in order. The view is only valid as long as the iterators would be. */
+  pair_view pairs() noexcept { return pair_view(this); }
+  const_pair_view pairs() const noexcept { return const_pair_view(this); }
+
+  /** Return iterators for the first item with @a index and one past the last item with @a index (both equal if there are none), found with a binary search. */
+  std::pair<iterator, iterator> equal_range(IndexT index) noexcept
+  {
+    const auto [first, last] = equal_range_positions(index);
+    return { iterator(this, first), iterator(this, last) };
+  }
+
+  std::pair<const_iterator, const_iterator> equal_range(IndexT index) const noexcept
+  {
+    const auto [first, last] = equal_range_positions(index);
+    return { const_iterator(this, first), const_iterator(this, last) };
+  }
+
+  /** Number of items (not including erased items) */
+  size_type size() const noexcept { return values.size() - tombstones; }
+
+  bool empty() const noexcept { return size() == 0; }
 
-  size_type size() const noexcept { return values.size(); }
+  /** Number of erased items that will be removed by the next compact(). */
+  size_type erased_count() const noexcept { return tombstones; }
 
   void clear() noexcept
   {
     values.clear();
     indices.clear();
+    erased.clear();
+    tombstones = 0;
   }
 
-  iterator insert(size_t index, const T& value)
+  /** Reserve space for at least @a n items in both the values and indices vectors. */
+  void reserve(size_type n)
+  {
+    values.reserve(n);
+    indices.reserve(n);
+    erased.reserve(n);
+  }
+
+  /** Replace all items with items from a range of (index, value) pairs (e.g. std::pair<size_t, T>, or anything else that can be
+      unpacked with a structured binding) in any order.  The items are copied, then sorted once, so this takes O(n log n) time rather
+      than the O(n^2) of calling insert() for each item.  The result is the same as calling insert() for each pair in order: items
+      with the same index are in the reverse of their order in @a pairs.
+   */
+  template<std::ranges::input_range R>
+  void assign_unsorted(R&& pairs)
   {
-    // todo we could do a more efficient search, maybe worth doing for larger lists
-    auto i = indices.begin();
-    while(i != indices.end())
+    std::vector<std::pair<IndexT, T>> tmp;
+    if constexpr(std::ranges::sized_range<R>)
+      tmp.reserve(std::ranges::size(pairs));
+    for(auto&& p : pairs)
     {
-      if(*i >= index) break;
-      ++i;
+      const auto& [index, value] = p;
+      tmp.emplace_back(index, value);
+    }
+    // Sorting the reversed sequence with a stable sort keeps items with equal indices in reverse order.
+    std::stable_sort(tmp.rbegin(), tmp.rend(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    clear();
+    reserve(tmp.size());
+    for(auto& [index, value] : std::ranges::reverse_view(tmp))
+    {
+      indices.push_back(index);
+      values.push_back(std::move(value));
+    }
+    erased.assign(values.size(), 0);
+  }
+
+  /** Insert a batch of (index, value) pairs, which must already be sorted by index, merging them with the existing items in one pass (O(n + m) time).
+      As with insert(), each new item goes before any existing items with the same index; new items with the same index as each other keep their order from @a pairs.
+      Erased items are also removed (see compact()).
+   */
+  template<std::ranges::input_range R>
+  void insert_bulk(R&& pairs)
+  {
+    ValueVecT new_values;
+    IndexVecT new_indices;
+    if constexpr(std::ranges::sized_range<R>)
+    {
+      new_values.reserve(size() + std::ranges::size(pairs));
+      new_indices.reserve(size() + std::ranges::size(pairs));
+    }
+    auto take_existing = [&](size_type i) {
+      if(erased[i]) return;
+      new_indices.push_back(indices[i]);
+      new_values.push_back(std::move(values[i]));
+    };
+    // Values are moved if the range gives rvalues (e.g. pairs returned by views::transform), otherwise copied.
+    constexpr bool move_values = !std::is_lvalue_reference_v<std::ranges::range_reference_t<R>>;
+    size_type i = 0;
+    [[maybe_unused]] IndexT prev_index = 0;
+    [[maybe_unused]] bool first = true;
+    for(auto&& p : pairs)
+    {
+      auto&& [index, value] = p;
+      assert(first || index >= prev_index); // pairs must be sorted by index
+      prev_index = index;
+      first = false;
+      for(; i < indices.size() && indices[i] < index; ++i)
+        take_existing(i);
+      new_indices.push_back(index);
+      if constexpr(move_values)
+        new_values.push_back(std::move(value));
+      else
+        new_values.push_back(value);
+    }
+    for(; i < indices.size(); ++i)
+      take_existing(i);
+    values.swap(new_values);
+    indices.swap(new_indices);
+    erased.assign(values.size(), 0);
+    tombstones = 0;
+  }
+
+  /** Return the position in the underlying vectors (including any erased items not yet removed by compact()) at which a new item with @a index would be inserted:
+      before the first item whose index is greater than or equal to @a index. */
+  size_type find_insert_position(IndexT index) const noexcept
+  {
+    const size_type n = indices.size();
+    if(n <= linear_search_max_size)
+    {
+      const size_type pos = _private::index_lower_bound_linear(indices.data(), n, index);
+      rhm_instrument_record("sparse_index_vector.insert_scan", std::min(pos + 1, n));
+      return pos;
+    }
+    if(n <= count_search_max_size)
+    {
+      rhm_instrument_record("sparse_index_vector.insert_scan", n);
+      return _private::index_lower_bound_count(indices.data(), n, index);
     }
-    
-    auto dist = std::distance(indices.begin(), i);
-    auto d = values.begin();
-    std::advance(d, dist);
-    indices.insert(i, index);
-    return values.insert(d, value);
+    rhm_instrument_record("sparse_index_vector.insert_scan", std::bit_width(n));
+    return _private::index_lower_bound_binary(indices.data(), n, index);
+  }
+
+  iterator insert(size_t index, const T& value)
+  {
+    if(tombstones > 0 && tombstones * compact_fraction >= values.size())
+      compact();
+    const auto pos = find_insert_position(index);
+    rhm_instrument_record("sparse_index_vector.insert_moved", indices.size() - pos);
+    const auto dist = static_cast<typename ValueVecT::difference_type>(pos);
+    indices.insert(indices.begin() + dist, index);
+    erased.insert(erased.begin() + dist, 0);
+    values.insert(values.begin() + dist, value);
+    return iterator(this, pos);
   }
 
   // todo:
@@ -68,35 +410,63 @@ public:
   // {
   // }
 
-  // todo:
+  /** Erase the item at @a it in O(1) time, by marking it as erased.  The value itself is not destroyed until compact() is called (explicitly, or by a later insertion).
+      Other iterators remain valid.  Return an iterator to the next item.
+   */
+  iterator erase(const_iterator it)
+  {
+    assert(it.owner == this && it.pos < values.size() && !erased[it.pos]);
+    erased[it.pos] = 1;
+    ++tombstones;
+    return iterator(this, next_live(it.pos + 1));
+  }
+
+  /** Erase the first item equal to @a value, if any. (Linear search, then same as erase(const_iterator)) */
   void erase(const T& value)
   {
-    auto f = find(values.begin(), values.end(), value);
-    if(f == values.end()) return;
-    auto dist = std::distance(values.begin(), f);
-    values.erase(f);
-    auto e = indices.begin();
-    std::advance(e, dist);
-    indices.erase(e);
+    auto f = std::find(cbegin(), cend(), value);
+    if(f == cend()) return;
+    erase(f);
   }
 
+  /** Erase the item pointed to by @a value, which must be a pointer to an item in this sparse_index_vector (e.g. &*it).  Return an iterator to the next item. */
   iterator erase(const T* const value)
   {
-    return erase(*value);
+    assert(value >= values.data() && value < values.data() + values.size());
+    return erase(const_iterator(this, static_cast<size_type>(value - values.data())));
   }
 
-  template<typename T_> friend std::ostream& operator<<(std::ostream& os, const sparse_index_vector<T_>& v);
+  /** Remove all erased items, in one pass moving the remaining items down to fill the gaps.  Invalidates all iterators. */
+  void compact()
+  {
+    if(tombstones == 0) return;
+    size_type w = 0;
+    for(size_type r = 0; r < values.size(); ++r)
+    {
+      if(erased[r]) continue;
+      if(w != r)
+      {
+        values[w] = std::move(values[r]);
+        indices[w] = indices[r];
+      }
+      ++w;
+    }
+    const auto n = static_cast<typename ValueVecT::difference_type>(w);
+    values.erase(values.begin() + n, values.end());
+    indices.erase(indices.begin() + n, indices.end());
+    erased.assign(w, 0);
+    tombstones = 0;
+  }
 };
 
 template<typename T>
 std::ostream& operator<<(std::ostream& s, const sparse_index_vector<T>& v)
 {
-  for(auto value_i = v.values.cbegin(), index_i = v.indices.cbegin(); 
-      value_i != v.values.end(); ++value_i, ++index_i)
+  for(auto i = v.begin(); i != v.end(); ++i)
   {
-    if(value_i != v.values.begin())
-      s << ", "; 
-    s << "(" << *index_i << ": " << *value_i <<")";
+    if(i != v.begin())
+      s << ", ";
+    s << "(" << i.index() << ": " << *i <<")";
   }
   return s;
 }
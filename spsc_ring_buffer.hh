@@ -0,0 +1,189 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+#include "ring_buffer.hh"
+
+namespace rhm {
+
+/** @brief Lock-free FIFO ring buffer for use by exactly one producer thread and one consumer thread.
+
+    This is a variant of ring_buffer which can be used to pass items from one thread (the
+    producer, which calls try_push() or try_emplace()) to one other thread (the consumer, which
+    calls front(), pop_front() or try_pop()) without a mutex. All of these operations are wait-free.
+    (Based on the design described at <https://rigtorp.se/ringbuffer/>.)
+
+    Unlike ring_buffer, items are never replaced when the buffer is full; instead try_push() returns
+    false, and the producer can decide what to do (drop the item, or try again later).
+
+    Specify a standard container type with random access iterators as ContainerT, normally
+    std::array<T, Capacity>.  All of the container's memory must be allocated before use; if
+    ContainerT has a resize() method (e.g. std::vector), then it is resized to Capacity by the
+    constructor.  All Capacity slots are usable.
+
+    The producer and consumer positions are stored as atomic counters on separate cache lines,
+    and each thread also keeps a (non-atomic) cached copy of the other thread's counter on its own
+    cache line.  The other thread's atomic counter only needs to be re-read when the cached copy
+    indicates that the buffer is full (producer) or empty (consumer), so in the common case push
+    and pop do not touch any cache lines written by the other thread.
+
+    @note Only one thread may call the producer methods, and only one (other) thread may call the
+    consumer methods.  size(), empty() and full() may be called from any thread but the result is
+    only a snapshot that may already be out of date.
+
+    @note As with ring_buffer, items are not destroyed when popped; they are replaced (by
+    assignment) when the slot is reused.
+
+    @note Requires C++20 mode when compiling.
+ */
+template<size_t Capacity, StdContainerType ContainerT>
+class spsc_ring_buffer
+{
+  using ItemT = typename ContainerT::value_type;
+  static_assert(Capacity > 0, "spsc_ring_buffer: Capacity must be greater than 0");
+  static_assert(std::random_access_iterator<typename ContainerT::iterator>, "spsc_ring_buffer: ContainerT must provide random access iterators");
+
+public:
+
+  spsc_ring_buffer()
+  {
+    constexpr bool has_resize = requires(ContainerT c) { c.resize(Capacity); };
+    if constexpr(has_resize)
+    {
+      if(container.size() < Capacity)
+        container.resize(Capacity);
+    }
+    assert(container.size() >= Capacity);
+  }
+
+  // Not copyable or movable, since other threads may be using it.
+  spsc_ring_buffer(const spsc_ring_buffer<Capacity, ContainerT>&) = delete;
+  spsc_ring_buffer<Capacity, ContainerT>& operator=(const spsc_ring_buffer<Capacity, ContainerT>&) = delete;
+
+
+  /// @name Producer thread
+  /// @{
+
+  /** Push a copy of @a item, if the buffer is not full.  Return true if pushed, false if the buffer was full. */
+  bool try_push(const ItemT& item)
+  {
+    return try_emplace(item);
+  }
+
+  /** Push @a item, moving it into the buffer, if the buffer is not full.  Return true if pushed, false if the buffer was full (@a item is not moved from). */
+  bool try_push(ItemT&& item)
+  {
+    return try_emplace(std::move(item));
+  }
+
+  /** Assign a new item from @a args into the next slot, if the buffer is not full.  Return true if pushed, false if the buffer was full.
+      If a single argument is given and ItemT can be assigned from it, it is assigned directly (which may reuse memory already owned by the old item in that slot),
+      otherwise a new ItemT is constructed from @a args and move assigned into the slot.
+   */
+  template<typename... Args>
+  bool try_emplace(Args&&... args)
+  {
+    const size_t w = write_pos.load(std::memory_order_relaxed);
+    if(w - cached_read_pos == Capacity)
+    {
+      cached_read_pos = read_pos.load(std::memory_order_acquire);
+      if(w - cached_read_pos == Capacity)
+        return false;
+    }
+    _private::assign_item(*slot(w), std::forward<Args>(args)...);
+    write_pos.store(w + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// @}
+
+
+  /// @name Consumer thread
+  /// @{
+
+  /** Get an iterator for the front item, or nil() if the buffer is empty.  The item may be read (or moved from) in place, then call pop_front() to release it. */
+  typename ContainerT::iterator front()
+  {
+    const size_t r = read_pos.load(std::memory_order_relaxed);
+    if(r == cached_write_pos)
+    {
+      cached_write_pos = write_pos.load(std::memory_order_acquire);
+      if(r == cached_write_pos)
+        return nil();
+    }
+    return slot(r);
+  }
+
+  /** Release the front item so its slot can be reused by the producer.  The buffer must not be empty (check that front() did not return nil()). */
+  void pop_front()
+  {
+    const size_t r = read_pos.load(std::memory_order_relaxed);
+    assert(r != write_pos.load(std::memory_order_acquire));
+    read_pos.store(r + 1, std::memory_order_release);
+  }
+
+  /** Same as pop_front() */
+  void advance_front() { pop_front(); }
+
+  /** Move the front item into @a item and remove it from the buffer.  Return true if an item was popped, false if the buffer was empty. */
+  bool try_pop(ItemT& item)
+  {
+    auto f = front();
+    if(f == nil())
+      return false;
+    item = std::move(*f);
+    pop_front();
+    return true;
+  }
+
+  /// @}
+
+
+  /** Get the number of items currently in the buffer. (May be called from any thread, but may be out of date by the time it returns.) */
+  size_t size() const
+  {
+    const size_t r = read_pos.load(std::memory_order_acquire);
+    const size_t w = write_pos.load(std::memory_order_acquire);
+    return w - r;
+  }
+
+  /** Return true if the buffer is empty. (May be out of date by the time it returns.) */
+  bool empty() const { return size() == 0; }
+
+  /** Return true if the buffer is full. (May be out of date by the time it returns.) */
+  bool full() const { return size() >= Capacity; }
+
+  /** Get the maximum capacity of the buffer (same as Capacity parameter). */
+  constexpr size_t capacity() const { return Capacity; }
+
+  /** Return an iterator representing an invalid item. Compare to the return value of front(). */
+  typename ContainerT::iterator nil() { return container.end(); }
+
+public:
+  ContainerT container;
+
+private:
+  // Counters increase monotonically and are mapped to a slot with modulo Capacity (a mask if Capacity is a power of two).
+  // (A 64-bit size_t won't overflow in practice.)
+  typename ContainerT::iterator slot(size_t pos)
+  {
+    return container.begin() + static_cast<typename ContainerT::difference_type>(pos % Capacity);
+  }
+
+  // Written by producer:
+  alignas(_private::cache_line_size) std::atomic<size_t> write_pos{0};
+  size_t cached_read_pos = 0;
+
+  // Written by consumer:
+  alignas(_private::cache_line_size) std::atomic<size_t> read_pos{0};
+  size_t cached_write_pos = 0;
+
+  // Keep the consumer's data off of the cache line of whatever follows this object in memory.
+  [[maybe_unused]] char padding[_private::cache_line_size - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+};
+
+} // end namespace rhm
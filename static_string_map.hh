@@ -0,0 +1,223 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+#include "append_to_string_literal.hh"
+
+namespace rhm {
+
+/** 64-bit FNV-1a hash of @a s (see <http://www.isthe.com/chongo/tech/comp/fnv/>). Can be computed at compile time. */
+constexpr uint64_t fnv1a(std::string_view s, uint64_t basis = 0xcbf29ce484222325ull) noexcept
+{
+  uint64_t h = basis;
+  for(char c : s)
+  {
+    h ^= (unsigned char)c;
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+/** Hash of the string literal S, computed at compile time, for use as an ID or in a switch statement, e.g.
+    @code
+      switch(fnv1a(name)) {
+        case string_id<"start">: ...
+        case string_id<"stop">: ...
+      }
+    @endcode
+    (Unlike rhm::static_string_map, different strings are not guaranteed to have different IDs, though they
+    almost certainly will; compare the string as well if this matters.)
+ */
+template<string_literal S>
+inline constexpr uint64_t string_id = fnv1a(S);
+
+
+namespace _private {
+
+// Hash used for static_string_map tables, which reads 8 bytes at a time (the shifts below compile to a single load).
+constexpr uint64_t word_hash(std::string_view s) noexcept
+{
+  constexpr uint64_t k = 0x9e3779b97f4a7c15ull;
+  uint64_t h = s.size() * k;
+  size_t i = 0;
+  auto mix = [&](uint64_t w) {
+    h = (h ^ w) * k;
+    h ^= h >> 32;
+  };
+  for(; i + 8 <= s.size(); i += 8)
+  {
+    uint64_t w = 0;
+    for(size_t b = 0; b < 8; ++b)
+      w |= (uint64_t)(unsigned char)s[i + b] << (8 * b);
+    mix(w);
+  }
+  if(i < s.size())
+  {
+    uint64_t w = 0;
+    for(size_t b = 0; i + b < s.size(); ++b)
+      w |= (uint64_t)(unsigned char)s[i + b] << (8 * b);
+    mix(w);
+  }
+  return h;
+}
+
+// Perfect hash tables for static_string_map, using the "hash and displace" method: Each key is assigned to a
+// bucket by the upper bits of its hash, then for each bucket (largest first), a displacement value is
+// searched for which, combined with the hash, puts every key in the bucket into a free slot.
+template<size_t N>
+struct perfect_hash_tables
+{
+  static constexpr size_t bucket_count = N > 0 ? N : 1;
+  static constexpr size_t slot_bits = std::bit_width(N + N / 4 + (N == 0)); // (table at most 80% full)
+  static constexpr size_t slot_count = size_t(1) << slot_bits;
+  static constexpr uint32_t empty = UINT32_MAX;
+  static constexpr uint32_t max_displacement = 1u << 20;
+
+  std::array<uint32_t, bucket_count> displacement{};
+  std::array<uint32_t, slot_count> slot_key{}; // (index of key, or empty)
+  bool ok = false;
+
+  static constexpr size_t bucket_of(uint64_t h) noexcept { return (size_t)((h >> 32) % bucket_count); }
+
+  static constexpr size_t slot_of(uint64_t h, uint32_t d) noexcept
+  {
+    return (size_t)(((h ^ d) * 0x9e3779b97f4a7c15ull) >> (64 - slot_bits));
+  }
+
+  consteval perfect_hash_tables(const std::array<std::string_view, N>& keys)
+  {
+    slot_key.fill(empty);
+    std::array<uint64_t, bucket_count> hashes{};
+    std::array<size_t, bucket_count + 1> bucket_start{}; // (keys in bucket b are members[bucket_start[b]] to members[bucket_start[b+1]-1])
+    for(size_t k = 0; k < N; ++k)
+    {
+      hashes[k] = word_hash(keys[k]);
+      ++bucket_start[bucket_of(hashes[k]) + 1];
+    }
+    for(size_t b = 0; b < bucket_count; ++b)
+      bucket_start[b + 1] += bucket_start[b];
+    std::array<size_t, bucket_count> members{};
+    std::array<size_t, bucket_count> filled{};
+    for(size_t k = 0; k < N; ++k)
+    {
+      const size_t b = bucket_of(hashes[k]);
+      members[bucket_start[b] + filled[b]++] = k;
+    }
+    auto bucket_size = [&](size_t b) { return bucket_start[b + 1] - bucket_start[b]; };
+    std::array<size_t, bucket_count> order{};
+    for(size_t b = 0; b < bucket_count; ++b)
+      order[b] = b;
+    for(size_t i = 1; i < bucket_count; ++i) // (insertion sort, largest bucket first)
+      for(size_t j = i; j > 0 && bucket_size(order[j]) > bucket_size(order[j - 1]); --j)
+        std::swap(order[j], order[j - 1]);
+    for(size_t b : order)
+    {
+      const size_t n = bucket_size(b);
+      if(n == 0)
+        break;
+      const size_t *bucket_keys = members.data() + bucket_start[b];
+      for(size_t i = 0; i < n; ++i)
+        for(size_t j = 0; j < i; ++j)
+          if(hashes[bucket_keys[i]] == hashes[bucket_keys[j]])
+            return; // duplicate key (or different keys with the same 64-bit hash, which can't be separated)
+      uint32_t d = 0;
+      for(; d < max_displacement; ++d)
+      {
+        bool fits = true;
+        for(size_t i = 0; i < n && fits; ++i)
+        {
+          const size_t s = slot_of(hashes[bucket_keys[i]], d);
+          fits = (slot_key[s] == empty);
+          for(size_t j = 0; j < i && fits; ++j)
+            fits = (slot_of(hashes[bucket_keys[j]], d) != s);
+        }
+        if(fits)
+          break;
+      }
+      if(d == max_displacement)
+        return;
+      displacement[b] = d;
+      for(size_t i = 0; i < n; ++i)
+        slot_key[slot_of(hashes[bucket_keys[i]], d)] = (uint32_t)bucket_keys[i];
+    }
+    ok = true;
+  }
+
+  constexpr size_t find(const std::array<std::string_view, N>& keys, std::string_view s) const noexcept
+  {
+    const uint64_t h = word_hash(s);
+    const uint32_t k = slot_key[slot_of(h, displacement[bucket_of(h)])];
+    if(k == empty || keys[k] != s)
+      return (size_t)-1;
+    return k;
+  }
+};
+
+consteval size_t checked_key_index(size_t i)
+{
+  if(i == (size_t)-1)
+    throw "static_string_map::index_of: not one of the keys"; // (error at compile time)
+  return i;
+}
+
+} // end namespace _private
+
+
+/** @brief Fixed set of strings, given as template parameters, with a perfect hash table generated at compile time.
+
+    find() returns the index of a string in the Keys parameters, or npos if it is not one of the keys. It
+    computes one hash of the string (reading 8 bytes at a time), then reads one slot of the table, and compares the string
+    with the only key that could match it, so there are no collisions to resolve and no memory allocation.
+    This can replace a std::unordered_map<std::string, T> with fixed keys: store the values in an array
+    indexed by find().  index_of<Key> gives the index of a key at compile time, for example to use in a
+    switch statement:
+    @code
+      using commands = rhm::static_string_map<"start", "stop", "status">;
+      switch(commands::find(cmd)) {
+        case commands::index_of<"start">: ...
+        case commands::index_of<"stop">: ...
+        case commands::npos: ...
+      }
+    @endcode
+    Keys must be unique (checked at compile time).
+
+    @note Requires C++20 mode when compiling.
+ */
+template<string_literal... Keys>
+class static_string_map
+{
+public:
+  static constexpr size_t npos = (size_t)-1;
+
+  static constexpr std::array<std::string_view, sizeof...(Keys)> keys = {std::string_view(Keys)...};
+
+  /** Number of keys. */
+  static constexpr size_t size() noexcept { return sizeof...(Keys); }
+
+  /** Index of @a s in Keys, or npos if @a s is not one of Keys. */
+  static constexpr size_t find(std::string_view s) noexcept
+  {
+    if constexpr(sizeof...(Keys) == 0)
+      return npos;
+    else
+      return tables.find(keys, s);
+  }
+
+  /** Return true if @a s is one of Keys. */
+  static constexpr bool contains(std::string_view s) noexcept { return find(s) != npos; }
+
+  /** Index of Key in Keys (at compile time). Key must be one of Keys. */
+  template<string_literal Key>
+  static constexpr size_t index_of = _private::checked_key_index(find(Key));
+
+private:
+  static constexpr _private::perfect_hash_tables<sizeof...(Keys)> tables{keys};
+  static_assert(sizeof...(Keys) == 0 || tables.ok, "static_string_map: duplicate keys (or no perfect hash found)");
+};
+
+} // end namespace rhm
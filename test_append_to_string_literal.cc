@@ -0,0 +1,90 @@
+#include "append_to_string_literal.hh"
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "fmt/format.h"
+
+// string_literal length does not include the null terminator.
+template<rhm::string_literal s>
+constexpr size_t literal_length() { return s.length(); }
+
+void test_string_literal()
+{
+  static_assert(literal_length<"hello">() == 5);
+  static_assert(literal_length<"">() == 0);
+  constexpr rhm::string_literal lit("abc");
+  static_assert(std::string_view(lit) == "abc");
+  assert(rhm::append_to_string_literal<"x">(1) == "x1");
+  assert(rhm::append_to_string_literal<"a longer prefix for the value ">(-42L) == "a longer prefix for the value -42");
+  assert(rhm::append_to_string_literal<"c">('A') == "c65");
+  assert(rhm::append_to_string_literal<"f">(1.5) == "f" + std::to_string(1.5));
+  puts("string_literal ok");
+}
+
+// Maximum sizes are exact for the limits of each type.
+template<typename T>
+void check_limits()
+{
+  constexpr size_t max = rhm::concat_max_size<"", "", T>;
+  assert(rhm::concat<"">(std::numeric_limits<T>::min()).size() <= max);
+  assert(rhm::concat<"">(std::numeric_limits<T>::max()).size() <= max);
+  assert(rhm::concat<"">(std::numeric_limits<T>::min()).size() == max || rhm::concat<"">(std::numeric_limits<T>::max()).size() == max);
+  assert((rhm::concat<"">(std::numeric_limits<T>::min()) == fmt::format("{}", std::numeric_limits<T>::min())));
+}
+
+void test_concat()
+{
+  check_limits<int8_t>();
+  check_limits<uint8_t>();
+  check_limits<int16_t>();
+  check_limits<int>();
+  check_limits<unsigned>();
+  check_limits<long long>();
+  check_limits<unsigned long long>();
+  assert((rhm::concat<"">(-2.2250738585072014e-308).size() == rhm::concat_max_size<"", "", double>));
+  assert((rhm::concat<"">(-1.17549435e-38f).size() <= rhm::concat_max_size<"", "", float>));
+
+  static_assert(rhm::concat_max_size<"sensor_", "", uint32_t> == 7 + 10);
+  static_assert(rhm::concat_max_size<"k", "/", int, char, int> == 1 + 2 + 11 + 1 + 11);
+  assert(rhm::concat<"sensor_">(42u) == "sensor_42");
+  assert((rhm::concat<"k:", "/">(1, 'x', -3, 0.25) == "k:1/x/-3/0.25"));
+  assert(rhm::concat<"">() == "");
+  assert(rhm::concat<"only">() == "only");
+  const std::string name = "temperature";
+  assert((rhm::concat<"", ".">(name, 3, "max", std::string_view("c")) == "temperature.3.max.c"));
+  assert((rhm::concat_size<"", ".">(name, 3) == 11 + 1 + 11));
+  puts("concat ok");
+}
+
+// concat_to() writes into a caller's buffer, or appends to fmt::memory_buffer or std::string.
+void test_concat_to()
+{
+  char buf[rhm::concat_max_size<"id_", "-", int, int>];
+  const char *end = rhm::concat_to<"id_", "-">(buf, 7, -8);
+  assert(std::string_view(buf, (size_t)(end - buf)) == "id_7--8");
+
+  fmt::memory_buffer mb;
+  for(int i = 0; i < 3; ++i)
+    rhm::concat_to<"sensor_", ",">(mb, i, "ok");
+  assert(fmt::to_string(mb) == "sensor_0,oksensor_1,oksensor_2,ok");
+
+  std::string s = "existing ";
+  rhm::concat_to<"n=">(s, 123456789012LL);
+  assert(s == "existing n=123456789012");
+  std::vector<char> v;
+  rhm::concat_to<"">(v, 'z');
+  assert(v.size() == 1 && v[0] == 'z');
+  puts("concat_to ok");
+}
+
+int main()
+{
+  test_string_literal();
+  test_concat();
+  test_concat_to();
+  return 0;
+}
@@ -1,12 +1,201 @@
 
 
 #include "assert.h"
+#include "async_assert_log.hh"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static int evaluations = 0;
+
+static bool counted_check()
+{
+  ++evaluations;
+  return true;
+}
+
+// Check how many times conditions are evaluated at the RHM_ASSERT_LEVEL this was compiled with.
+void test_levels()
+{
+  evaluations = 0;
+  for(int i = 0; i < 100; ++i)
+    rhm_assert_sampled(counted_check(), 10);
+  const int sampled = evaluations;
+
+  evaluations = 0;
+  rhm_assert_full(counted_check());
+  const int full = evaluations;
+
+  evaluations = 0;
+  rhm_assert(counted_check());
+  const int cheap = evaluations;
+
+  fmt::print("RHM_ASSERT_LEVEL {}: rhm_assert_sampled(..., 10) evaluated {} times in 100, rhm_assert_full {}, rhm_assert {}\n", RHM_ASSERT_LEVEL, sampled, full, cheap);
+#if RHM_ASSERT_LEVEL == RHM_ASSERT_LEVEL_FULL
+  if(sampled != 100 || full != 1 || cheap != 1) abort();
+#elif RHM_ASSERT_LEVEL == RHM_ASSERT_LEVEL_CHEAP
+  if(sampled != 10 || full != 0 || cheap != 1) abort();
+#else
+  if(sampled != 0 || full != 0 || cheap != 0) abort();
+#endif
+}
+
+static std::atomic<int> handled{0};
+
+static rhm::assertion_action counting_handler(const rhm::assertion_failure& f)
+{
+  if(strcmp(f.expression, "x < 0") != 0 || f.assert_type != rhm::precondition || f.message.empty()) abort();
+  ++handled;
+  return rhm::assertion_action::continue_execution;
+}
+
+// A custom handler can continue after the failure instead of throwing.
+void test_handler()
+{
+  const rhm::assertion_handler prev = rhm::set_assertion_handler(&counting_handler);
+  const int x = 1;
+  rhm_assert_precond(x < 0);
+  rhm_assert_precond(x < 0);
+  if(handled != 2) abort();
+  rhm::set_assertion_handler(prev);
+  if(rhm::get_assertion_handler() != &rhm::stderr_assertion_handler) abort();
+  puts("custom handler ok");
+}
+
+// Soft assertions from several threads go through the async log to a file.  With full_queue_action::write_directly,
+// every message is written (by the writer thread, or by the failing thread if the queue was full).  With
+// full_queue_action::drop, messages may be dropped, but then the number dropped is written at the end.
+void test_async_log(rhm::full_queue_action when_full)
+{
+  FILE *fp = tmpfile();
+  if(!fp) abort();
+  constexpr int NThreads = 4;
+  constexpr int NPerThread = 50;
+  size_t dropped = 0;
+  size_t written_directly = 0;
+  {
+    rhm::async_assert_log<64> log(fp, rhm::assertion_action::continue_execution, when_full);
+    log.install();
+    std::vector<std::thread> threads;
+    for(int t = 0; t < NThreads; ++t)
+      threads.emplace_back([] {
+        for(int i = 0; i < NPerThread; ++i)
+          rhm_assert(i < 0);
+      });
+    for(auto& t : threads)
+      t.join();
+    dropped = log.dropped();
+    written_directly = log.written_directly();
+  } // waits for all messages to be written
+  if(rhm::get_assertion_handler() != &rhm::stderr_assertion_handler) abort();
+  rewind(fp);
+  size_t lines = 0;
+  size_t dropped_reported = 0;
+  char buf[1024];
+  while(fgets(buf, sizeof(buf), fp))
+  {
+    if(strstr(buf, "Assertion (i < 0) failed."))
+      ++lines;
+    else if(strstr(buf, "assertion messages dropped"))
+      sscanf(buf, "rhm::async_assert_log: %zu", &dropped_reported);
+  }
+  fclose(fp);
+  fmt::print("async log: {} messages written ({} directly), {} dropped\n", lines, written_directly, dropped);
+  if(lines == 0) abort();
+  if(lines + dropped != NThreads * NPerThread) abort();
+  if(dropped_reported != dropped) abort();
+  if(when_full == rhm::full_queue_action::write_directly && dropped != 0) abort();
+  if(when_full == rhm::full_queue_action::drop && written_directly != 0) abort();
+}
+
+// The log is destroyed while other threads are still failing assertions: each message is either written by the log, or
+// goes to the previous handler after it is uninstalled, and none are lost.
+static std::atomic<size_t> previous_handler_calls{0};
+
+static rhm::assertion_action continue_counting_handler(const rhm::assertion_failure&)
+{
+  previous_handler_calls.fetch_add(1);
+  return rhm::assertion_action::continue_execution;
+}
+
+void test_async_log_destroyed_while_in_use()
+{
+  FILE *fp = tmpfile();
+  if(!fp) abort();
+  const auto prev = rhm::set_assertion_handler(&continue_counting_handler);
+  std::atomic<bool> stop{false};
+  std::atomic<size_t> failures{0};
+  std::vector<std::thread> threads;
+  {
+    rhm::async_assert_log<16> log(fp, rhm::assertion_action::continue_execution);
+    log.install();
+    for(int t = 0; t < 4; ++t)
+      threads.emplace_back([&] {
+        while(!stop.load())
+        {
+          failures.fetch_add(1);
+          rhm_assert(stop.load());
+        }
+      });
+    while(failures.load() < 1000)
+      std::this_thread::yield();
+  } // (threads are still failing assertions)
+  while(previous_handler_calls.load() < 100)
+    std::this_thread::yield();
+  stop = true;
+  for(auto& t : threads)
+    t.join();
+  rhm::set_assertion_handler(prev);
+  rewind(fp);
+  size_t lines = 0;
+  char buf[1024];
+  while(fgets(buf, sizeof(buf), fp))
+    if(strstr(buf, "Assertion (stop.load()) failed."))
+      ++lines;
+  fclose(fp);
+  fmt::print("async log destroyed while in use: {} messages written, {} to previous handler\n", lines, previous_handler_calls.load());
+  // (the last failure of each thread may have seen stop, and not failed)
+  if(lines == 0 || lines + previous_handler_calls.load() > failures.load() || lines + previous_handler_calls.load() + 4 < failures.load()) abort();
+}
+
+// Only one async_assert_log can be installed, even with a different QueueCapacity. (Installing a second one is an assertion
+// failure, so try it in a child process.)
+void test_async_log_one_instance()
+{
+  const pid_t pid = fork();
+  if(pid < 0) abort();
+  if(pid == 0)
+  {
+    rhm::async_assert_log<64> first(stderr, rhm::assertion_action::continue_execution);
+    first.install();
+    rhm::async_assert_log<128> second(stderr, rhm::assertion_action::continue_execution);
+    second.install();
+    _exit(0);
+  }
+  int status = 0;
+  if(waitpid(pid, &status, 0) != pid) abort();
+  if(!WIFSIGNALED(status) || WTERMSIG(status) != SIGABRT) abort();
+  puts("async log one instance ok");
+}
 
 int main()
 {
   
   rhm_assert(true);
 
+  test_levels();
+  test_handler();
+  test_async_log(rhm::full_queue_action::write_directly);
+  test_async_log(rhm::full_queue_action::drop);
+  test_async_log_destroyed_while_in_use();
+  test_async_log_one_instance();
+
   //int i = 0;
   //rhm_assert_precond(i > 0);
 
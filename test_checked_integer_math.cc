@@ -0,0 +1,205 @@
+#include "checked_integer_math.hh"
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Each overflow policy, for signed and unsigned types and results of a different type than the arguments.
+void test_policies()
+{
+  constexpr int imax = std::numeric_limits<int>::max();
+  constexpr int imin = std::numeric_limits<int>::min();
+
+  static_assert(checked_add<int>(2, 3) == 5);
+  static_assert(checked_mul<long>(100000, 100000L) == 10000000000L);
+  static_assert(saturating_add<int>(imax, 1) == imax);
+  static_assert(saturating_add<int>(imin, -1) == imin);
+  static_assert(saturating_sub<int>(imin, 1) == imin);
+  static_assert(saturating_sub<int>(imax, -1) == imax);
+  static_assert(saturating_mul<int>(imax, -2) == imin);
+  static_assert(saturating_mul<int>(imin, imin) == imax);
+  static_assert(saturating_sub<unsigned>(2u, 3u) == 0u);
+  static_assert(saturating_add<unsigned>(~0u, 1u) == ~0u);
+  static_assert(saturating_add<int8_t>(100, 100) == 127);
+  static_assert(saturating_add<int8_t>(-300, 100) == -128);
+  static_assert(saturating_sub<uint8_t>(10, 300) == 0);
+  static_assert(saturating_add<uint8_t>(-1, 300) == 255);
+  static_assert(saturating_mul<int16_t>(-1000, 1000) == -32768);
+  static_assert(saturating_add<int>(3, 4) == 7);
+
+  static_assert(wrapping_add<int>(imax, 1) == imin);
+  static_assert(wrapping_sub<uint8_t>(0, 1) == 255);
+  static_assert(wrapping_mul<int8_t>(16, 16) == 0);
+
+  static_assert(try_add<int>(imax, 1) == std::nullopt);
+  static_assert(try_sub<unsigned>(1u, 2u) == std::nullopt);
+  static_assert(try_mul<int>(-3, 7) == -21);
+
+  static_assert(noexcept(checked_add<int>(1, 2)));
+  static_assert(noexcept(saturating_add<int>(1, 2)));
+  static_assert(!noexcept(checked_add<int, overflow_policy::throw_exception>(1, 2)));
+
+  bool threw = false;
+  try {
+    checked_mul<int, overflow_policy::throw_exception>(imax, 2);
+  } catch(const std::overflow_error& e) {
+    threw = true;
+    printf("expected error: %s\n", e.what());
+  }
+  assert(threw);
+  assert((checked_sub<int, overflow_policy::throw_exception>(5, 7) == -2));
+  puts("policies ok");
+}
+
+// Batch kernels give the same results and the same first overflowing index as checking one element at a time.
+template<typename T>
+void check_batch(std::mt19937_64& rng, size_t n, size_t bad)
+{
+  std::uniform_int_distribution<int64_t> small(-20, 20);
+  std::vector<T> a(n), b(n), out(n), expected(n);
+  for(size_t i = 0; i < n; ++i)
+  {
+    a[i] = (T)(std::is_signed_v<T> ? small(rng) : small(rng) + 20);
+    b[i] = (T)(std::is_signed_v<T> ? small(rng) : small(rng) % 5 + 5);
+  }
+  if(bad < n)
+  {
+    a[bad] = std::numeric_limits<T>::max() - 1;
+    b[bad] = std::is_signed_v<T> ? 3 : 2;
+  }
+  if(bad + 70 < n)
+  {
+    // (a later overflow in another block is not reported)
+    a[bad + 70] = std::numeric_limits<T>::min();
+    b[bad + 70] = std::numeric_limits<T>::max();
+  }
+
+  auto check = [&](auto batch, auto try_op, auto wrapping_op) {
+    std::optional<size_t> first;
+    for(size_t i = 0; i < n; ++i)
+      if(!try_op(a[i], b[i]) && !first)
+        first = i;
+    assert(batch(std::span<const T>(a), std::span<const T>(b), std::span<T>(out)) == first);
+    for(size_t i = 0; i < n; ++i)
+      assert(out[i] == wrapping_op(a[i], b[i]));
+
+    // in place, with out the same as a or b
+    std::vector<T> in_place = a;
+    assert(batch(std::span<const T>(in_place), std::span<const T>(b), std::span<T>(in_place)) == first);
+    assert(in_place == out);
+    in_place = b;
+    assert(batch(std::span<const T>(a), std::span<const T>(in_place), std::span<T>(in_place)) == first);
+    assert(in_place == out);
+  };
+  check([](auto x, auto y, auto o) { return checked_add<T>(x, y, o); }, [](T x, T y) { return try_add<T>(x, y); }, [](T x, T y) { return wrapping_add<T>(x, y); });
+  check([](auto x, auto y, auto o) { return checked_sub<T>(x, y, o); }, [](T x, T y) { return try_sub<T>(x, y); }, [](T x, T y) { return wrapping_sub<T>(x, y); });
+  check([](auto x, auto y, auto o) { return checked_mul<T>(x, y, o); }, [](T x, T y) { return try_mul<T>(x, y); }, [](T x, T y) { return wrapping_mul<T>(x, y); });
+  const auto first_add = checked_add<T>(std::span<const T>(a), std::span<const T>(b), std::span<T>(out));
+  assert(bad < n ? first_add == bad : !first_add);
+}
+
+void test_batch()
+{
+  std::mt19937_64 rng(1);
+  for(size_t n : {0, 1, 63, 64, 65, 200, 1000})
+  {
+    for(size_t bad : {n, (size_t)0, n / 2, n - 1})
+    {
+      if(n == 0 && bad != 0)
+        continue;
+      check_batch<int8_t>(rng, n, bad);
+      check_batch<uint8_t>(rng, n, bad);
+      check_batch<int16_t>(rng, n, bad);
+      check_batch<int32_t>(rng, n, bad);
+      check_batch<uint32_t>(rng, n, bad);
+      check_batch<int64_t>(rng, n, bad);
+      check_batch<uint64_t>(rng, n, bad);
+    }
+  }
+
+  // overflow found when a is overwritten by the result
+  std::vector<int> a(100, 1), b(100, 1);
+  a[10] = std::numeric_limits<int>::max();
+  assert(checked_add<int>(std::span<const int>(a), std::span<const int>(b), std::span<int>(a)) == 10);
+  assert(a[10] == std::numeric_limits<int>::min() && a[11] == 2);
+  puts("batch ok");
+}
+
+// Results of operations on bounded values have the expected ranges, and are only checked if the range could overflow.
+void test_bounded()
+{
+  constexpr size_t capacity = 1024;
+  using index = bounded<size_t, 0, capacity - 1>;
+  constexpr index i = index::assume(capacity - 1);
+  constexpr auto next = i + bounded_constant<size_t(1)>;
+  static_assert(std::is_same_v<decltype(next), const bounded<size_t, 1, capacity>>);
+  static_assert(next == capacity);
+  static_assert(!checked_integer_math_private::bounded_result<checked_integer_math_private::op::add, size_t, 0, capacity - 1, size_t, 1, 1>::needs_check);
+
+  // Two full range values: checked, and the result can be anything.
+  static_assert(checked_integer_math_private::bounded_result<checked_integer_math_private::op::add, int, std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), int, 0, 1>::needs_check);
+  static_assert(std::is_same_v<decltype(checked<int>(1) + checked<int>(2)), checked<int>>);
+
+  using small = bounded<int, -100, 100>;
+  constexpr small s(50);
+  constexpr auto product = s * small(-3);
+  static_assert(std::is_same_v<decltype(product), const bounded<int, -10000, 10000>>);
+  static_assert(product == -150);
+  constexpr auto difference = bounded<int8_t, 0, 10>(3) - bounded<int8_t, -10, 0>(-4);
+  static_assert(std::is_same_v<decltype(difference), const bounded<int8_t, 0, 20>>);
+  static_assert(difference == 7);
+  // int8_t range of the result is exceeded, so checked and limited to int8_t.
+  static_assert(std::is_same_v<decltype(bounded<int8_t>(100) + bounded<int8_t, 0, 10>(1)), bounded<int8_t, -128, 127>>);
+  static_assert(std::is_same_v<decltype(checked<uint64_t>(1) * checked<uint64_t>(2)), checked<uint64_t>>);
+
+  // Implicit conversion to a wider range, explicit (checked) to a narrower one.
+  static_assert(std::is_convertible_v<small, bounded<int, -1000, 1000>>);
+  static_assert(!std::is_convertible_v<bounded<int, -1000, 1000>, small>);
+  static_assert(!std::is_convertible_v<int, small>);
+  static_assert(small::try_make(101) == std::nullopt);
+  static_assert(small::try_make(-100L)->value() == -100);
+  static_assert(bounded<unsigned, 0, 10>::try_make(-1) == std::nullopt);
+
+  index j = index::assume(3);
+  j += bounded_constant<size_t(2)>;
+  assert(j == 5);
+  j *= 100;
+  assert(j == 500);
+  size_t k = j;
+  assert(k == 500);
+
+  // Plain integers are checked with the full range of their type, so mixing them with checked values doesn't lose the check.
+  static_assert(std::is_same_v<decltype(checked<int>(1) + 1), checked<int>>);
+  static_assert(std::is_same_v<decltype(2 * checked<int>(1)), checked<int>>);
+  static_assert(std::is_same_v<decltype(small(1) - 1), checked<int>>);
+  static_assert(checked<int>(5) - 3 == 2 && 10 * small(-3) == -30);
+  // (this overflow takes the default abort policy, so do it in a child process)
+  const pid_t pid = fork();
+  assert(pid >= 0);
+  if(pid == 0)
+  {
+    volatile int one = 1;
+    const checked<int> x(std::numeric_limits<int>::max());
+    const auto y = x + one;
+    _exit(y == 0 ? 1 : 0); // (not reached)
+  }
+  int status = 0;
+  assert(waitpid(pid, &status, 0) == pid);
+  assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+  puts("bounded ok");
+}
+
+int main()
+{
+  test_policies();
+  test_batch();
+  test_bounded();
+  return 0;
+}
@@ -0,0 +1,252 @@
+#include "file_chunk_reader.hh"
+#include <cassert>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static std::filesystem::path write_test_file(const char *name, const std::string& contents)
+{
+  const auto path = std::filesystem::temp_directory_path() / name;
+  FILE *fp = fopen(path.c_str(), "w");
+  assert(fp);
+  fputs(contents.c_str(), fp);
+  fclose(fp);
+  return path;
+}
+
+static std::vector<std::string> expected_lines(const std::string& contents, char delim)
+{
+  std::vector<std::string> lines;
+  size_t p = 0;
+  while(p < contents.size())
+  {
+    size_t e = contents.find(delim, p);
+    e = (e == std::string::npos) ? contents.size() : e + 1;
+    lines.emplace_back(contents, p, e - p);
+    p = e;
+  }
+  return lines;
+}
+
+template<typename ReaderT, typename... Args>
+static void check_reader(const std::filesystem::path& path, char delim, const std::vector<std::string>& expected, Args... args)
+{
+  ReaderT r(path, delim, args...);
+  std::vector<std::string> lines;
+  for(std::string_view line : r)
+    lines.emplace_back(line);
+  assert(lines == expected);
+}
+
+// Each backend gives the same lines, including a line longer than the block size, an empty file, and a last line without a delimiter.
+void test_backends()
+{
+  std::string contents = "first,line\nsecond\n\n";
+  contents += std::string(10'000, 'x') + "\n";
+  contents += "last line without delimiter";
+  const auto path = write_test_file("test_file_chunk_reader.txt", contents);
+  const auto expected = expected_lines(contents, '\n');
+  check_reader<rhm::getdelim_file_reader>(path, '\n', expected);
+  check_reader<rhm::block_file_reader>(path, '\n', expected);
+  check_reader<rhm::block_file_reader>(path, '\n', expected, (size_t)7);
+  check_reader<rhm::mapped_file_reader>(path, '\n', expected);
+  const auto commas = expected_lines(contents, ',');
+  check_reader<rhm::getdelim_file_reader>(path, ',', commas);
+  check_reader<rhm::block_file_reader>(path, ',', commas, (size_t)16);
+  check_reader<rhm::mapped_file_reader>(path, ',', commas);
+
+  const auto empty = write_test_file("test_file_chunk_reader_empty.txt", "");
+  check_reader<rhm::getdelim_file_reader>(empty, '\n', {});
+  check_reader<rhm::block_file_reader>(empty, '\n', {});
+  check_reader<rhm::mapped_file_reader>(empty, '\n', {});
+
+  bool threw = false;
+  try {
+    rhm::mapped_file_reader r("does/not/exist.txt");
+  } catch(const std::system_error& e) {
+    threw = true;
+    printf("expected error: %s\n", e.what());
+  }
+  assert(threw);
+
+  static_assert(std::input_iterator<rhm::getdelim_file_reader::iterator>);
+  static_assert(std::ranges::input_range<rhm::block_file_reader>);
+  std::filesystem::remove(path);
+  std::filesystem::remove(empty);
+  puts("backends ok");
+}
+
+// Moving a reader (or backend) part way through the file continues from the same line, using the same buffer.
+void test_move()
+{
+  const std::string contents = "one\ntwo\nthree\nfour\n";
+  const auto path = write_test_file("test_file_chunk_reader_move.txt", contents);
+
+  rhm::getdelim_backend a(path, '\n');
+  a.read_line();
+  assert(a.get_line() == "one\n");
+  const char *buf = a.get_line().data();
+  rhm::getdelim_backend b(std::move(a));
+  assert(a.at_end() && a.buffer_size() == 0);
+  assert(b.get_line() == "one\n" && b.get_line().data() == buf);
+  b.read_line();
+  assert(b.get_line() == "two\n");
+  a = std::move(b);
+  a.read_line();
+  assert(a.get_line() == "three\n");
+
+  rhm::block_file_reader r1(path, '\n', (size_t)8);
+  auto i = r1.begin();
+  assert(*i == "one\n");
+  rhm::block_file_reader r2(std::move(r1));
+  std::vector<std::string> rest;
+  for(auto line : r2)
+    rest.emplace_back(line);
+  assert(rest == (std::vector<std::string>{"two\n", "three\n", "four\n"}));
+  std::filesystem::remove(path);
+  puts("move ok");
+}
+
+// line_arena reuses its blocks after reset(), and allocates a separate block for a string bigger than the block size.
+void test_arena()
+{
+  rhm::line_arena arena(64);
+  assert(arena.copy("") == "");
+  std::vector<std::string_view> kept;
+  for(int i = 0; i < 20; ++i)
+    kept.push_back(arena.copy("line " + std::to_string(i)));
+  for(int i = 0; i < 20; ++i)
+    assert(kept[(size_t)i] == "line " + std::to_string(i));
+  assert(arena.bytes_used() == 10 * 6 + 10 * 7);
+  const size_t blocks = arena.block_count();
+  const size_t capacity = arena.capacity();
+  assert(blocks >= 2);
+
+  arena.reset();
+  assert(arena.bytes_used() == 0);
+  for(int i = 0; i < 20; ++i)
+    arena.copy("line " + std::to_string(i));
+  assert(arena.block_count() == blocks && arena.capacity() == capacity);
+
+  const std::string big(1000, 'b');
+  assert(arena.copy(big) == big);
+  assert(arena.block_count() == blocks + 1);
+  arena.release();
+  assert(arena.block_count() == 0 && arena.capacity() == 0);
+  puts("arena ok");
+}
+
+// Lines in each batch from for_each_batch() are valid until the batch is finished, and the arena stops growing after the first batch.
+template<typename ReaderT>
+void test_batches(const std::filesystem::path& path, const std::vector<std::string>& expected)
+{
+  ReaderT r(path);
+  rhm::line_arena arena(256);
+  std::vector<std::string> lines;
+  size_t batches = 0;
+  size_t capacity = 0;
+  const size_t n = r.for_each_batch(arena, 10, [&](std::span<const std::string_view> batch) {
+    assert(batch.size() <= 10);
+    if(batches == 1)
+      capacity = arena.capacity();
+    else if(batches > 1)
+      assert(arena.capacity() == capacity);
+    for(auto line : batch)
+      lines.emplace_back(line);
+    ++batches;
+  });
+  assert(n == expected.size());
+  assert(batches == (expected.size() + 9) / 10);
+  assert(lines == expected);
+  if constexpr(ReaderT::backend_type::stable_lines)
+    assert(arena.capacity() == 0);
+}
+
+void test_for_each_batch()
+{
+  std::string contents;
+  for(int i = 0; i < 1000; ++i)
+    contents += std::to_string(i * 7919) + ",value\n";
+  const auto path = write_test_file("test_file_chunk_reader_batch.txt", contents);
+  const auto expected = expected_lines(contents, '\n');
+  test_batches<rhm::getdelim_file_reader>(path, expected);
+  test_batches<rhm::block_file_reader>(path, expected);
+  test_batches<rhm::mapped_file_reader>(path, expected);
+  std::filesystem::remove(path);
+  puts("for_each_batch ok");
+}
+
+#if defined(USE_ZLIB) && __has_include(<zlib.h>)
+// Compressed file with two gzip members, as if two .gz files were concatenated.
+void test_gzip()
+{
+  std::string contents;
+  for(int i = 0; i < 5000; ++i)
+    contents += "gzip line " + std::to_string(i) + "\n";
+  const auto path = std::filesystem::temp_directory_path() / "test_file_chunk_reader.txt.gz";
+  const size_t half = contents.size() / 2 + 3; // (not on a line boundary)
+  gzFile gz = gzopen(path.c_str(), "wb");
+  assert(gz);
+  gzwrite(gz, contents.data(), (unsigned)half);
+  gzclose(gz);
+  gz = gzopen(path.c_str(), "ab");
+  assert(gz);
+  gzwrite(gz, contents.data() + half, (unsigned)(contents.size() - half));
+  gzclose(gz);
+  const auto expected = expected_lines(contents, '\n');
+  check_reader<rhm::gzip_file_reader>(path, '\n', expected);
+  check_reader<rhm::gzip_file_reader>(path, '\n', expected, (size_t)100);
+  std::filesystem::remove(path);
+  puts("gzip ok");
+}
+#endif
+
+#if defined(USE_ZSTD) && __has_include(<zstd.h>)
+// Compressed file with several zstd frames, read with one thread and in parallel.
+void test_zstd()
+{
+  std::string contents;
+  std::string compressed;
+  for(int f = 0; f < 8; ++f)
+  {
+    std::string part;
+    for(int i = 0; i < 1000; ++i)
+      part += "zstd frame " + std::to_string(f) + " line " + std::to_string(i) + "\n";
+    contents += part;
+    std::string c(ZSTD_compressBound(part.size()), '\0');
+    const size_t n = ZSTD_compress(c.data(), c.size(), part.data(), part.size(), 3);
+    assert(!ZSTD_isError(n));
+    compressed.append(c.data(), n);
+  }
+  const auto path = write_test_file("test_file_chunk_reader.txt.zst", "");
+  FILE *fp = fopen(path.c_str(), "wb");
+  fwrite(compressed.data(), 1, compressed.size(), fp);
+  fclose(fp);
+  const auto expected = expected_lines(contents, '\n');
+  check_reader<rhm::zstd_file_reader>(path, '\n', expected, rhm::zstd_backend::default_block_size, 1u);
+  check_reader<rhm::zstd_file_reader>(path, '\n', expected, (size_t)100, 4u);
+  {
+    rhm::zstd_file_reader r(path, '\n', rhm::zstd_backend::default_block_size, 4u);
+    assert(r.backend().data_source().parallel());
+  }
+  std::filesystem::remove(path);
+  puts("zstd ok");
+}
+#endif
+
+int main()
+{
+  test_backends();
+  test_move();
+  test_arena();
+  test_for_each_batch();
+#if defined(USE_ZLIB) && __has_include(<zlib.h>)
+  test_gzip();
+#endif
+#if defined(USE_ZSTD) && __has_include(<zstd.h>)
+  test_zstd();
+#endif
+  return 0;
+}
@@ -0,0 +1,157 @@
+#define RHM_INSTRUMENTATION 1
+#include "instrumentation.hh"
+#include "ring_buffer.hh"
+#include "sparse_index_vector.hh"
+#include "file_chunk_reader.hh"
+#include <array>
+#include <cassert>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+static rhm::instrument::counter_stats find_stats(const char *name)
+{
+  for(const auto& s : rhm::instrument::snapshot())
+    if(s.name == name)
+      return s;
+  return rhm::instrument::counter_stats{};
+}
+
+// Count, sum, maximum and histogram, and counters with the same name share totals.
+void test_counter()
+{
+  const rhm::instrument::counter c("test.values");
+  const rhm::instrument::counter same("test.values");
+  assert(c.valid());
+  assert(std::string(same.name()) == "test.values");
+  for(uint64_t v = 0; v < 100; ++v)
+    c.record(v);
+  same.record(1000);
+  const auto s = find_stats("test.values");
+  assert(s.count == 101);
+  assert(s.sum == 99 * 100 / 2 + 1000);
+  assert(s.max == 1000);
+  assert(s.histogram[0] == 1 && s.histogram[1] == 1 && s.histogram[2] == 2 && s.histogram[7] == 100 - 64 && s.histogram[10] == 1);
+  assert(s.percentile(0.5) == 63);
+  assert(s.percentile(1.0) == 1000);
+  assert(s.mean() > 58.0 && s.mean() < 59.0);
+
+  rhm::instrument::reset();
+  assert(find_stats("test.values").count == 0);
+  puts("counter ok");
+}
+
+// Each thread records into its own shard; totals from threads that have exited are kept.
+void test_threads()
+{
+  const rhm::instrument::counter c("test.threads");
+  c.record(1);
+  std::vector<std::thread> threads;
+  for(int t = 0; t < 4; ++t)
+    threads.emplace_back([&c, t] {
+      for(int i = 0; i < 10000; ++i)
+        c.record((uint64_t)t);
+    });
+  for(auto& t : threads)
+    t.join();
+  const auto s = find_stats("test.threads");
+  assert(s.count == 40001);
+  assert(s.sum == 1 + 10000 * (0 + 1 + 2 + 3));
+  assert(s.max == 3);
+  puts("threads ok");
+}
+
+void test_timers()
+{
+  const rhm::instrument::counter ns("test.timer_ns");
+  {
+    rhm::instrument::scoped_timer<rhm::instrument::steady_clock_ns> t(ns);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  assert(find_stats("test.timer_ns").count == 1);
+  assert(find_stats("test.timer_ns").sum >= 2'000'000);
+  {
+    rhm_instrument_scoped_timer("test.timer_ticks");
+  }
+  assert(find_stats("test.timer_ticks").count == 1);
+
+  {
+    rhm_instrument_scoped_hw_counters("test.hw");
+    volatile long x = 0;
+    for(int i = 0; i < 100000; ++i)
+      x = x + i;
+  }
+  if(rhm::instrument::this_thread_hw_counters().valid())
+  {
+    assert(find_stats("test.hw.cycles").count == 1 && find_stats("test.hw.cycles").sum > 0);
+    puts("timers ok (with hardware counters)");
+  }
+  else
+  {
+    assert(find_stats("test.hw.cycles").count == 0);
+    puts("timers ok (hardware counters not available)");
+  }
+}
+
+// Counters recorded by other rhm components.
+void test_components()
+{
+  rhm::ring_buffer<4, std::array<int, 4>> buf;
+  for(int i = 0; i < 6; ++i)
+    buf.push(i);
+  buf.pop();
+  const auto occupancy = find_stats("ring_buffer.occupancy");
+  assert(occupancy.count == 7 && occupancy.max == 4);
+
+  rhm::sparse_index_vector<int> v;
+  for(size_t i = 0; i < 10; ++i)
+    v.insert(10 - i, (int)i);
+  assert(find_stats("sparse_index_vector.insert_scan").count == 10);
+  assert(find_stats("sparse_index_vector.insert_moved").sum == 9 * 10 / 2);
+
+  const auto path = std::filesystem::temp_directory_path() / "test_instrumentation.txt";
+  FILE *fp = fopen(path.c_str(), "w");
+  assert(fp);
+  fputs("one\ntwo\nthree\n", fp);
+  fclose(fp);
+  for(auto line : rhm::block_file_reader(path))
+    (void)line;
+  std::filesystem::remove(path);
+  assert(find_stats("file_chunk_reader.line_bytes").sum == 14);
+  assert(find_stats("file_chunk_reader.read_line_ticks").count == 4); // (including the read at the end)
+  assert(find_stats("file_chunk_reader.read_block_bytes").sum == 14);
+
+  rhm::instrument::print_report(stdout);
+  puts("components ok");
+}
+
+// Values recorded in counters after the first max_counters are ignored.
+void test_max_counters()
+{
+  static std::vector<std::string> names;
+  for(size_t i = 0; i <= rhm::instrument::max_counters; ++i)
+    names.push_back("test.extra." + std::to_string(i));
+  size_t invalid = 0;
+  for(const auto& n : names)
+  {
+    const rhm::instrument::counter c(n.c_str());
+    c.record(1);
+    if(!c.valid())
+      ++invalid;
+  }
+  assert(invalid > 0);
+  assert(rhm::instrument::snapshot().size() == rhm::instrument::max_counters);
+  puts("max_counters ok");
+}
+
+int main()
+{
+  test_counter();
+  test_threads();
+  test_timers();
+  test_components();
+  test_max_counters();
+  return 0;
+}
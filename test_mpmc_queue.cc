@@ -0,0 +1,120 @@
+
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+
+#include "mpmc_queue.hh"
+
+void basic_test()
+{
+  rhm::mpmc_queue<8, int> q;
+  assert(q.empty());
+  assert(q.capacity() == 8);
+  int val = 0;
+  assert(!q.try_pop(val));
+  for(int i = 1; i <= 8; ++i)
+  {
+    assert(q.try_push(i));
+    assert(q.size() == (size_t)i);
+  }
+  puts("Queue should now be full.");
+  assert(q.full());
+  assert(!q.try_push(9));
+  for(int i = 1; i <= 8; ++i)
+  {
+    assert(q.try_pop(val));
+    assert(val == i);
+  }
+  assert(q.empty());
+
+  rhm::mpmc_queue<3, std::string> sq;
+  assert(sq.try_emplace(5, 'a'));
+  assert(sq.try_push(std::string("moved")));
+  sq.push("blocking push");
+  std::string s;
+  assert(sq.try_pop(s) && s == "aaaaa");
+  assert(sq.pop() == "moved");
+  sq.pop(s);
+  assert(s == "blocking push");
+  puts("ok");
+}
+
+// Several producers try_push() and several consumers try_pop(), spinning (yielding). Check that every item is received exactly once.
+void test_threads_nonblocking()
+{
+  constexpr size_t NProducers = 4;
+  constexpr size_t NConsumers = 4;
+  constexpr size_t NPerProducer = 200'000;
+  rhm::mpmc_queue<64, size_t> q;
+  std::atomic<size_t> sum{0};
+  std::atomic<size_t> received{0};
+  std::vector<std::thread> threads;
+  for(size_t p = 0; p < NProducers; ++p)
+    threads.emplace_back([&q, p]{
+      for(size_t i = 0; i < NPerProducer; ++i)
+        while(!q.try_push(p * NPerProducer + i + 1))
+          std::this_thread::yield();
+    });
+  for(size_t c = 0; c < NConsumers; ++c)
+    threads.emplace_back([&]{
+      size_t v = 0;
+      while(received.load() < NProducers * NPerProducer)
+      {
+        if(q.try_pop(v))
+        {
+          sum += v;
+          ++received;
+        }
+        else
+          std::this_thread::yield();
+      }
+    });
+  for(auto& t : threads)
+    t.join();
+  constexpr size_t n = NProducers * NPerProducer;
+  assert(received == n);
+  assert(sum == n * (n + 1) / 2);
+  printf("ok, received %lu items\n", received.load());
+}
+
+// Same but with blocking push() and pop() and a small queue, so that both producers and consumers have to wait.
+void test_threads_blocking()
+{
+  constexpr size_t NProducers = 3;
+  constexpr size_t NConsumers = 2;
+  constexpr size_t NPerProducer = 100'000;
+  constexpr size_t n = NProducers * NPerProducer;
+  static_assert(n % NConsumers == 0);
+  rhm::mpmc_queue<4, size_t> q;
+  std::atomic<size_t> sum{0};
+  std::vector<std::thread> threads;
+  for(size_t p = 0; p < NProducers; ++p)
+    threads.emplace_back([&q, p]{
+      for(size_t i = 0; i < NPerProducer; ++i)
+        q.push(p * NPerProducer + i + 1);
+    });
+  for(size_t c = 0; c < NConsumers; ++c)
+    threads.emplace_back([&]{
+      for(size_t i = 0; i < n / NConsumers; ++i)
+        sum += q.pop();
+    });
+  for(auto& t : threads)
+    t.join();
+  assert(q.empty());
+  assert(sum == n * (n + 1) / 2);
+  printf("ok, received %lu items\n", n);
+}
+
+int main()
+{
+  puts("single thread:");
+  basic_test();
+  puts("\ntry_push/try_pop with multiple threads:");
+  test_threads_nonblocking();
+  puts("\nblocking push/pop with multiple threads:");
+  test_threads_blocking();
+  return 0;
+}
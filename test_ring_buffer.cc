@@ -2,6 +2,9 @@
 #include <array>
 #include <vector>
 #include <list>
+#include <span>
+#include <string>
+#include <numeric>
 #include <cassert>
 #include <cstdio>
 
@@ -117,6 +120,201 @@ void test_copy()
   assert(empty2.empty());
 }
 
+void test_copy_pow2()
+{
+  rhm::ring_buffer<8, std::array<int, 8>> rb1;
+  rb1.fill(0);
+  rb1.push(1);
+  rhm::ring_buffer<8, std::array<int, 8>> rb2(rb1);
+  puts("Copy of buffer, all 0 except first:");
+  rb2.print();
+  std::fill_n(rb1.container.begin(), 8, 9);
+  puts("Copy should still be all 0 except first:");
+  rb2.print();
+  assert(*(rb2.front()) == 0);
+  assert(rb2.full());
+  assert(rb2.back() == rb2.nil());
+  rb2.pop_front();
+  assert(rb2.size() == 7);
+  assert(rb2.back() != rb2.nil());
+  *(rb2.back()) = 5;
+  rb2.advance_back();
+  assert(rb2.full());
+  auto rb3 = std::move(rb2);
+  std::cout << "Move assignment : " << rb3 << '\n';
+  for(int i = 0; i < 6; ++i)
+  {
+    assert(*(rb3.front()) == 0);
+    rb3.pop_front();
+  }
+  assert(*(rb3.front()) == 1);
+  rb3.pop_front();
+  assert(*(rb3.front()) == 5);
+  rb3.pop_front();
+  assert(rb3.empty());
+  assert(rb3.front() == rb3.nil());
+}
+
+template <typename ContainerT, size_t Cap>
+void test_bulk()
+{
+  rhm::ring_buffer<Cap, ContainerT> buf;
+  std::vector<int> in(Cap + 3);
+  std::iota(in.begin(), in.end(), 1);
+
+  // push less than capacity, pop some, then push enough to wrap around and replace the oldest items
+  buf.push_range(std::span<const int>(in.data(), 5));
+  assert(buf.size() == 5);
+  std::vector<int> out(Cap * 2);
+  size_t n = buf.pop_into(std::span<int>(out.data(), 3));
+  assert(n == 3);
+  assert(out[0] == 1 && out[1] == 2 && out[2] == 3);
+  buf.push_range(in);  // more than capacity, only the last Cap remain
+  printf("After push_range of %lu items: ", in.size());
+  std::cerr << buf << '\n';
+  assert(buf.full());
+  assert(*(buf.front()) == 4);
+  n = buf.pop_into(out);
+  assert(n == Cap);
+  assert(buf.empty());
+  for(size_t i = 0; i < n; ++i)
+    assert(out[i] == (int)i + 4);
+
+  // wrap around with strings (not trivially copyable)
+  rhm::ring_buffer<Cap, std::array<std::string, Cap>> sbuf;
+  std::vector<std::string> words{"one", "two", "three"};
+  for(size_t i = 0; i < Cap - 1; ++i)
+    sbuf.push("x");
+  for(size_t i = 0; i < Cap - 1; ++i)
+    sbuf.pop_front();
+  sbuf.push_range(words);
+  std::vector<std::string> wout(3);
+  assert(sbuf.pop_into(wout) == 3);
+  assert(wout == words);
+  puts("ok");
+}
+
+void test_contiguous_spans()
+{
+  rhm::ring_buffer<8, std::array<int, 8>> buf;
+  for(int i = 0; i < 6; ++i)
+    buf.push(i);
+  buf.advance_front(4); // front is now at position 4, back at position 6
+  auto [w1, w2] = buf.contiguous_writable();
+  assert(w1.size() == 2 && w2.size() == 4);
+  std::iota(w1.begin(), w1.end(), 6);
+  std::iota(w2.begin(), w2.end(), 8);
+  buf.advance_back(w1.size() + w2.size());
+  assert(buf.full());
+  printf("After writing into contiguous_writable() spans: ");
+  std::cerr << buf << '\n';
+  auto [r1, r2] = buf.contiguous_readable();
+  assert(r1.size() == 4 && r2.size() == 4);
+  assert(r1[0] == 4 && r1[3] == 7 && r2[0] == 8 && r2[3] == 11);
+  buf.advance_front(r1.size());
+  assert(*(buf.front()) == 8);
+  puts("ok");
+}
+
+template <typename ContainerT, size_t Cap>
+void test_move_emplace()
+{
+  rhm::ring_buffer<Cap, ContainerT> buf;
+  const std::string big(100, 'x');
+  for(size_t i = 0; i < Cap; ++i)
+  {
+    std::string s = big;
+    buf.push(std::move(s));
+    assert(s.empty()); // moved from
+  }
+  assert(buf.full());
+
+  // emplace replacing the oldest item
+  buf.emplace("short");
+  std::string last;
+  for(size_t i = 0; i < Cap - 1; ++i)
+  {
+    std::string s = buf.pop();
+    assert(s == big);
+  }
+  last = buf.pop();
+  assert(last == "short");
+  assert(buf.empty());
+
+  // emplace constructing a new item from several arguments
+  buf.emplace(3, 'y');
+  assert(*(buf.front()) == "yyy");
+  assert(buf.pop() == "yyy");
+  puts("ok");
+}
+
+void test_emplace_reuses_capacity()
+{
+  rhm::ring_buffer<4, std::array<std::string, 4>> buf;
+  for(int i = 0; i < 4; ++i)
+    buf.push(std::string(100, 'a' + i));
+  const std::string *slot0 = &(*buf.front());
+  const size_t cap = slot0->capacity();
+  buf.emplace("replacement"); // replaces slot 0, assigning from const char*
+  assert(*slot0 == "replacement");
+  assert(slot0->capacity() == cap);
+  puts("ok");
+}
+
+// Check replace_oldest and reject_new policies, and the replaced/rejected counters.
+template <typename ContainerT, size_t Cap>
+void test_full_policy()
+{
+  rhm::ring_buffer<Cap, ContainerT> rep;
+  rhm::ring_buffer<Cap, ContainerT, rhm::ring_buffer_full_policy::reject_new> rej;
+  for(int i = 0; i < (int)Cap; ++i)
+  {
+    assert(rep.push(i));
+    assert(rej.push(i));
+  }
+  assert(rep.full() && rej.full());
+  assert(rep.replaced_count() == 0 && rej.rejected_count() == 0);
+
+  assert(rep.push(100));
+  assert(rep.push(101));
+  assert(rep.replaced_count() == 2);
+  assert(rep.rejected_count() == 0);
+  assert(*rep.front() == 2);
+
+  assert(!rej.push(100));
+  assert(!rej.emplace(101));
+  assert(!rej.advance_back());
+  assert(rej.rejected_count() == 3);
+  assert(rej.replaced_count() == 0);
+  assert(*rej.front() == 0);
+  assert(rej.size() == Cap);
+
+  // push_range() into a buffer with two free spaces: reject_new only adds two items.
+  rej.pop_front();
+  rej.pop_front();
+  const std::array<int, 4> items{200, 201, 202, 203};
+  assert(rej.push_range(items) == 2);
+  assert(rej.rejected_count() == 5);
+  assert(rej.full());
+  rep.pop_front();
+  rep.pop_front();
+  assert(rep.push_range(items) == 4);
+  assert(rep.replaced_count() == 4);
+  assert(*rep.front() == 6);
+
+  int last = 0;
+  for(auto copy = rep; !copy.empty(); )
+    last = copy.pop();
+  assert(last == 203);
+
+  // Counters are copied with the buffer.
+  auto copy = rej;
+  assert(copy.rejected_count() == 5);
+  rej.reset_counters();
+  assert(rej.rejected_count() == 0);
+  assert(copy.rejected_count() == 5);
+  puts("ok");
+}
 
 int main()
 {
@@ -124,9 +322,31 @@ int main()
   basic_test<std::array<int, 10>, 10>();
   puts("\nstd::vector:");
   basic_test<std::vector<int>, 10>();
+  puts("\nstd::array with power of two capacity:");
+  basic_test<std::array<int, 16>, 16>();
   puts("\nstd::list:");
   basic_test<std::list<int>, 10>();
   puts("\ncopies and moves:");
   test_copy();
+  puts("\ncopies and moves with power of two capacity:");
+  test_copy_pow2();
+  puts("\npush_range and pop_into with std::array with power of two capacity:");
+  test_bulk<std::array<int, 16>, 16>();
+  puts("\npush_range and pop_into with std::vector:");
+  test_bulk<std::vector<int>, 10>();
+  puts("\ncontiguous_readable and contiguous_writable:");
+  test_contiguous_spans();
+  puts("\nmove, emplace and pop with std::vector:");
+  test_move_emplace<std::vector<std::string>, 5>();
+  puts("\nmove, emplace and pop with std::array with power of two capacity:");
+  test_move_emplace<std::array<std::string, 8>, 8>();
+  puts("\nmove, emplace and pop with std::list:");
+  test_move_emplace<std::list<std::string>, 3>();
+  puts("\nemplace reuses allocated capacity:");
+  test_emplace_reuses_capacity();
+  puts("\nfull policies and counters with std::vector:");
+  test_full_policy<std::vector<int>, 10>();
+  puts("\nfull policies and counters with std::array with power of two capacity:");
+  test_full_policy<std::array<int, 16>, 16>();
   return 0;
 }
@@ -1,6 +1,190 @@
 
 #include "sparse_index_vector.hh"
 #include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cassert>
+#include <ranges>
+#include <string>
+
+// Check that each of the index search functions used by insert() gives the same result as std::lower_bound(), for different sizes.
+void test_search()
+{
+  std::mt19937 rng(1);
+  for(size_t n : {0, 1, 3, 8, 9, 16, 17, 33, 48, 49, 100, 1000})
+  {
+    std::vector<size_t> indices(n);
+    std::uniform_int_distribution<size_t> dist(0, n);
+    for(auto& i : indices)
+      i = dist(rng);
+    std::sort(indices.begin(), indices.end());
+    for(size_t key = 0; key <= n + 1; ++key)
+    {
+      const auto expected = (size_t) (std::lower_bound(indices.begin(), indices.end(), key) - indices.begin());
+      assert(rhm::_private::index_lower_bound_linear(indices.data(), n, key) == expected);
+      assert(rhm::_private::index_lower_bound_count(indices.data(), n, key) == expected);
+      assert(rhm::_private::index_lower_bound_binary(indices.data(), n, key) == expected);
+    }
+  }
+
+  // Insert enough items that insert() uses each search method, with repeated indices (new items go before an existing
+  // item with the same index), and check the order.
+  rhm::sparse_index_vector<int> v;
+  for(int i = 0; i < 200; ++i)
+    v.insert((size_t)(i % 50), i);
+  assert(v.size() == 200);
+  int prev = -1;
+  for(int x : v)
+  {
+    if(prev != -1)
+      assert(prev % 50 < x % 50 || (prev % 50 == x % 50 && prev > x));
+    prev = x;
+  }
+  puts("index search ok");
+}
+
+// Check that assign_unsorted() and insert_bulk() give the same result as calling insert() for each item.
+void test_bulk()
+{
+  std::vector<std::pair<size_t, int>> pairs;
+  std::mt19937 rng(2);
+  std::uniform_int_distribution<size_t> dist(0, 100);
+  for(int i = 0; i < 500; ++i)
+    pairs.emplace_back(dist(rng), i);
+
+  rhm::sparse_index_vector<int> expected;
+  for(const auto& [index, value] : pairs)
+    expected.insert(index, value);
+
+  rhm::sparse_index_vector<int> v(pairs);
+  assert(v.size() == expected.size());
+  assert(std::equal(v.begin(), v.end(), expected.begin()));
+
+  rhm::sparse_index_vector<int> il{{5, 1}, {1, 2}, {5, 3}};
+  std::cout << "from initializer list: " << il << '\n';
+  assert(*il.begin() == 2 && *std::next(il.begin()) == 3);
+
+  // Merge a sorted batch; each new item goes before existing items with the same index.
+  std::vector<std::pair<size_t, int>> batch{{0, -1}, {50, -2}, {50, -3}, {200, -4}};
+  v.insert_bulk(batch);
+  for(const auto& [index, value] : batch)
+    expected.insert(index, value);
+  // (insert() one at a time puts -3 before -2, insert_bulk() keeps their order from the batch.)
+  std::vector<int> ev(expected.begin(), expected.end());
+  std::swap(*std::find(ev.begin(), ev.end(), -2), *std::find(ev.begin(), ev.end(), -3));
+  assert(v.size() == ev.size());
+  assert(std::equal(v.begin(), v.end(), ev.begin()));
+  assert(*v.begin() == -1 && *std::prev(v.end()) == -4);
+
+  rhm::sparse_index_vector<int> e;
+  e.reserve(10);
+  e.insert_bulk(batch);
+  std::cout << "insert_bulk into empty: " << e << '\n';
+
+  // Batch from a view which makes each pair as it is iterated (so each pair only lasts for one iteration), with values which can be moved.
+  rhm::sparse_index_vector<std::string> s{{1, "one"}, {3, "three"}};
+  const std::vector<size_t> keys{0, 2, 2, 4};
+  s.insert_bulk(keys | std::views::transform([](size_t k) { return std::pair<size_t, std::string>(k, std::string(20, char('a' + k))); }));
+  const std::vector<std::string> sv(s.begin(), s.end());
+  assert(sv == (std::vector<std::string>{std::string(20, 'a'), "one", std::string(20, 'c'), std::string(20, 'c'), "three", std::string(20, 'e')}));
+
+  // Copying a non-const lvalue uses the copy constructor, not the range constructor.
+  rhm::sparse_index_vector<int> copy(v);
+  assert(copy.size() == v.size() && std::equal(copy.begin(), copy.end(), v.begin()));
+  const rhm::sparse_index_vector<int> moved(std::move(copy));
+  assert(moved.size() == v.size());
+  puts("bulk ok");
+}
+
+// Check erase by iterator (tombstones), iteration skipping erased items, and compact().
+void test_erase()
+{
+  rhm::sparse_index_vector<int> v{{1, 1}, {2, 2}, {3, 3}, {4, 4}, {5, 5}, {6, 6}};
+  auto it = v.begin();
+  it = v.erase(it); // erase 1
+  assert(*it == 2);
+  ++it;
+  it = v.erase(it); // erase 3
+  assert(*it == 4 && it.index() == 4);
+  auto last = std::prev(v.end());
+  assert(*last == 6);
+  v.erase(last);
+  v.erase(&*std::next(v.begin())); // erase 4
+  assert(v.size() == 2 && v.erased_count() == 4);
+  std::cout << "after erasing by iterator: " << v << '\n';
+  assert(*v.begin() == 2 && *std::prev(v.end()) == 5);
+  assert(*std::prev(std::prev(v.end())) == 2);
+  int sum = 0;
+  for(int x : v)
+    sum += x;
+  assert(sum == 7);
+  v.erase(5);
+  assert(v.size() == 1);
+
+  v.compact();
+  assert(v.size() == 1 && v.erased_count() == 0);
+  assert(*v.begin() == 2);
+
+  // A later insert() compacts automatically when enough items have been erased.
+  for(int i = 10; i < 30; ++i)
+    v.insert((size_t)i, i);
+  for(auto i = v.begin(); i != v.end(); )
+    i = (*i % 2 == 0) ? v.erase(i) : std::next(i);
+  assert(v.size() == 10 && v.erased_count() == 11);
+  v.insert(0, 0);
+  assert(v.erased_count() == 0 && v.size() == 11);
+  assert(*v.begin() == 0 && *std::next(v.begin()) == 11);
+  std::cout << "after erasing even values and inserting: " << v << '\n';
+
+  // insert_bulk() also removes erased items.
+  v.erase(v.begin());
+  std::vector<std::pair<size_t, int>> batch{{12, 100}};
+  v.insert_bulk(batch);
+  assert(v.erased_count() == 0 && v.size() == 11);
+  puts("erase ok");
+}
+
+// Check pairs() view and equal_range()
+void test_pairs()
+{
+  rhm::sparse_index_vector<int> v{{1, 10}, {2, 20}, {2, 21}, {2, 22}, {5, 50}};
+  static_assert(std::ranges::bidirectional_range<decltype(v.pairs())>);
+  for(auto [index, value] : v.pairs())
+    value += (int)index; // value is a reference
+  for(const auto& p : v.pairs())
+    std::cout << p.first << ":" << p.second << " ";
+  std::cout << '\n';
+  assert(*v.begin() == 11);
+
+  const auto& cv = v;
+  size_t n = 0;
+  for(auto [index, value] : cv.pairs())
+  {
+    static_assert(std::is_same_v<decltype(value), const int&>);
+    assert(value / 10 == (int)index);
+    ++n;
+  }
+  assert(n == cv.pairs().size());
+
+  auto [first, last] = v.equal_range(2);
+  assert(std::distance(first, last) == 3);
+  assert(first.index() == 2 && *first == 24); // (items with the same index are in reverse order of insertion)
+  auto [f3, l3] = v.equal_range(3);
+  assert(f3 == l3 && *f3 == 55);
+  auto [f6, l6] = cv.equal_range(6);
+  assert(f6 == cv.end() && l6 == cv.end());
+
+  // Erased items are skipped at the start of the range.
+  v.erase(first);
+  std::tie(first, last) = v.equal_range(2);
+  assert(std::distance(first, last) == 2 && *first == 23);
+  v.erase(first);
+  v.erase(std::next(v.begin(), 1));
+  std::tie(first, last) = v.equal_range(2);
+  assert(first == last && *first == 55);
+  puts("pairs ok");
+}
 
 int main()
 {
@@ -38,5 +222,10 @@ int main()
   puts("after erasing 11: ");
   std::cout << v << '\n';
 
+  test_search();
+  test_bulk();
+  test_erase();
+  test_pairs();
+
   return 0;
 }
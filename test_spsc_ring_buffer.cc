@@ -0,0 +1,103 @@
+
+#include <array>
+#include <vector>
+#include <string>
+#include <thread>
+#include <cassert>
+#include <cstdio>
+
+#include "spsc_ring_buffer.hh"
+
+template <typename ContainerT, size_t Cap>
+void basic_test()
+{
+  rhm::spsc_ring_buffer<Cap, ContainerT> buf;
+  assert(buf.empty());
+  assert(buf.front() == buf.nil());
+  assert(buf.capacity() == Cap);
+
+  for(size_t i = 1; i <= Cap; ++i)
+  {
+    bool pushed = buf.try_push((int)i);
+    assert(pushed);
+    assert(buf.size() == i);
+    assert(*(buf.front()) == 1);
+  }
+  puts("Buffer should now be full.");
+  assert(buf.full());
+  assert(!buf.try_push(42));
+  assert(buf.size() == Cap);
+
+  int val = 0;
+  assert(buf.try_pop(val));
+  assert(val == 1);
+  assert(*(buf.front()) == 2);
+  assert(buf.try_push(42));
+  assert(buf.full());
+
+  for(int expected = 2; expected <= (int)Cap; ++expected)
+  {
+    assert(buf.try_pop(val));
+    assert(val == expected);
+  }
+  assert(buf.try_pop(val));
+  assert(val == 42);
+  assert(buf.empty());
+  assert(!buf.try_pop(val));
+  puts("ok");
+}
+
+void test_emplace_move()
+{
+  rhm::spsc_ring_buffer<4, std::array<std::string, 4>> buf;
+  std::string s(100, 'x');
+  assert(buf.try_push(std::move(s)));
+  assert(buf.try_emplace(10, 'y'));
+  assert(buf.try_emplace("literal"));
+  std::string out;
+  assert(buf.try_pop(out) && out == std::string(100, 'x'));
+  assert(buf.try_pop(out) && out == std::string(10, 'y'));
+  assert(buf.try_pop(out) && out == "literal");
+  assert(buf.empty());
+  puts("ok");
+}
+
+void test_threads()
+{
+  constexpr size_t N = 1'000'000;
+  rhm::spsc_ring_buffer<256, std::array<size_t, 256>> buf;
+  std::thread producer([&buf]{
+    for(size_t i = 0; i < N; ++i)
+      while(!buf.try_push(i))
+        std::this_thread::yield();
+  });
+  size_t expected = 0;
+  while(expected < N)
+  {
+    auto f = buf.front();
+    if(f == buf.nil())
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    assert(*f == expected);
+    buf.pop_front();
+    ++expected;
+  }
+  producer.join();
+  assert(buf.empty());
+  printf("ok, received %lu items in order\n", expected);
+}
+
+int main()
+{
+  puts("std::array:");
+  basic_test<std::array<int, 10>, 10>();
+  puts("\nstd::vector:");
+  basic_test<std::vector<int>, 8>();
+  puts("\nemplace and move:");
+  test_emplace_move();
+  puts("\nproducer and consumer threads:");
+  test_threads();
+  return 0;
+}
@@ -0,0 +1,74 @@
+#include "static_string_map.hh"
+#include <cassert>
+#include <cstdio>
+#include <string>
+
+// Each key is found at its index, and strings which are not keys are not found.
+template<typename MapT>
+void check_map()
+{
+  for(size_t i = 0; i < MapT::size(); ++i)
+    assert(MapT::find(MapT::keys[i]) == i);
+  for(size_t i = 0; i < MapT::size(); ++i)
+  {
+    const std::string k(MapT::keys[i]);
+    for(const std::string& other : {k + "x", "x" + k, k.substr(0, k.size() / 2), k + '\0'})
+    {
+      bool is_key = false;
+      for(auto key : MapT::keys)
+        is_key = is_key || (key == other);
+      assert(MapT::contains(other) == is_key);
+    }
+  }
+}
+
+void test_static_string_map()
+{
+  using commands = rhm::static_string_map<"start", "stop", "status">;
+  static_assert(commands::size() == 3);
+  static_assert(commands::find("stop") == 1);
+  static_assert(commands::find("sto") == commands::npos);
+  static_assert(commands::index_of<"status"> == 2);
+  static_assert(!commands::contains("Start"));
+  check_map<commands>();
+
+  using one = rhm::static_string_map<"only">;
+  static_assert(one::find("only") == 0 && one::find("") == one::npos);
+  static_assert(rhm::static_string_map<>::find("x") == rhm::static_string_map<>::npos);
+
+  using topics = rhm::static_string_map<"CONNECT", "CONNACK", "PUBLISH", "PUBACK", "PUBREC", "PUBREL", "PUBCOMP", "SUBSCRIBE", "SUBACK", "UNSUBSCRIBE", "UNSUBACK", "PINGREQ", "PINGRESP", "DISCONNECT", "AUTH", "sensor/0/temperature", "sensor/1/temperature", "sensor/2/temperature", "sensor/3/temperature", "sensor/4/temperature", "sensor/5/temperature", "sensor/6/temperature", "sensor/7/temperature", "sensor/8/temperature", "sensor/9/temperature", "sensor/10/temperature", "sensor/11/temperature", "sensor/12/temperature", "sensor/13/temperature", "sensor/14/temperature", "sensor/15/temperature", "sensor/16/temperature", "sensor/17/temperature", "sensor/18/temperature", "sensor/19/temperature", "sensor/0/humidity", "sensor/1/humidity", "sensor/2/humidity", "sensor/3/humidity", "sensor/4/humidity", "sensor/5/humidity", "sensor/6/humidity", "sensor/7/humidity", "sensor/8/humidity", "sensor/9/humidity", "sensor/10/humidity", "sensor/11/humidity", "sensor/12/humidity", "sensor/13/humidity", "sensor/14/humidity", "sensor/15/humidity", "sensor/16/humidity", "sensor/17/humidity", "sensor/18/humidity", "sensor/19/humidity", "", "a", "b", "ab", "ba">;
+  static_assert(topics::size() == 60);
+  static_assert(topics::index_of<"sensor/7/humidity"> == 15 + 20 + 7);
+  check_map<topics>();
+
+  // (A switch on the index, as it would be used to dispatch commands.)
+  auto dispatch = [](std::string_view cmd) {
+    switch(commands::find(cmd))
+    {
+      case commands::index_of<"start">: return 1;
+      case commands::index_of<"stop">: return 2;
+      case commands::index_of<"status">: return 3;
+      default: return 0;
+    }
+  };
+  assert(dispatch("start") == 1 && dispatch("status") == 3 && dispatch("restart") == 0);
+  puts("static_string_map ok");
+}
+
+void test_string_id()
+{
+  static_assert(rhm::fnv1a("") == 0xcbf29ce484222325ull);
+  static_assert(rhm::fnv1a("a") == 0xaf63dc4c8601ec8cull);
+  static_assert(rhm::fnv1a("foobar") == 0x85944171f73967e8ull);
+  static_assert(rhm::string_id<"foobar"> == rhm::fnv1a("foobar"));
+  const std::string s = "foobar";
+  assert(rhm::fnv1a(s) == rhm::string_id<"foobar">);
+  puts("string_id ok");
+}
+
+int main()
+{
+  test_string_id();
+  test_static_string_map();
+  return 0;
+}
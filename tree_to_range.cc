@@ -15,8 +15,10 @@ struct TreeNode
     std::string data;
     using ChildrenList = std::vector<TreeNode*>;
     ChildrenList children;
-    TreeNode* parent;
+    TreeNode* parent = nullptr;
     size_t size = 1;
+    bool dirty = true;          // changed since last TreeSerializer::update(). If a node is dirty then so are all of its ancestors.
+    size_t serial_offset = 0;   // position of this node in its parent's subtree in TreeSerializer's cached iovec list
     
     explicit TreeNode(std::string_view init_data) : 
         data(init_data)
@@ -29,17 +31,34 @@ struct TreeNode
         parent->add_child(this);
     }
 
+    // Add n (and its subtree, if it has one) as the last child of this node.
     void add_child(TreeNode* n)
     {
+        assert(n->parent == nullptr || n->parent == this);
+        n->parent = this;
         children.push_back(n);
-        child_added();
+        subtree_added(n->size);
+        mark_dirty();
     }
 
-    void child_added()
+    // Replace data. (Use this rather than modifying data directly, so that TreeSerializer knows to update this node.)
+    void set_data(std::string_view new_data)
     {
-        ++size;
-        if(parent)
-            parent->child_added();
+        data = new_data;
+        mark_dirty();
+    }
+
+    // Mark this node and its ancestors as changed. Stops at the first ancestor that is already dirty, since its ancestors must be too.
+    void mark_dirty()
+    {
+        for(TreeNode *n = this; n && !n->dirty; n = n->parent)
+            n->dirty = true;
+    }
+
+    void subtree_added(size_t n)
+    {
+        for(TreeNode *p = this; p; p = p->parent)
+            p->size += n;
     }
 
 };
@@ -167,57 +186,57 @@ namespace std
 #include <ranges>
 #include <cstdio>
 
-void test_join_ranges_putchar(TreeNode& tree)
+void test_join_ranges_putchar(TreeNode& tree, FILE *out = stdout)
 {
-    puts("-> test_join_ranges_putchar...");
+    fputs("-> test_join_ranges_putchar...\n", out);
     auto nodes_begin = std::begin(tree);
     auto nodes_end = std::end(tree);
     auto r = std::ranges::subrange(nodes_begin, nodes_end);  // only need all and the subrange because TreeNode doesn't have begin() or end()
     auto chars_view = r | std::views::transform(&TreeNode::data) | std::views::join; 
     for(auto c : chars_view)
     {
-        putchar(c);
+        putc(c, out);
     }
-    puts("...done.");
+    fputs("...done.\n", out);
 }
 
 #include <iostream>
 
-void test_join_ranges_iostream(TreeNode& tree)
+void test_join_ranges_iostream(TreeNode& tree, std::ostream& out = std::cout)
 {
-    puts("-> test_join_ranges_iostream...");
+    out << "-> test_join_ranges_iostream...\n";
     auto nodes_begin = std::begin(tree);
     auto nodes_end = std::end(tree);
     auto r = std::ranges::subrange(nodes_begin, nodes_end);  // only need all and the subrange because TreeNode doesn't have begin() or end()
     auto chars_view = r | std::views::transform(&TreeNode::data) | std::views::join; 
     
     //std::cout << chars_view;
-    std::ranges::copy(chars_view, std::ostream_iterator<char>(std::cout));
+    std::ranges::copy(chars_view, std::ostream_iterator<char>(out));
 
     /*for(auto c : chars_view)
     {
-        std::cout << c;
+        out << c;
     }
     */
 
-    puts("...done.");
+    out << "...done.\n";
 }
 
 #include "fmt/format.h"
 #include "fmt/ranges.h"
 
-void test_join_ranges_libfmt(TreeNode& tree)
+void test_join_ranges_libfmt(TreeNode& tree, FILE *out = stdout)
 {
-    puts("-> test_join_ranges_libfmt...");
+    fputs("-> test_join_ranges_libfmt...\n", out);
     auto nodes_begin = std::begin(tree);
     auto nodes_end = std::end(tree);
     auto r = std::ranges::subrange(nodes_begin, nodes_end);  // only need all and the subrange because TreeNode doesn't have begin() or end()
     auto chars_view = r | std::views::transform(&TreeNode::data) | std::views::join; 
     
     //fmt::print("{}", chars_view); // unfortunately libfmt does additional formating of the range which is useful for debug logging but can't be removed for "raw" output, so we have to use fmt::join to concatenate the data:
-    fmt::print("{}", fmt::join(chars_view, ""));
+    fmt::print(out, "{}", fmt::join(chars_view, ""));
 
-    puts("...done.");
+    fputs("...done.\n", out);
 }
 
 /*
@@ -233,19 +252,19 @@ void test_join_ranges_libfmt(TreeNode& tree)
 #include <cerrno>
 #include <cstring>
 
-void test_iterate_fputs(TreeNode& tree)
+void test_iterate_fputs(TreeNode& tree, FILE *out = stdout)
 {
-    puts("-> test_iterate_fputs...");
+    fputs("-> test_iterate_fputs...\n", out);
     auto r = std::ranges::subrange(std::begin(tree), std::end(tree));
 
     for (auto &node : r)
     {
-        int status = fputs(node.data.c_str(), stdout);
+        int status = fputs(node.data.c_str(), out);
         if (status < 0 || status == EOF)
             throw std::runtime_error(std::string("IO Error writing serialization of tree: ") + strerror(errno));
     }
 
-    puts("...done.");
+    fputs("...done.\n", out);
 }
 
 
@@ -254,13 +273,19 @@ void test_iterate_fputs(TreeNode& tree)
 #include <sys/uio.h>
 #include <unistd.h>
 
-void test_iterate_gather_then_writev(TreeNode& tree)
+// If RHM_INSTRUMENTATION is enabled, the "tree_to_range.writev" counter records the bytes written by each writev() call
+// (so its count is the number of system calls made).
+#include "instrumentation_hooks.hh"
+
+void test_iterate_gather_then_writev(TreeNode& tree, FILE *out = stdout)
 {
-    puts("-> test_iterate_gather_then_writev...");
+    fputs("-> test_iterate_gather_then_writev...\n", out);
+    fflush(out);
 
-    // Gather buffers in iovec structs for writev(). For now use static assuming tree doesn't change. This info could all be cached unchanged if tree doesn't change; we could also realloc iov_arr instead of free and malloc if the tree did change.
-    static struct iovec *iov_arr = (struct iovec*)malloc(tree.size * sizeof(struct iovec));
-    assert(iov_arr != nullptr);
+    // Gather buffers in iovec structs for writev(). The array is rebuilt on each call (but its memory is reused); see TreeSerializer below for a version which caches it.
+    static std::vector<struct iovec> iov_vec;
+    iov_vec.resize(tree.size);
+    struct iovec *iov_arr = iov_vec.data();
     struct iovec *iovp = iov_arr;
     size_t total_nbytes = 0;
     size_t count = 0;
@@ -276,15 +301,718 @@ void test_iterate_gather_then_writev(TreeNode& tree)
 
     assert(count == tree.size); // check that we visited the number of nodes we thought the tree had
 
-    ssize_t n = writev(STDOUT_FILENO, iov_arr, count);
-    //free(iov_arr); // disable, iov_arr is static
+    ssize_t n = writev(fileno(out), iov_arr, (int)std::min<size_t>(count, IOV_MAX));
+    rhm_instrument_record("tree_to_range.writev", std::max<ssize_t>(n, 0));
 
     if(n < 0)
         throw std::runtime_error(std::string("IO Error writing serialization of tree: ") + strerror(errno));
     if((size_t)n < total_nbytes)
         printf("Warning: data truncated (we calculated %lu bytes, writev returned %ld bytes)\n", total_nbytes, n);
 
-    puts("...done.");
+    fputs("...done.\n", out);
+}
+
+
+
+/*
+    TreeSerializer keeps the iovec list for writev() between calls, instead of traversing the tree and rebuilding it
+    each time.  update() (called by write()) does nothing if the root node is not dirty (after the first update).  Otherwise it rebuilds the list
+    in depth first order, but for each subtree that is not dirty, it copies that subtree's entries from the previous list
+    (found from each node's serial_offset) instead of traversing it, so only the changed parts of the tree are visited.
+    write() writes the list with as many writev() calls as needed (at most IOV_MAX entries each), continuing after
+    partial writes, and retrying if interrupted by a signal.
+
+    The dirty flags and offsets are stored in TreeNode, so only one TreeSerializer should be used for a tree.
+    Node data must be changed with TreeNode::set_data(), since the cached iovecs point to each node's string data.
+*/
+
+#include <climits>
+#include <span>
+#include <system_error>
+
+class TreeSerializer
+{
+public:
+    explicit TreeSerializer(TreeNode& tree) noexcept : root(&tree) {}
+
+    // Update cached iovec list for any changes to the tree.
+    void update()
+    {
+        if(built && !root->dirty)
+            return;
+        scratch.clear();
+        scratch.reserve(root->size);
+        ++rebuild_count;
+        append(*root, 0, 0);
+        built = true;
+        iovs.swap(scratch);
+        assert(iovs.size() == root->size);
+    }
+
+    // Write the serialized tree to fd (which should be in blocking mode). Returns number of bytes written.
+    // Throws std::system_error if writev() fails.
+    size_t write(int fd)
+    {
+        update();
+        size_t total = 0;
+        size_t i = 0;       // next iovec to write
+        size_t partial = 0; // bytes of iovs[i] already written
+        while(i < iovs.size())
+        {
+            ssize_t r;
+            if(partial > 0)
+            {
+                // finish the partially written buffer without modifying the cached iovec
+                r = ::write(fd, static_cast<const char*>(iovs[i].iov_base) + partial, iovs[i].iov_len - partial);
+            }
+            else
+            {
+                while(i < iovs.size() && iovs[i].iov_len == 0)
+                    ++i;
+                if(i == iovs.size())
+                    break;
+                r = writev(fd, &iovs[i], (int)std::min<size_t>(iovs.size() - i, IOV_MAX));
+            }
+            rhm_instrument_record("tree_to_range.writev", std::max<ssize_t>(r, 0));
+            if(r < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+                throw std::system_error(errno, std::system_category(), "IO Error writing serialization of tree");
+            }
+            if(r == 0)
+                throw std::runtime_error("IO Error writing serialization of tree: write returned 0");
+            total += (size_t)r;
+            size_t remaining = (size_t)r + partial;
+            partial = 0;
+            while(i < iovs.size() && remaining >= iovs[i].iov_len)
+            {
+                remaining -= iovs[i].iov_len;
+                ++i;
+            }
+            partial = remaining;
+        }
+        return total;
+    }
+
+    // Cached iovec list (after update()).
+    std::span<const struct iovec> iovecs() const noexcept { return iovs; }
+
+    // Number of times update() has had to rebuild the list
+    size_t rebuilds() const noexcept { return rebuild_count; }
+
+private:
+    // Append entries for the subtree starting at n to scratch. old_pos is the position of n in the previous iovs (if n was in it).
+    void append(TreeNode& n, size_t old_pos, size_t parent_pos)
+    {
+        const size_t pos = scratch.size();
+        if(built && !n.dirty)
+        {
+            assert(old_pos + n.size <= iovs.size());
+            scratch.insert(scratch.end(), iovs.begin() + (std::ptrdiff_t)old_pos, iovs.begin() + (std::ptrdiff_t)(old_pos + n.size));
+        }
+        else
+        {
+            scratch.push_back({(void*)n.data.data(), n.data.size()});
+            for(TreeNode *c : n.children)
+                append(*c, old_pos + c->serial_offset, pos); // (c->serial_offset is only meaningful if c is not dirty)
+            n.dirty = false;
+        }
+        n.serial_offset = pos - parent_pos;
+    }
+
+    TreeNode *root;
+    std::vector<struct iovec> iovs;
+    std::vector<struct iovec> scratch;
+    size_t rebuild_count = 0;
+    bool built = false; // (the first update() builds the whole list, even if the tree is not dirty, e.g. if it was written by another TreeSerializer before)
+};
+
+
+void test_serializer_writev(TreeSerializer& serializer, FILE *out = stdout)
+{
+    fputs("-> test_serializer_writev...\n", out);
+    fflush(out);
+    serializer.write(fileno(out));
+    fputs("...done.\n", out);
+}
+
+#include <deque>
+#include <filesystem>
+
+// Serialize a tree with more than IOV_MAX nodes to a file and check the contents, then change some nodes and check again.
+void test_serializer_updates()
+{
+    std::deque<TreeNode> nodes; // (deque doesn't move existing nodes when adding more)
+    TreeNode& root = nodes.emplace_back("root\n");
+    for(int i = 0; i < 100; ++i)
+    {
+        TreeNode& branch = nodes.emplace_back("branch " + std::to_string(i) + "\n", &root);
+        for(int j = 0; j < 30; ++j)
+            nodes.emplace_back("  leaf " + std::to_string(j) + "\n", &branch);
+    }
+    assert(root.size > IOV_MAX);
+
+    const auto path = std::filesystem::temp_directory_path() / "tree_to_range_test_serializer.txt";
+    auto check = [&](TreeSerializer& ser) {
+        std::string expected;
+        for(auto &n : std::ranges::subrange(std::begin(root), std::end(root)))
+            expected += n.data;
+        FILE *fp = fopen(path.c_str(), "w+");
+        assert(fp);
+        const size_t n = ser.write(fileno(fp));
+        assert(n == expected.size());
+        std::string contents(n, '\0');
+        rewind(fp);
+        assert(fread(contents.data(), 1, n, fp) == n);
+        fclose(fp);
+        assert(contents == expected);
+    };
+
+    TreeSerializer ser(root);
+    check(ser);
+    assert(ser.rebuilds() == 1 && !root.dirty);
+    check(ser);
+    assert(ser.rebuilds() == 1); // unchanged, list was not rebuilt
+
+    nodes[5].set_data("changed leaf, much longer than before\n");
+    assert(root.dirty && nodes[5].parent->dirty && !nodes[40].dirty);
+    check(ser);
+    nodes.emplace_back("new leaf\n", &nodes[32]);
+    nodes.emplace_back("  new leaf's child\n", &nodes.back());
+    nodes.emplace_back("new branch\n", &root);
+    nodes[1].set_data("");
+    check(ser);
+    assert(ser.rebuilds() == 3);
+
+    // A subtree made separately and then attached, and changed later through a node in it.
+    TreeNode& subtree = nodes.emplace_back("attached subtree\n");
+    nodes.emplace_back("  attached leaf\n", &subtree);
+    const size_t root_size = root.size;
+    root.add_child(&subtree);
+    assert(subtree.parent == &root && root.size == root_size + 2);
+    check(ser);
+    assert(!root.dirty);
+    nodes.back().set_data("  attached leaf, changed\n");
+    assert(root.dirty);
+    check(ser);
+    assert(ser.rebuilds() == 5);
+
+    // A second serializer for the same tree, which the first one has already made clean, still writes all of it.
+    assert(!root.dirty);
+    TreeSerializer second(root);
+    check(second);
+    assert(second.rebuilds() == 1);
+    std::filesystem::remove(path);
+    puts("tree serializer ok");
+}
+
+
+
+/*
+    The structures above use a separately allocated TreeNode (and vector of children) for each node, and TreeIterator
+    keeps a stack (vector) of parents, which is allocated as it descends and copied with each copy of the iterator.
+    FlatTree is an alternative representation: all nodes are stored contiguously in one vector in depth first (pre-)order,
+    and each node stores the size of its subtree (so the next sibling of node i is at i + subtree_size) and its depth.
+    All of the strings are stored contiguously in the same order in one char array, and nodes refer to them by offset
+    (rather than pointer, so a FlatTree can be copied or moved).  Depth first traversal is just a linear scan of the
+    node vector with an ordinary (pointer) iterator, with no allocation; and since the strings are also in depth first
+    order, the entire serialization of the tree (or of any subtree) is one contiguous block of chars that can be
+    written with a single write().
+    FlatTree is immutable after being converted from a TreeNode tree.
+*/
+
+#include <cstdint>
+#include <string_view>
+#include <limits>
+
+class FlatTree
+{
+public:
+    struct Node
+    {
+        uint32_t data_offset = 0;   // offset of data in FlatTree::chars
+        uint32_t data_size = 0;
+        uint32_t subtree_size = 1;  // number of nodes in the subtree starting with this node, including this node
+        uint32_t depth = 0;         // 0 for root
+    };
+
+    using iterator = std::vector<Node>::const_iterator;
+
+    FlatTree() = default;
+
+    // Convert from a tree of TreeNodes.
+    explicit FlatTree(const TreeNode& root)
+    {
+        nodes.reserve(root.size);
+        append(root, 0);
+    }
+
+    size_t size() const noexcept { return nodes.size(); }
+    bool empty() const noexcept { return nodes.empty(); }
+
+    // Nodes in depth first order
+    iterator begin() const noexcept { return nodes.begin(); }
+    iterator end() const noexcept { return nodes.end(); }
+
+    const Node& operator[](size_t i) const noexcept { return nodes[i]; }
+
+    std::string_view data(const Node& n) const noexcept { return std::string_view(chars.data() + n.data_offset, n.data_size); }
+    std::string_view data(size_t i) const noexcept { return data(nodes[i]); }
+
+    // Index of the first child of node i, or the same as next_sibling(i) if it has no children.
+    size_t first_child(size_t i) const noexcept { return i + 1; }
+
+    // Index of the node after the subtree of node i (its next sibling, if it has one). Iterate over the children of node i with
+    //   for(size_t c = t.first_child(i); c < t.next_sibling(i); c = t.next_sibling(c))
+    size_t next_sibling(size_t i) const noexcept { return i + nodes[i].subtree_size; }
+
+    // Concatenated data of all nodes in the subtree starting with node i, in depth first order (the serialization of that subtree).
+    std::string_view subtree_contents(size_t i = 0) const noexcept
+    {
+        if(nodes.empty())
+            return {};
+        const size_t e = next_sibling(i);
+        const size_t end_offset = (e < nodes.size()) ? nodes[e].data_offset : chars.size();
+        return std::string_view(chars.data() + nodes[i].data_offset, end_offset - nodes[i].data_offset);
+    }
+
+private:
+    void append(const TreeNode& n, uint32_t depth)
+    {
+        assert(nodes.size() < std::numeric_limits<uint32_t>::max());
+        assert(chars.size() + n.data.size() <= std::numeric_limits<uint32_t>::max());
+        const size_t i = nodes.size();
+        nodes.push_back(Node{(uint32_t)chars.size(), (uint32_t)n.data.size(), 1, depth});
+        chars.insert(chars.end(), n.data.begin(), n.data.end());
+        for(const TreeNode *c : n.children)
+            append(*c, depth + 1);
+        nodes[i].subtree_size = (uint32_t)(nodes.size() - i);
+    }
+
+    std::vector<Node> nodes;
+    std::vector<char> chars;
+};
+
+
+// Check that FlatTree visits the same nodes in the same order as TreeIterator.
+void test_flat_tree_matches(TreeNode& tree, const FlatTree& flat)
+{
+    assert(flat.size() == tree.size);
+    size_t i = 0;
+    std::string expected;
+    for(auto &n : std::ranges::subrange(std::begin(tree), std::end(tree)))
+    {
+        assert(flat.data(i) == n.data);
+        assert(flat[i].subtree_size == n.size);
+        expected += n.data;
+        ++i;
+    }
+    assert(i == flat.size());
+    assert(flat.subtree_contents() == expected);
+    size_t nchildren = 0;
+    for(size_t c = flat.first_child(0); c < flat.next_sibling(0); c = flat.next_sibling(c))
+    {
+        assert(flat[c].depth == 1);
+        ++nchildren;
+    }
+    assert(nchildren == tree.children.size());
+}
+
+void test_flat_tree_fputs(const FlatTree& flat, FILE *out = stdout)
+{
+    fputs("-> test_flat_tree_fputs...\n", out);
+    for(const auto& n : flat)
+    {
+        const std::string_view d = flat.data(n);
+        if(fwrite(d.data(), 1, d.size(), out) != d.size())
+            throw std::runtime_error(std::string("IO Error writing serialization of tree: ") + strerror(errno));
+    }
+    fputs("...done.\n", out);
+}
+
+// The whole tree's data is contiguous, so only one write is needed (and no gathering of buffers as for writev()).
+void test_flat_tree_write(const FlatTree& flat, FILE *out = stdout)
+{
+    fputs("-> test_flat_tree_write...\n", out);
+    fflush(out);
+    const std::string_view d = flat.subtree_contents();
+    ssize_t n = write(fileno(out), d.data(), d.size());
+    if(n < 0)
+        throw std::runtime_error(std::string("IO Error writing serialization of tree: ") + strerror(errno));
+    if((size_t)n < d.size())
+        fprintf(out, "Warning: data truncated (%lu bytes, write returned %ld bytes)\n", d.size(), n);
+    fputs("...done.\n", out);
+}
+
+
+
+/*
+    A generic version of TreeIterator for any kind of tree: tree_view<Node, ChildrenProj, DataProj> uses projections
+    (anything callable with std::invoke(), e.g. pointers to members) to get the list of children of a node (a range of
+    Node* or Node&) and the data of a node.  Instead of an iterator class which has to keep its own stack of parents
+    between calls to operator++, the traversal is written as a simple loop in a coroutine, which yields each node
+    through Generator (C++23 std::generator isn't available yet in our compilers).  The stack of parents is kept in the
+    coroutine frame, so it's allocated once per traversal rather than copied with each iterator.
+*/
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <type_traits>
+
+// A minimal generator coroutine return type: an input range of T (which may be a reference type).
+template<typename T>
+class Generator : public std::ranges::view_base
+{
+public:
+    using value_type = std::remove_cvref_t<T>;
+    using reference = std::conditional_t<std::is_reference_v<T>, T, const T&>;
+
+    struct promise_type
+    {
+        std::add_pointer_t<reference> value = nullptr;
+        std::exception_ptr error;
+
+        Generator get_return_object() noexcept { return Generator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        std::suspend_always final_suspend() const noexcept { return {}; }
+        // The yielded object (or temporary) lives in the coroutine until it is resumed, so we can keep a pointer to it.
+        std::suspend_always yield_value(std::remove_reference_t<reference>& v) noexcept { value = std::addressof(v); return {}; }
+        std::suspend_always yield_value(std::remove_reference_t<reference>&& v) noexcept { value = std::addressof(v); return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() noexcept { error = std::current_exception(); }
+        template<typename U> void await_transform(U&&) = delete; // (co_await not supported)
+    };
+
+    class iterator
+    {
+    public:
+        using value_type = Generator::value_type;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() noexcept = default;
+        explicit iterator(std::coroutine_handle<promise_type> h) noexcept : coro(h) {}
+
+        reference operator*() const noexcept { return static_cast<reference>(*coro.promise().value); }
+        iterator& operator++() { resume(coro); return *this; }
+        void operator++(int) { ++*this; }
+        friend bool operator==(const iterator& i, std::default_sentinel_t) noexcept { return !i.coro || i.coro.done(); }
+
+    private:
+        std::coroutine_handle<promise_type> coro = nullptr;
+    };
+
+    Generator() noexcept = default;
+    Generator(Generator&& old) noexcept : coro(std::exchange(old.coro, nullptr)) {}
+    Generator& operator=(Generator&& old) noexcept
+    {
+        if(this != &old)
+        {
+            if(coro) coro.destroy();
+            coro = std::exchange(old.coro, nullptr);
+        }
+        return *this;
+    }
+    ~Generator() { if(coro) coro.destroy(); }
+
+    // Starts the coroutine (runs it until the first co_yield). Only call once.
+    iterator begin()
+    {
+        if(coro)
+            resume(coro);
+        return iterator(coro);
+    }
+    std::default_sentinel_t end() const noexcept { return std::default_sentinel; }
+
+private:
+    explicit Generator(std::coroutine_handle<promise_type> h) noexcept : coro(h) {}
+
+    static void resume(std::coroutine_handle<promise_type> h)
+    {
+        h.resume();
+        if(h.promise().error)
+            std::rethrow_exception(std::exchange(h.promise().error, nullptr));
+    }
+
+    std::coroutine_handle<promise_type> coro = nullptr;
+};
+
+namespace tree_detail
+{
+    // child list items may be pointers or references to nodes
+    template<typename Node, typename T> Node& node_ref(T&& x) noexcept
+    {
+        if constexpr(std::is_pointer_v<std::remove_cvref_t<T>>)
+            return *x;
+        else
+            return x;
+    }
+}
+
+template<typename Node, typename ChildrenProj, typename DataProj>
+class tree_view
+{
+public:
+    using data_reference = std::invoke_result_t<const DataProj&, Node&>;
+
+    tree_view(Node& root_, ChildrenProj children_, DataProj data_) :
+        root(&root_), children(std::move(children_)), data(std::move(data_))
+    {}
+
+    // All nodes in depth first (pre-) order. The tree must not be changed while the generator is used.
+    // (The generator doesn't refer to this tree_view, so it can be used after the tree_view is destroyed.)
+    Generator<Node&> nodes() const { return walk(root, children); }
+
+    // Data of all nodes in depth first order
+    Generator<data_reference> strings() const { return walk_data(root, children, data); }
+
+    Node& root_node() const noexcept { return *root; }
+    const ChildrenProj& children_projection() const noexcept { return children; }
+    const DataProj& data_projection() const noexcept { return data; }
+
+private:
+    // (Coroutine parameters are copied into the coroutine frame.)
+    static Generator<Node&> walk(Node *root, ChildrenProj children)
+    {
+        using ChildrenRange = std::remove_reference_t<std::invoke_result_t<const ChildrenProj&, Node&>>;
+        using ChildIterator = std::ranges::iterator_t<ChildrenRange>;
+        std::vector<std::pair<ChildIterator, ChildIterator>> stack; // next child and end of children of each ancestor
+        co_yield *root;
+        {
+            auto&& c = std::invoke(children, *root);
+            stack.emplace_back(std::ranges::begin(c), std::ranges::end(c));
+        }
+        while(!stack.empty())
+        {
+            auto& [next, end] = stack.back();
+            if(next == end)
+            {
+                stack.pop_back();
+                continue;
+            }
+            Node& n = tree_detail::node_ref<Node>(*next);
+            ++next;
+            co_yield n;
+            auto&& c = std::invoke(children, n);
+            stack.emplace_back(std::ranges::begin(c), std::ranges::end(c));
+        }
+    }
+
+    static Generator<data_reference> walk_data(Node *root, ChildrenProj children, DataProj data)
+    {
+        for(Node& n : walk(root, std::move(children)))
+            co_yield std::invoke(data, n);
+    }
+
+    Node *root;
+    [[no_unique_address]] ChildrenProj children;
+    [[no_unique_address]] DataProj data;
+};
+
+inline auto make_tree_view(TreeNode& tree)
+{
+    return tree_view(tree, &TreeNode::children, &TreeNode::data);
+}
+
+
+/*
+    parallel_for_each_subtree() calls fn(node) for every node in the tree, using up to nthreads threads.  The tree is
+    divided into tasks of whole subtrees, using the subtree size of each node (e.g. TreeNode::size, which is kept up to
+    date as nodes are added) so that no traversal is needed to find them: starting from the root, a node whose subtree
+    has no more than total size / (nthreads * tasks_per_thread) nodes becomes a task, otherwise fn is called for the
+    node itself by the calling thread and its children are examined the same way.  Tasks are started largest first
+    and handed out to the worker threads as they finish previous ones.  fn must be safe to call from multiple threads at
+    once, and nodes are not visited in any particular order.  If fn throws, the first exception is rethrown after all
+    threads have finished.
+
+    parallel_serialize() uses the same division of the tree to concatenate node data in parallel, keeping depth first
+    order: each task's subtree is serialized into its own string, and these are joined (with the data of the nodes above
+    the tasks) in order.
+*/
+
+#include <atomic>
+#include <thread>
+
+namespace tree_detail
+{
+    // A node to be processed alone (whole_subtree false) or with its whole subtree (true), in depth first order.
+    template<typename Node> struct Segment
+    {
+        Node *node;
+        bool whole_subtree;
+    };
+
+    template<typename Node, typename ChildrenProj, typename SizeProj>
+    void split_subtrees(Node& n, const ChildrenProj& children, const SizeProj& size, size_t max_task_size, std::vector<Segment<Node>>& out)
+    {
+        if((size_t)std::invoke(size, n) <= max_task_size)
+        {
+            out.push_back({&n, true});
+            return;
+        }
+        out.push_back({&n, false});
+        for(auto&& c : std::invoke(children, n))
+            split_subtrees(node_ref<Node>(c), children, size, max_task_size, out);
+    }
+
+    template<typename Node, typename ChildrenProj, typename SizeProj>
+    std::vector<Segment<Node>> split_tree(Node& root, const ChildrenProj& children, const SizeProj& size, size_t nthreads, size_t tasks_per_thread)
+    {
+        std::vector<Segment<Node>> segments;
+        const size_t total = (size_t)std::invoke(size, root);
+        const size_t max_task_size = std::max<size_t>(1, total / std::max<size_t>(1, nthreads * tasks_per_thread));
+        split_subtrees(root, children, size, nthreads > 1 ? max_task_size : total, segments);
+        return segments;
+    }
+
+    // Call task(i) for i in each of indices, using up to nthreads threads (including the calling thread). Rethrows first exception.
+    template<typename Task>
+    void run_tasks(const std::vector<size_t>& indices, size_t nthreads, Task&& task)
+    {
+        std::atomic<size_t> next{0};
+        std::vector<std::exception_ptr> errors(std::max<size_t>(1, std::min(nthreads, indices.size())));
+        auto worker = [&](std::exception_ptr& error) {
+            try {
+                for(size_t i = next++; i < indices.size(); i = next++)
+                    task(indices[i]);
+            } catch(...) {
+                error = std::current_exception();
+                next = indices.size(); // stop other threads taking more tasks
+            }
+        };
+        {
+            std::vector<std::jthread> threads;
+            for(size_t t = 1; t < errors.size(); ++t)
+                threads.emplace_back(worker, std::ref(errors[t]));
+            worker(errors[0]);
+        } // wait for all threads
+        for(const auto& e : errors)
+            if(e)
+                std::rethrow_exception(e);
+    }
+
+    // Indices of the whole_subtree segments, largest subtree first
+    template<typename Node, typename SizeProj>
+    std::vector<size_t> tasks_by_size(const std::vector<Segment<Node>>& segments, const SizeProj& size)
+    {
+        std::vector<size_t> tasks;
+        for(size_t i = 0; i < segments.size(); ++i)
+            if(segments[i].whole_subtree)
+                tasks.push_back(i);
+        std::ranges::stable_sort(tasks, std::greater<>{}, [&](size_t i) { return (size_t)std::invoke(size, *segments[i].node); });
+        return tasks;
+    }
+}
+
+template<typename Node, typename ChildrenProj, typename DataProj, typename SizeProj, typename Fn>
+void parallel_for_each_subtree(const tree_view<Node, ChildrenProj, DataProj>& view, SizeProj size, Fn&& fn,
+                               size_t nthreads = std::thread::hardware_concurrency(), size_t tasks_per_thread = 4)
+{
+    const auto segments = tree_detail::split_tree(view.root_node(), view.children_projection(), size, nthreads, tasks_per_thread);
+    for(const auto& s : segments)
+        if(!s.whole_subtree)
+            fn(*s.node);
+    tree_detail::run_tasks(tree_detail::tasks_by_size(segments, size), nthreads, [&](size_t i) {
+        for(Node& n : tree_view(*segments[i].node, view.children_projection(), view.data_projection()).nodes())
+            fn(n);
+    });
+}
+
+template<typename Node, typename ChildrenProj, typename DataProj, typename SizeProj>
+std::string parallel_serialize(const tree_view<Node, ChildrenProj, DataProj>& view, SizeProj size,
+                               size_t nthreads = std::thread::hardware_concurrency(), size_t tasks_per_thread = 4)
+{
+    const auto segments = tree_detail::split_tree(view.root_node(), view.children_projection(), size, nthreads, tasks_per_thread);
+    std::vector<std::string> parts(segments.size());
+    tree_detail::run_tasks(tree_detail::tasks_by_size(segments, size), nthreads, [&](size_t i) {
+        for(std::string_view d : tree_view(*segments[i].node, view.children_projection(), view.data_projection()).strings())
+            parts[i] += d;
+    });
+    std::string result;
+    for(size_t i = 0; i < segments.size(); ++i)
+        result += segments[i].whole_subtree ? std::string_view(parts[i]) : std::string_view(std::invoke(view.data_projection(), *segments[i].node));
+    return result;
+}
+
+
+#include <deque>
+
+// Make a tree with about 'fanout' children at each of 'depth' levels, in nodes (which must not be moved).
+TreeNode& make_large_tree(std::deque<TreeNode>& nodes, size_t fanout, size_t depth)
+{
+    TreeNode& root = nodes.emplace_back("root ");
+    std::vector<TreeNode*> level{&root};
+    for(size_t d = 0; d < depth; ++d)
+    {
+        std::vector<TreeNode*> next;
+        for(size_t p = 0; p < level.size(); ++p)
+            for(size_t c = 0; c < fanout + (p % 3); ++c) // (vary the number of children so subtrees have different sizes)
+                next.push_back(&nodes.emplace_back("node" + std::to_string(nodes.size()) + " ", level[p]));
+        level = std::move(next);
+    }
+    return root;
+}
+
+void test_tree_view(TreeNode& tree)
+{
+    // Same order as TreeIterator:
+    const auto view = make_tree_view(tree);
+    std::string expected;
+    for(auto &n : std::ranges::subrange(std::begin(tree), std::end(tree)))
+        expected += n.data;
+    std::string s;
+    size_t count = 0;
+    for(TreeNode& n : view.nodes())
+    {
+        s += n.data;
+        ++count;
+    }
+    assert(s == expected && count == tree.size);
+    s.clear();
+    for(const std::string& d : view.strings())
+        s += d;
+    assert(s == expected);
+    static_assert(std::ranges::input_range<Generator<TreeNode&>>);
+
+    // Projections can be any callable, and child lists can contain references (here std::reference_wrapper) instead of pointers:
+    struct IndexNode { std::string name; std::vector<std::reference_wrapper<IndexNode>> kids; };
+    IndexNode leaf1{"b", {}}, leaf2{"c", {}}, mid{"a", {leaf1, leaf2}}, top{"top", {mid}};
+    std::string names;
+    for(auto& n : tree_view(top, [](IndexNode& n) -> auto& { return n.kids; }, &IndexNode::name).nodes())
+        names += n.name;
+    assert(names == "topabc");
+
+    // Parallel traversal and serialization of a larger tree:
+    std::deque<TreeNode> nodes;
+    TreeNode& big = make_large_tree(nodes, 8, 5);
+    const auto bigview = make_tree_view(big);
+    std::string big_expected;
+    for(const std::string& d : bigview.strings())
+        big_expected += d;
+    for(size_t nthreads : {1, 2, 4, 7})
+    {
+        std::atomic<size_t> visited{0};
+        std::atomic<size_t> total_bytes{0};
+        parallel_for_each_subtree(bigview, &TreeNode::size, [&](TreeNode& n) {
+            ++visited;
+            total_bytes += n.data.size();
+        }, nthreads);
+        assert(visited == big.size);
+        assert(total_bytes == big_expected.size());
+        assert(parallel_serialize(bigview, &TreeNode::size, nthreads) == big_expected);
+    }
+    bool threw = false;
+    try {
+        parallel_for_each_subtree(bigview, &TreeNode::size, [](TreeNode& n) {
+            if(n.data == "node500 ")
+                throw std::runtime_error("invalid node");
+        }, 4);
+    } catch(const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    printf("tree_view ok (%lu nodes)\n", big.size);
 }
 
 
@@ -299,13 +1027,381 @@ void test_iterate_gather_then_writev(TreeNode& tree)
     First, by iterating over all the tree node strings:
 */
 
+void test_iterate_chunks_fwrite(TreeNode& tree, size_t chunk_size = 5)
+{
+    puts("-> test_iterate_chunks_fwrite...");
+    for(auto &node : std::ranges::subrange(std::begin(tree), std::end(tree)))
+    {
+        for(size_t i = 0; i < node.data.size(); i += chunk_size)
+        {
+            const size_t n = std::min(chunk_size, node.data.size() - i);
+            if(fwrite(node.data.data() + i, 1, n, stdout) != n)
+                throw std::runtime_error(std::string("IO Error writing serialization of tree: ") + strerror(errno));
+        }
+    }
+    puts("...done.");
+}
+
 
 /*  Second, with a custom range adapter that returns chunks, either whole strings or sub-strings if long.
+    StringChunksView takes any range of strings (anything convertible to std::string_view), and returns string_views of at
+    most chunk_size characters into the original strings (nothing is copied).  Empty strings are skipped.
+*/
+
+template<std::ranges::view V>
+class StringChunksView : public std::ranges::view_interface<StringChunksView<V>>
+{
+public:
+    class iterator
+    {
+    public:
+        using iterator_concept = std::conditional_t<std::ranges::forward_range<V>, std::forward_iterator_tag, std::input_iterator_tag>;
+        using difference_type = std::ptrdiff_t;
+        using value_type = std::string_view;
+
+        iterator() = default;
+        iterator(std::ranges::iterator_t<V> it_, std::ranges::sentinel_t<V> end_, size_t chunk_size_) :
+            it(std::move(it_)), end(std::move(end_)), chunk_size(chunk_size_)
+        {
+            skip_empty();
+        }
+
+        std::string_view operator*() const
+        {
+            return std::string_view(*it).substr(offset, chunk_size);
+        }
+
+        iterator& operator++()
+        {
+            offset += chunk_size;
+            if(offset >= std::string_view(*it).size())
+            {
+                ++it;
+                offset = 0;
+                skip_empty();
+            }
+            return *this;
+        }
+
+        void operator++(int) { ++*this; }
+
+        friend bool operator==(const iterator& i, std::default_sentinel_t) { return i.it == i.end; }
+        friend bool operator==(const iterator& a, const iterator& b) requires std::ranges::forward_range<V> { return a.it == b.it && a.offset == b.offset; }
+
+    private:
+        void skip_empty()
+        {
+            while(it != end && std::string_view(*it).empty())
+                ++it;
+        }
+
+        std::ranges::iterator_t<V> it;
+        std::ranges::sentinel_t<V> end;
+        size_t chunk_size = 1;
+        size_t offset = 0;
+    };
+
+    StringChunksView(V base_, size_t chunk_size_) : base(std::move(base_)), chunk_size(chunk_size_ > 0 ? chunk_size_ : 1) {}
+
+    iterator begin() { return iterator(std::ranges::begin(base), std::ranges::end(base), chunk_size); }
+    std::default_sentinel_t end() const noexcept { return std::default_sentinel; }
+
+private:
+    V base;
+    size_t chunk_size;
+};
+
+template<std::ranges::viewable_range R>
+auto string_chunks(R&& r, size_t chunk_size)
+{
+    return StringChunksView<std::views::all_t<R>>(std::views::all(std::forward<R>(r)), chunk_size);
+}
 
+// All node data in the tree as a range of strings
+auto tree_strings(TreeNode& tree)
+{
+    return std::ranges::subrange(std::begin(tree), std::end(tree)) | std::views::transform(&TreeNode::data);
+}
+
+void test3(TreeNode& tree, size_t chunk_size = 5)
+{
+    puts("-> test3 (string_chunks, with chunks separated by '|')...");
+    for(std::string_view chunk : string_chunks(tree_strings(tree), chunk_size))
+    {
+        assert(chunk.size() <= chunk_size);
+        fwrite(chunk.data(), 1, chunk.size(), stdout);
+        putchar('|');
+    }
+    puts("...done.");
+}
+
+
+/*
+    To send the tree to a datagram socket, the chunks are grouped into packets of at most packet_size bytes.
+    DatagramSink::send() takes any range of string_views (e.g. tree_strings() or string_chunks()), and gathers consecutive
+    strings into one packet with an iovec for each piece (splitting a string between packets where needed), so the data
+    is not copied into a packet buffer.  Packets are sent in batches of up to max_batch with one sendmmsg() call (Linux),
+    or with sendmsg() for each packet elsewhere.
+
+    On Linux, enable_zerocopy() turns on MSG_ZEROCOPY, so the kernel sends the packets directly from the tree's
+    string data rather than copying it.  The data must then not be changed or freed until the kernel has
+    reported that it is finished with it; call reap_zerocopy(true) to wait for that (zerocopy_pending() is the number of
+    sends not yet completed).  This is normally only faster for large packets (about 10 KB or more), since completion
+    notifications have their own overhead.
 */
 
-void test3(const TreeNode& tree)
+#include <array>
+#include <sys/socket.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <poll.h>
+#endif
+
+class DatagramSink
 {
+public:
+    static constexpr size_t max_batch = 64;          // packets per sendmmsg() call
+    static constexpr size_t max_iov_per_packet = 64; // pieces per packet (more pieces start a new packet)
+
+    DatagramSink(int fd_, size_t packet_size_) :
+        fd(fd_), packet_size(packet_size_ > 0 ? packet_size_ : 1), iovs(max_batch * max_iov_per_packet)
+    {
+    }
+
+    DatagramSink(const DatagramSink&) = delete;
+    DatagramSink& operator=(const DatagramSink&) = delete;
+
+    // Use MSG_ZEROCOPY if supported by the socket. Return false if not (packets will be copied as usual).
+    bool enable_zerocopy()
+    {
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+        int one = 1;
+        if(setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0)
+            return false;
+        send_flags |= MSG_ZEROCOPY;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Send all of the strings in r, as packets of at most packet_size bytes. Returns number of packets sent.
+    // Throws std::system_error on error.
+    template<std::ranges::input_range R>
+    size_t send(R&& r)
+    {
+        const size_t before = packets_sent;
+        for(std::string_view s : r)
+            add(s);
+        finish_packet();
+        flush();
+        return packets_sent - before;
+    }
+
+    // Process MSG_ZEROCOPY completion notifications. If wait is true, block until all sends have completed.
+    // Returns number of completed sends.
+    size_t reap_zerocopy([[maybe_unused]] bool wait)
+    {
+        size_t reaped = 0;
+#if defined(__linux__) && defined(SO_EE_ORIGIN_ZEROCOPY)
+        while(zc_pending > 0)
+        {
+            if(wait)
+            {
+                struct pollfd p = {fd, 0, 0}; // (POLLERR is always reported)
+                if(poll(&p, 1, -1) < 0 && errno != EINTR)
+                    throw std::system_error(errno, std::system_category(), "poll");
+            }
+            char control[128];
+            struct msghdr msg = {};
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            if(recvmsg(fd, &msg, MSG_ERRQUEUE) < 0)
+            {
+                if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                {
+                    if(!wait) break;
+                    continue;
+                }
+                throw std::system_error(errno, std::system_category(), "recvmsg(MSG_ERRQUEUE)");
+            }
+            for(struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+            {
+                if(!((c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR) || (c->cmsg_level == SOL_IPV6 && c->cmsg_type == IPV6_RECVERR)))
+                    continue;
+                const auto *e = reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(c));
+                if(e->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                    continue;
+                const size_t n = (size_t)(e->ee_data - e->ee_info) + 1; // range of send ids [ee_info, ee_data] completed
+                zc_pending -= std::min(n, zc_pending);
+                reaped += n;
+            }
+        }
+#endif
+        return reaped;
+    }
+
+    size_t zerocopy_pending() const noexcept { return zc_pending; }
+    size_t packets() const noexcept { return packets_sent; }
+    size_t bytes() const noexcept { return bytes_sent; }
+
+private:
+    void add(std::string_view s)
+    {
+        while(!s.empty())
+        {
+            if(cur_bytes == packet_size || cur_iovs == max_iov_per_packet)
+                finish_packet();
+            const size_t n = std::min(packet_size - cur_bytes, s.size());
+            iovs[nmsgs * max_iov_per_packet + cur_iovs] = {(void*)s.data(), n};
+            ++cur_iovs;
+            cur_bytes += n;
+            s.remove_prefix(n);
+        }
+    }
+
+    void finish_packet()
+    {
+        if(cur_iovs == 0)
+            return;
+        struct msghdr& h = msgs[nmsgs].msg_hdr;
+        h = {};
+        h.msg_iov = &iovs[nmsgs * max_iov_per_packet];
+        h.msg_iovlen = cur_iovs;
+        ++nmsgs;
+        bytes_sent += cur_bytes;
+        cur_iovs = 0;
+        cur_bytes = 0;
+        if(nmsgs == max_batch)
+            flush();
+    }
+
+    // Send the batch of packets. Each packet is sent whole (or not at all), so continue from the first one that wasn't sent.
+    void flush()
+    {
+        size_t sent = 0;
+        while(sent < nmsgs)
+        {
+#ifdef __linux__
+            const int r = sendmmsg(fd, &msgs[sent], (unsigned int)(nmsgs - sent), send_flags);
+#else
+            const int r = sendmsg(fd, &msgs[sent].msg_hdr, send_flags) < 0 ? -1 : 1;
+#endif
+            if(r < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+                if(errno == ENOBUFS && zc_pending > 0)
+                {
+                    // too much memory pinned by zerocopy sends not yet completed
+                    reap_zerocopy(true);
+                    continue;
+                }
+                throw std::system_error(errno, std::system_category(), "IO Error sending tree packets");
+            }
+            sent += (size_t)r;
+            packets_sent += (size_t)r;
+            if(send_flags != 0)
+                zc_pending += (size_t)r;
+        }
+        nmsgs = 0;
+    }
+
+    int fd;
+    size_t packet_size;
+    int send_flags = 0;
+#ifdef __linux__
+    std::array<struct mmsghdr, max_batch> msgs{};
+#else
+    struct mmsghdr_compat { struct msghdr msg_hdr; };
+    std::array<mmsghdr_compat, max_batch> msgs{};
+#endif
+    std::vector<struct iovec> iovs; // max_iov_per_packet for each packet in msgs
+    size_t nmsgs = 0;     // packets in the batch
+    size_t cur_iovs = 0;  // pieces in the packet being built
+    size_t cur_bytes = 0; // bytes in the packet being built
+    size_t packets_sent = 0;
+    size_t bytes_sent = 0;
+    size_t zc_pending = 0;
+};
+
+
+#include <sys/types.h>
+#include <fcntl.h>
+
+// Read all datagrams waiting on fd, check size, and return contents of all of them.
+std::string receive_datagrams(int fd, size_t packet_size, size_t *count = nullptr)
+{
+    std::string received;
+    std::vector<char> buf(packet_size + 1);
+    size_t n = 0;
+    for(;;)
+    {
+        const ssize_t r = recv(fd, buf.data(), buf.size(), MSG_DONTWAIT);
+        if(r < 0)
+            break;
+        assert((size_t)r <= packet_size);
+        received.append(buf.data(), (size_t)r);
+        ++n;
+    }
+    if(count) *count = n;
+    return received;
+}
+
+// Send the tree as 16 byte datagrams over a local socket pair, and check what is received.
+void test_datagram_sink(TreeNode& tree)
+{
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) != 0)
+        throw std::system_error(errno, std::system_category(), "socketpair");
+    std::string expected;
+    for(std::string_view s : tree_strings(tree))
+        expected += s;
+
+    DatagramSink sink(fds[0], 16);
+    const size_t npackets = sink.send(tree_strings(tree));
+    assert(npackets == (expected.size() + 15) / 16);
+    assert(sink.bytes() == expected.size());
+    size_t received_count = 0;
+    assert(receive_datagrams(fds[1], 16, &received_count) == expected);
+    assert(received_count == npackets);
+
+    // Chunks from string_chunks() are also gathered into packets:
+    sink.send(string_chunks(tree_strings(tree), 5));
+    assert(receive_datagrams(fds[1], 16) == expected);
+    close(fds[0]);
+    close(fds[1]);
+
+#ifdef __linux__
+    // MSG_ZEROCOPY over UDP on the loopback interface, if available.
+    const int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    const int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if(rx >= 0 && tx >= 0 && bind(rx, (struct sockaddr*)&addr, sizeof(addr)) == 0 && getsockname(rx, (struct sockaddr*)&addr, &len) == 0
+        && connect(tx, (struct sockaddr*)&addr, sizeof(addr)) == 0)
+    {
+        DatagramSink zsink(tx, 32);
+        if(zsink.enable_zerocopy())
+        {
+            zsink.send(tree_strings(tree));
+            zsink.reap_zerocopy(true);
+            assert(zsink.zerocopy_pending() == 0);
+            assert(receive_datagrams(rx, 32) == expected);
+            puts("zerocopy ok");
+        }
+        else
+            puts("MSG_ZEROCOPY not supported, skipped");
+    }
+    else
+        puts("UDP loopback not available, MSG_ZEROCOPY test skipped");
+    if(rx >= 0) close(rx);
+    if(tx >= 0) close(tx);
+#endif
+    puts("datagram sink ok");
 }
 
 
@@ -331,41 +1427,162 @@ TreeNode n13("thirteenth ", &n12);
 
 #include "benchmark/benchmark.h"
 
+#include <fstream>
+
+// Benchmarks which write the tree write it to /dev/null, so that they measure the cost of traversal and system
+// calls rather than of the terminal. Each reports the number of nodes (items) and bytes of tree data written.
+static FILE *null_output()
+{
+  static FILE *fp = fopen("/dev/null", "w");
+  if(!fp)
+    throw std::system_error(errno, std::system_category(), "/dev/null");
+  return fp;
+}
+
+static void set_tree_processed(benchmark::State& state)
+{
+  static const int64_t bytes = (int64_t)FlatTree(tree).subtree_contents().size();
+  state.SetItemsProcessed(state.iterations() * (int64_t)tree.size);
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+
 static void bench_iterate_fputs(benchmark::State& state) {
   for (auto _ : state) {
-    test_iterate_fputs(tree);
+    test_iterate_fputs(tree, null_output());
   }
+  set_tree_processed(state);
 }
 BENCHMARK(bench_iterate_fputs);
 
 static void bench_iterate_writev(benchmark::State& state) {
   for (auto _ : state) {
-    test_iterate_gather_then_writev(tree);
+    test_iterate_gather_then_writev(tree, null_output());
   }
+  set_tree_processed(state);
 }
 BENCHMARK(bench_iterate_writev);
 
+static void bench_serializer_writev(benchmark::State& state) {
+  TreeSerializer serializer(tree);
+  for (auto _ : state) {
+    test_serializer_writev(serializer, null_output());
+  }
+  set_tree_processed(state);
+  state.counters["iovecs"] = (double)serializer.iovecs().size(); // (one per node, written with as few writev() calls as IOV_MAX allows)
+}
+BENCHMARK(bench_serializer_writev);
+
+// Send the tree to a local datagram socket in packets of state.range(0) bytes, receiving them after each send so the socket buffer doesn't fill.
+static void bench_datagram_sink(benchmark::State& state) {
+  int fds[2];
+  if(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) != 0)
+    throw std::system_error(errno, std::system_category(), "socketpair");
+  const size_t packet_size = (size_t)state.range(0);
+  DatagramSink sink(fds[0], packet_size);
+  std::vector<char> buf(packet_size);
+  for (auto _ : state) {
+    sink.send(tree_strings(tree));
+    while(recv(fds[1], buf.data(), buf.size(), MSG_DONTWAIT) > 0) {}
+  }
+  state.SetItemsProcessed((int64_t)sink.packets());
+  state.SetBytesProcessed((int64_t)sink.bytes());
+  state.counters["packets_per_iteration"] = benchmark::Counter((double)sink.packets(), benchmark::Counter::kAvgIterations);
+  close(fds[0]);
+  close(fds[1]);
+}
+BENCHMARK(bench_datagram_sink)->Arg(16)->Arg(1400);
+
 static void bench_join_ranges_putchar(benchmark::State& state) {
   for (auto _ : state) {
-    test_join_ranges_putchar(tree);
+    test_join_ranges_putchar(tree, null_output());
   }
+  set_tree_processed(state);
 }
 BENCHMARK(bench_join_ranges_putchar);
 
 static void bench_join_ranges_iostream(benchmark::State& state) {
+  std::ofstream null_stream("/dev/null");
   for (auto _ : state) {
-    test_join_ranges_iostream(tree);
+    test_join_ranges_iostream(tree, null_stream);
   }
+  set_tree_processed(state);
 }
 BENCHMARK(bench_join_ranges_iostream);
 
 static void bench_join_ranges_libfmt(benchmark::State& state) {
   for (auto _ : state) {
-    test_join_ranges_libfmt(tree);
+    test_join_ranges_libfmt(tree, null_output());
   }
+  set_tree_processed(state);
 }
 BENCHMARK(bench_join_ranges_libfmt);
 
+static void bench_flat_tree_fputs(benchmark::State& state) {
+  const FlatTree flat(tree);
+  for (auto _ : state) {
+    test_flat_tree_fputs(flat, null_output());
+  }
+  set_tree_processed(state);
+}
+BENCHMARK(bench_flat_tree_fputs);
+
+static void bench_flat_tree_write(benchmark::State& state) {
+  const FlatTree flat(tree);
+  for (auto _ : state) {
+    test_flat_tree_write(flat, null_output());
+  }
+  set_tree_processed(state);
+}
+BENCHMARK(bench_flat_tree_write);
+
+// Traversal only (no output), to compare TreeIterator with FlatTree's linear scan:
+static void bench_traverse_tree_iterator(benchmark::State& state) {
+  for (auto _ : state) {
+    size_t total = 0;
+    for(auto &n : std::ranges::subrange(std::begin(tree), std::end(tree)))
+      total += n.data.size();
+    benchmark::DoNotOptimize(total);
+  }
+  set_tree_processed(state);
+}
+BENCHMARK(bench_traverse_tree_iterator);
+
+static void bench_traverse_flat_tree(benchmark::State& state) {
+  const FlatTree flat(tree);
+  for (auto _ : state) {
+    size_t total = 0;
+    for(const auto& n : flat)
+      total += flat.data(n).size();
+    benchmark::DoNotOptimize(total);
+  }
+  set_tree_processed(state);
+}
+BENCHMARK(bench_traverse_flat_tree);
+
+static void bench_traverse_generator(benchmark::State& state) {
+  const auto view = make_tree_view(tree);
+  for (auto _ : state) {
+    size_t total = 0;
+    for(TreeNode& n : view.nodes())
+      total += n.data.size();
+    benchmark::DoNotOptimize(total);
+  }
+  set_tree_processed(state);
+}
+BENCHMARK(bench_traverse_generator);
+
+// Serialize a tree of about 100k nodes with state.range(0) threads
+static void bench_parallel_serialize(benchmark::State& state) {
+  static std::deque<TreeNode> nodes;
+  static TreeNode& big = make_large_tree(nodes, 9, 5);
+  const auto view = make_tree_view(big);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(parallel_serialize(view, &TreeNode::size, (size_t)state.range(0)));
+  }
+  state.SetItemsProcessed(state.iterations() * (int64_t)big.size);
+}
+BENCHMARK(bench_parallel_serialize)->Arg(1)->Arg(4)->UseRealTime();
+
 
 
 BENCHMARK_MAIN();
@@ -376,9 +1593,23 @@ int main()
 {
   test_iterate_fputs(tree);
   test_iterate_gather_then_writev(tree);
+  TreeSerializer serializer(tree);
+  test_serializer_writev(serializer);
+  test_serializer_updates();
+  test_iterate_chunks_fwrite(tree);
+  test3(tree);
+  test_datagram_sink(tree);
   test_join_ranges_putchar(tree);
   test_join_ranges_iostream(tree);
   test_join_ranges_libfmt(tree);
+  const FlatTree flat(tree);
+  test_flat_tree_matches(tree, flat);
+  test_flat_tree_fputs(flat);
+  test_flat_tree_write(flat);
+  test_tree_view(tree);
+#if RHM_INSTRUMENTATION
+  rhm::instrument::print_report();
+#endif
   return 0;
 }
 